@@ -274,6 +274,10 @@ void perform_time_stepping(InputArguments args) {
   // Prototypes for the method
   dashmm::BH<Particle, Particle, dashmm::LaplaceCOMAcc> method{0.6};
 
+  // The particles move only a little each step, so the tree is kept between
+  // steps and updated rather than being built again each step.
+  bheval.retain_tree(true);
+
   // Time-stepping
   for (int step = 0; step < args.steps; ++step) {
     if (dashmm::get_my_rank() == 0) {
@@ -295,6 +299,9 @@ void perform_time_stepping(InputArguments args) {
     t_update += elapsed(t2, t1);
   }
 
+  err = bheval.release_tree();
+  assert(err == dashmm::kSuccess);
+
   // Report on loop
   fprintf(stdout, "\nEvaluation took %lg [us]\n", t_eval);
   fprintf(stdout, "Update took %lg [us]\n", t_update);
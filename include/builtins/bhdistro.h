@@ -43,8 +43,9 @@ class BHDistro {
 
  private:
   std::queue<DAGNode *> collect_readies(DAG &dag);
-  void compute_locality(DAGNode *node);
-  void mark_upstream_nodes(DAGNode *node, std::queue<DAGNode *> &master);
+  void compute_locality(DAG &dag, DAGNode *node);
+  void mark_upstream_nodes(DAG &dag, DAGNode *node,
+                           std::queue<DAGNode *> &master);
   bool distribution_complete(DAG &dag);
 };
 
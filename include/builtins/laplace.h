@@ -31,6 +31,7 @@
 #include "builtins/laplace_table.h"
 #include "builtins/merge_shift.h"
 #include "dashmm/point.h"
+#include "dashmm/soa.h"
 #include "dashmm/types.h"
 #include "dashmm/viewset.h"
 
@@ -615,6 +616,10 @@ class Laplace {
     }
   }
 
+  void S_to_T(const SourceSoA &sources, TargetSoA &targets) const {
+    soa_inverse_distance(sources, targets);
+  }
+
   std::unique_ptr<expansion_t> M_to_I(Index s_index) const {
     double scale = views_.scale();
     expansion_t *retval{new expansion_t{views_.center(), scale,
@@ -1277,6 +1282,11 @@ class Laplace {
 };
 
 
+/// Laplace provides kernels for the SoA layout
+template <typename Source, typename Target>
+struct HasSoAKernels<Laplace<Source, Target>> : std::true_type { };
+
+
 } // namespace dashmm
 
 #endif // __DASHMM_LAPLACE_EXPANSION_H__
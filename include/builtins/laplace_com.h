@@ -28,6 +28,7 @@
 
 #include "dashmm/index.h"
 #include "dashmm/point.h"
+#include "dashmm/soa.h"
 #include "dashmm/types.h"
 #include "dashmm/viewset.h"
 
@@ -240,6 +241,10 @@ class LaplaceCOM {
     }
   }
 
+  void S_to_T(const SourceSoA &sources, TargetSoA &targets) const {
+    soa_inverse_distance(sources, targets);
+  }
+
   std::unique_ptr<expansion_t> M_to_I(Index s_index) const {
     return std::unique_ptr<expansion_t>{nullptr};
   }
@@ -405,6 +410,11 @@ class LaplaceCOM {
 };
 
 
+/// LaplaceCOM provides kernels for the SoA layout
+template <typename Source, typename Target>
+struct HasSoAKernels<LaplaceCOM<Source, Target>> : std::true_type { };
+
+
 } // namespace dashmm
 
 
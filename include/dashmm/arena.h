@@ -0,0 +1,186 @@
+// =============================================================================
+//  Dynamic Adaptive System for Hierarchical Multipole Methods (DASHMM)
+//
+//  Copyright (c) 2015-2017, Trustees of Indiana University,
+//  All rights reserved.
+//
+//  This software may be modified and distributed under the terms of the BSD
+//  license. See the LICENSE file for details.
+//
+//  This software was created at the Indiana University Center for Research in
+//  Extreme Scale Technologies (CREST).
+// =============================================================================
+
+
+#ifndef __DASHMM_ARENA_H__
+#define __DASHMM_ARENA_H__
+
+
+/// \file
+/// \brief Slab allocator for objects with a common lifetime
+
+
+#include <cassert>
+#include <cstdlib>
+
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <hpx/hpx.h>
+
+
+namespace dashmm {
+
+
+/// Slab arena for many small objects that are released together
+///
+/// The nodes of a tree are created one at a time from many threads, but they
+/// are all destroyed together. This object serves such allocations from
+/// large slabs of memory. Each worker thread has its own current slab, so
+/// allocation requires no synchronization. All of the objects are destroyed,
+/// and all of the slabs are freed, with release(); memory is returned to the
+/// system one slab at a time.
+///
+/// Allocation must occur inside an HPX-5 thread, and must not be interleaved
+/// with operations that might suspend the calling thread. Objects that are no
+/// longer needed can be returned with destroy(), after which their storage is
+/// reused by a later create() on the same thread.
+template <typename T>
+class Arena {
+ public:
+  /// Construct an arena
+  ///
+  /// This cannot be used outside of an HPX-5 thread.
+  ///
+  /// \param slab_size - the number of objects in each slab
+  explicit Arena(size_t slab_size = 1024)
+      : slab_size_{slab_size}, threads_(hpx_get_num_threads()) { }
+
+  /// The destructor releases any remaining objects
+  ~Arena() {release();}
+
+  Arena(const Arena<T> &other) = delete;
+  Arena<T> &operator=(const Arena<T> &other) = delete;
+
+  /// Create an object in the arena
+  ///
+  /// The arguments are forwarded to the constructor of T.
+  ///
+  /// \returns - the address of the new object
+  template <typename... Args>
+  T *create(Args &&... args) {
+    int tid = hpx_get_my_thread_id();
+    assert(tid >= 0 && tid < (int)threads_.size());
+    ThreadSlabs &mine = threads_[tid];
+
+    if (!mine.free.empty()) {
+      T *retval = mine.free.back();
+      mine.free.pop_back();
+      retval->~T();
+      return new (retval) T(std::forward<Args>(args)...);
+    }
+
+    if (mine.slabs.empty() || mine.used == slab_size_) {
+      T *slab = static_cast<T *>(malloc(sizeof(T) * slab_size_));
+      assert(slab != nullptr);
+      mine.slabs.push_back(slab);
+      mine.used = 0;
+    }
+
+    T *retval = new (&mine.slabs.back()[mine.used]) T(
+                                                  std::forward<Args>(args)...);
+    ++mine.used;
+    return retval;
+  }
+
+  /// Return an object to the arena
+  ///
+  /// The object is kept on a free list of the calling thread until it is
+  /// reused by create(). Its destructor runs when it is reused, or when the
+  /// arena is released, so any resources it holds are not freed immediately.
+  /// The object must not be used after it is destroyed.
+  ///
+  /// \param obj - an object previously created by this arena
+  void destroy(T *obj) {
+    int tid = hpx_get_my_thread_id();
+    assert(tid >= 0 && tid < (int)threads_.size());
+    threads_[tid].free.push_back(obj);
+  }
+
+  /// Destroy all objects in the arena and free the slabs
+  ///
+  /// This is not thread safe; no other thread may be using the arena.
+  void release() {
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      ThreadSlabs &curr = threads_[i];
+      for (size_t j = 0; j < curr.slabs.size(); ++j) {
+        size_t n_obj = (j + 1 == curr.slabs.size()) ? curr.used : slab_size_;
+        for (size_t k = 0; k < n_obj; ++k) {
+          curr.slabs[j][k].~T();
+        }
+        free(curr.slabs[j]);
+      }
+      curr.slabs.clear();
+      curr.free.clear();
+      curr.used = 0;
+    }
+  }
+
+  /// Exchange the objects of this arena with those of another
+  ///
+  /// No objects are moved, so pointers to the objects remain valid. This is
+  /// not thread safe; no other thread may be using either arena.
+  ///
+  /// \param other - the other arena
+  void swap(Arena<T> &other) {
+    std::swap(slab_size_, other.slab_size_);
+    threads_.swap(other.threads_);
+  }
+
+  /// Return the number of objects currently in use in the arena
+  size_t n_objects() const {
+    size_t retval{0};
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      if (!threads_[i].slabs.empty()) {
+        retval += (threads_[i].slabs.size() - 1) * slab_size_
+                  + threads_[i].used - threads_[i].free.size();
+      }
+    }
+    return retval;
+  }
+
+  /// Return the number of slabs currently allocated by the arena
+  size_t n_slabs() const {
+    size_t retval{0};
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      retval += threads_[i].slabs.size();
+    }
+    return retval;
+  }
+
+  /// Return the number of bytes currently allocated by the arena
+  size_t bytes() const {return n_slabs() * slab_size_ * sizeof(T);}
+
+ private:
+  /// The slabs belonging to one worker thread
+  ///
+  /// This is padded to avoid false sharing between the threads.
+  struct ThreadSlabs {
+    std::vector<T *> slabs;   /// The slabs of this thread
+    std::vector<T *> free;    /// Destroyed objects awaiting reuse
+    size_t used;              /// The number of objects used in the last slab
+    char padding[64];
+
+    ThreadSlabs() : slabs{}, free{}, used{0} { }
+  };
+
+  size_t slab_size_;                  /// objects per slab
+  std::vector<ThreadSlabs> threads_;  /// per thread slabs
+};
+
+
+} // namespace dashmm
+
+
+#endif // __DASHMM_ARENA_H__
@@ -20,6 +20,9 @@
 /// \brief Interface for intermediate representation of DAG
 
 
+#include <cstdint>
+
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -36,6 +39,11 @@ struct DAGNode;
 
 
 /// Edge in the explicit representation of the DAG
+///
+/// While the DAG is being built, the edges are kept by the DAG in the order
+/// they are found. Once the DAG is finalized, the edges are stored in a
+/// compressed form, and edges of this type are produced from that by
+/// DAG::out_edges() and DAG::in_edges().
 struct DAGEdge {
   DAGNode *source;          /// Source node of the edge
   DAGNode *target;          /// Target node of the edge
@@ -49,9 +57,10 @@ struct DAGEdge {
 
 
 /// Node in the explicit representation of the DAG
+///
+/// The counts of the edges of an implicit DAG are updated concurrently by
+/// the threads building the DAG, and so are atomic.
 struct DAGNode {
-  std::vector<DAGEdge> out_edges;   /// these are out edges
-  std::vector<DAGEdge> in_edges;    /// these are in edges
   Index idx;                        /// index of the containing node
 
   int locality;                  /// the locality where this will be placed
@@ -59,20 +68,38 @@ struct DAGNode {
   size_t n_parts;                /// number of points stored in a target lco
                                  /// or a source ref
   int color;
+  uint32_t id;                   /// position of the node in the DAG; set by
+                                 /// DAG::finalize()
+  std::atomic<uint32_t> n_in;    /// number of in edges of an implicit DAG
+  std::atomic<uint32_t> n_out;   /// number of out edges of an implicit DAG
+  std::atomic<uint32_t> n_claimed;  /// out edge slots taken so far while
+                                    /// an implicit DAG is emitted
+  std::atomic<uint32_t> n_stored;   /// out edges put so far while an
+                                    /// implicit DAG is emitted
 
   DAGNode(Index i)
-    : out_edges{}, in_edges{}, idx{i}, locality{-1}, global_addx{HPX_NULL},
-      n_parts{0}, color{0} {}
+    : idx{i}, locality{-1}, global_addx{HPX_NULL}, n_parts{0}, color{0},
+      id{0}, n_in{0}, n_out{0}, n_claimed{0}, n_stored{0} {}
 
-  /// Utility routine to add an edge to the DAG
-  void add_out_edge(DAGNode *end, Operation op, int weight) {
-    out_edges.push_back(DAGEdge{this, end, op, weight});
-  }
+  DAGNode(const DAGNode &other) = delete;
+  DAGNode &operator=(const DAGNode &other) = delete;
+};
 
-  /// Utility routine to add an edge to the DAG
-  void add_in_edge(DAGNode *start, Operation op, int weight) {
-    in_edges.push_back(DAGEdge{start, this, op, weight});
-  }
+
+/// Hand-off of the edges of an implicit DAG
+///
+/// An implicit DAG does not keep its edges. Instead, the Method is applied
+/// twice. The first time, the edges are only counted, which is enough to
+/// create the LCOs. The second time, each edge is given to @p put as it is
+/// found, along with a slot of its own among the edges leaving its source
+/// node, so that the object serving that node can store it in place. Once
+/// every edge leaving a node has been put, @p close is called for the node.
+/// See DAG::set_handoff(), DualTree::create_DAG() and DualTree::emit_DAG().
+struct DAGImplicit {
+  void (*put)(void *context, DAGNode *node, uint32_t slot,
+              const DAGEdge &edge);
+  void (*close)(void *context, DAGNode *node);
+  void *context;    /// passed to put and close
 };
 
 
@@ -91,11 +118,145 @@ struct DAGNode {
 /// associated with the nodes of the source tree, and the nods of the DAG
 /// associated with the nodes of the target tree.
 ///
+/// The edges are not directly accessible. While the DAG is built, the edges
+/// are added with add_edge(), which takes no locks: each thread keeps the
+/// edges it finds in its own buffer. Once the nodes are collected, the
+/// DAG is finalized, which moves the edges into a compressed sparse row
+/// layout: each edge is stored once, with the out edges of each node, as the
+/// id of its target node, an 8-bit operation code and a weight. The in edges
+/// are found from an index that is only built if it is needed.
+///
+/// An implicit DAG keeps only the number of edges leaving and entering each
+/// node; see DAGImplicit.
+///
 /// Typically, DASHMM users implementing a new Method will work with DAGInfo
 /// objects rather than the DAG directly.
 class DAG {
  public:
-  DAG() : source_leaves{}, source_nodes{}, target_nodes{}, target_leaves{} { }
+  /// Construct a DAG
+  ///
+  /// This cannot be used outside of an HPX-5 thread.
+  ///
+  /// \param implicit - do not keep the edges; see DAGImplicit
+  explicit DAG(bool implicit = false)
+      : source_leaves{}, source_nodes{}, target_nodes{}, target_leaves{},
+        found_(implicit ? 0 : hpx_get_num_threads()), handoff_{nullptr},
+        offsets_{}, targets_{}, ops_{}, weights_{}, in_degree_{},
+        in_offsets_{}, in_index_{}, implicit_{implicit},
+        keep_leaves_{false} { }
+
+  DAG(const DAG &other) = delete;
+  DAG &operator=(const DAG &other) = delete;
+
+  /// Add an edge to the DAG
+  ///
+  /// This is safe to call concurrently, and takes no locks. The edge is kept
+  /// in a buffer of the calling thread until the DAG is finalized. For an
+  /// implicit DAG, the edge is instead counted at both of its nodes, or, once
+  /// a hand-off is set, put to the hand-off in a slot of its own, and the
+  /// source node is closed once all the edges leaving it are put; see
+  /// DAGImplicit. The DAG itself holds none of these edges. Only the edges
+  /// leaving nodes placed on the calling rank are handed off; the others are
+  /// dropped as they are found.
+  ///
+  /// This must be called from inside an HPX-5 thread, and the calling thread
+  /// must not be suspended during the call.
+  ///
+  /// \param source - the node from which the edge leaves
+  /// \param target - the node at which the edge ends
+  /// \param op - the operation to perform along the edge
+  /// \param weight - the weight of the operation
+  void add_edge(DAGNode *source, DAGNode *target, Operation op, int weight);
+
+  /// Set where the edges of an implicit DAG are handed off
+  ///
+  /// Once the DAG is finalized, its edges are emitted by applying the Method
+  /// again with this set. The number of edges leaving each node must be the
+  /// same as when they were counted.
+  ///
+  /// \param handoff - the hand-off, or nullptr once the edges are emitted
+  void set_handoff(const DAGImplicit *handoff) {handoff_ = handoff;}
+
+  /// Are the edges of an implicit DAG being emitted
+  bool emitting() const {return handoff_ != nullptr;}
+
+  /// Compress the edges of the DAG
+  ///
+  /// This numbers the nodes in the order of source_leaves, source_nodes,
+  /// target_nodes and target_leaves, and moves the edges that were found
+  /// while the DAG was built into the compressed form. The nodes must not be
+  /// changed after this is called.
+  ///
+  /// Node ids are 32 bit, so the DAG may have fewer than 2^32 - 1 nodes,
+  /// and each node fewer than 2^32 - 1 in edges. The number of edges is not
+  /// limited. The program ends with an error if either limit is exceeded.
+  ///
+  /// For an implicit DAG, only the number of edges of each node is taken
+  /// from the counts kept with the nodes, and the DAG has no edges.
+  void finalize();
+
+  /// Keep the edges leaving the source leaves
+  ///
+  /// A DAG that is evaluated more than once is started again at the source
+  /// leaves for each evaluation, while the other edges are held by the LCOs.
+  /// When this is set, the edges leaving the source leaves are kept by
+  /// release_edges(), and an implicit DAG stores those edges as they are
+  /// emitted; see store_out_edge(). This must be set before the DAG is
+  /// finalized.
+  void keep_leaf_edges() {keep_leaves_ = true;}
+
+  /// Are the edges leaving the source leaves kept
+  bool keeps_leaf_edges() const {return keep_leaves_;}
+
+  /// Store an edge leaving a source leaf of an implicit DAG
+  ///
+  /// This is only used if keep_leaf_edges() was set. Each edge has its own
+  /// slot, so this is safe to call concurrently.
+  ///
+  /// \param node - the source leaf
+  /// \param slot - the slot of the edge among those leaving @p node; see
+  ///               DAGImplicit
+  /// \param edge - the edge
+  void store_out_edge(const DAGNode *node, uint32_t slot,
+                      const DAGEdge &edge);
+
+  /// Is the DAG implicit
+  ///
+  /// The edges of an implicit DAG are not kept, and so none of the methods
+  /// returning edges may be used, except as allowed by keep_leaf_edges();
+  /// the degrees of the nodes are available.
+  bool implicit() const {return implicit_;}
+
+  /// Release the edges of the DAG
+  ///
+  /// Once the LCOs are created, and the edges have been copied into them,
+  /// the edges are no longer needed. This frees the memory they use, so that
+  /// it is not held for the evaluation. The nodes are kept, but none of the
+  /// methods concerning edges may be used after this, except for out_edges()
+  /// and out_degree() of the source leaves if keep_leaf_edges() was set.
+  void release_edges();
+
+  /// The number of edges leaving a node
+  size_t out_degree(const DAGNode *node) const {
+    return offsets_[node->id + 1] - offsets_[node->id];
+  }
+
+  /// The number of edges entering a node
+  size_t in_degree(const DAGNode *node) const {
+    return in_degree_[node->id];
+  }
+
+  /// The edges leaving a node
+  std::vector<DAGEdge> out_edges(const DAGNode *node) const;
+
+  /// The edges entering a node
+  ///
+  /// The index of the in edges is built by the first call, so this must not
+  /// be called concurrently.
+  std::vector<DAGEdge> in_edges(const DAGNode *node);
+
+  /// Return the node with the given id
+  DAGNode *node_from_id(uint32_t id) const;
 
   /// Print the DAG out in JSON format.
   ///
@@ -128,6 +289,14 @@ class DAG {
   /// Count edges in the full DAG
   size_t edge_count() const;
 
+  /// Return the number of bytes used by the nodes of the DAG
+  size_t node_bytes() const;
+
+  /// Return the number of bytes used by the edges of the DAG
+  ///
+  /// Before the DAG is finalized, this counts the edges kept by each thread.
+  size_t edge_bytes() const;
+
   /// Return the average out degree of each class of node and the overall
   // NOTE: source leaves, source nodes, target nodes, target leaves, overall
   std::vector<double> average_out_degree() const;
@@ -141,6 +310,27 @@ class DAG {
   std::vector<DAGNode *> source_nodes;
   std::vector<DAGNode *> target_nodes;
   std::vector<DAGNode *> target_leaves;
+
+ private:
+  /// Return the id of the node from which an edge leaves
+  uint32_t edge_source(size_t edge) const;
+
+  /// Build the index of the in edges
+  void index_in_edges();
+
+  std::vector<std::vector<DAGEdge>> found_;  /// the edges found by each
+                                             /// thread while building
+  const DAGImplicit *handoff_;      /// where emitted edges are handed off
+  std::vector<size_t> offsets_;     /// the first out edge of each node
+  std::vector<uint32_t> targets_;   /// the target node of each edge
+  std::vector<uint8_t> ops_;        /// the operation of each edge
+  std::vector<int> weights_;        /// the weight of each edge
+  std::vector<uint32_t> in_degree_; /// the number of in edges of each node
+  std::vector<size_t> in_offsets_;  /// the first in edge of each node
+  std::vector<size_t> in_index_;    /// the in edges, as offsets in targets_
+  bool implicit_;                   /// the edges are not kept
+  bool keep_leaves_;                /// the edges leaving the source leaves
+                                    /// are kept by release_edges()
 };
 
 
@@ -157,48 +347,29 @@ class DAG {
 /// basis. Source and Target nodes will be created during tree construction.
 /// Intermediate nodes should be added by Methods that need them.
 ///
-/// This object uses HPX-5 to manage the concurrent modification of the DAG,
-/// so this object cannot be used outside of an HPX-5 thread. DASHMM users will
-/// have no reason to create these objects directly; the library will manage
-/// the creation of these objects.
+/// The DAG may be modified concurrently by the threads applying the Method.
+/// This object takes no locks: the DAG nodes are created with atomic
+/// operations, and the edges are added to the DAG being built; see
+/// DAG::add_edge(). Edges can only be added from inside an HPX-5 thread.
+/// DASHMM users will have no reason to create these objects directly; the
+/// library will manage the creation of these objects.
 class DAGInfo {
  public:
   /// Construct the DAGInfo
   DAGInfo()
-      : idx_{0, 0, 0, 0}, normal_{nullptr}, interm_{nullptr}, parts_{nullptr} {
-    lock_ = hpx_lco_sema_new(1);
-    assert(lock_ != HPX_NULL);
-  }
+      : idx_{0, 0, 0, 0}, dag_{nullptr}, normal_{nullptr}, interm_{nullptr},
+        parts_{nullptr} { }
 
   /// Construct the DAGInfo
-  ///
-  /// This cannot be used outside of an HPX-5 thread.
-  DAGInfo(Index idx) : idx_{idx} {
-    normal_ = nullptr;
-    interm_ = nullptr;
-    parts_ = nullptr;
-    lock_ = hpx_lco_sema_new(1);
-    assert(lock_ != HPX_NULL);
-  }
+  DAGInfo(Index idx)
+      : idx_{idx}, dag_{nullptr}, normal_{nullptr}, interm_{nullptr},
+        parts_{nullptr} { }
 
   /// Destroy the DAGInfo
   ///
-  /// This will free any resources acquired by this object. This cannot be used
-  /// outside of an HPX-5 thread.
+  /// This will free any resources acquired by this object.
   ~DAGInfo() {
-    hpx_lco_delete_sync(lock_);
-    if (normal_) {
-      delete normal_;
-      normal_ = nullptr;
-    }
-    if (interm_ != nullptr) {
-      delete interm_;
-      interm_ = nullptr;
-    }
-    if (parts_ != nullptr) {
-      delete parts_;
-      parts_ = nullptr;
-    }
+    clear();
   }
 
   /// Return the index of the associated Tree Node
@@ -207,20 +378,27 @@ class DAGInfo {
   /// Set the index of the DAGInfo object
   void set_index(const Index &index) {idx_ = index;}
 
+  /// Set the DAG to which edges are added
+  ///
+  /// This must be set while the Method is applied. The DAG must outlive its
+  /// use by the Method.
+  ///
+  /// \param dag - the DAG being built, or nullptr once it is built
+  void set_DAG(DAG *dag) {dag_ = dag;}
+
+  /// Is the DAG being created implicit
+  bool implicit() const {return dag_ != nullptr && dag_->implicit();}
+
   /// Add the normal node
   ///
   /// This will add a normal DAG node for the tree node owning this object.
   ///
+  /// When the edges of an implicit DAG are emitted, the node made when they
+  /// were counted is counted as allocated.
+  ///
   /// \returns - true is DAGNode was allocated; false otherwise
   bool add_normal() {
-    bool retval = false;
-    lock();
-    if (normal_ == nullptr) {
-      normal_ = new DAGNode{idx_};
-      retval = true;
-    }
-    unlock();
-    return retval;
+    return add_node(normal_);
   }
 
   /// Add an intermediate node
@@ -228,29 +406,42 @@ class DAGInfo {
   /// This will add an intermediate DAG node for the tree node associated
   /// with this object.
   ///
+  /// As for add_normal(), the node made when the edges of an implicit DAG
+  /// were counted is counted as allocated when they are emitted.
+  ///
   /// \returns - true is the node was allocated; false otherwsie
   bool add_interm() {
-    bool retval = false;
-    lock();
-    if (interm_ == nullptr) {
-      interm_ = new DAGNode{idx_};
-      retval = true;
-    }
-    unlock();
-    return retval;
+    return add_node(interm_);
   }
 
   /// Add a particle node
   ///
   /// This will add a particle DAG node for the tree node associated with this
   /// object. This will represent either sources in the source tree, or
-  /// targets in the target tree.
+  /// targets in the target tree. When the edges of an implicit DAG are
+  /// emitted, the node already exists, and this does nothing.
   void add_parts() {
+    if (emitting()) {
+      assert(parts_ != nullptr);
+      return;
+    }
     assert(parts_ == nullptr);
     parts_ = new DAGNode{idx_};
     assert(parts_ != nullptr);
   }
 
+  /// Remove the DAG nodes
+  ///
+  /// This deletes any DAG nodes associated with the tree node, so that a new
+  /// DAG can be created for a tree that is reused. Any LCOs served by those
+  /// DAG nodes must already have been destroyed.
+  void clear() {
+    delete normal_.exchange(nullptr);
+    delete interm_.exchange(nullptr);
+    delete parts_;
+    parts_ = nullptr;
+  }
+
   DAGInfo(const DAGInfo &other) = delete;
   DAGInfo &operator=(const DAGInfo &other) = delete;
   DAGInfo(const DAGInfo &&other) = delete;
@@ -283,7 +474,7 @@ class DAGInfo {
   /// \param expand - the expansion LCO represented by this object's normal
   ///                 DAG node.
   void set_normal_expansion(const hpx_addr_t addx) {
-    normal_->global_addx = addx;
+    normal()->global_addx = addx;
   }
 
   /// Sets the global data for the intermediate DAG node
@@ -296,7 +487,7 @@ class DAGInfo {
   ///                 intermediate DAG node.
   void set_interm_expansion(const hpx_addr_t addx) {
     if (interm_ != nullptr) {
-      interm_->global_addx = addx;
+      interm()->global_addx = addx;
     }
   }
 
@@ -326,14 +517,30 @@ class DAGInfo {
   /// Sets locality on the normal node
   void set_normal_locality(int loc) {
     if (normal_ != nullptr) {
-      normal_->locality = loc;
+      normal()->locality = loc;
     }
   }
 
   /// Sets locality on the intermediate node
   void set_interm_locality(int loc) {
     if (interm_ != nullptr) {
-      interm_->locality = loc;
+      interm()->locality = loc;
+    }
+  }
+
+  /// Sets locality on the normal and intermediate nodes if they have none
+  ///
+  /// The distribution policies place some nodes by their edges, which an
+  /// implicit DAG does not keep. Such nodes are instead given a locality as
+  /// the DAG is created.
+  void set_default_locality(int loc) {
+    DAGNode *normal = normal_;
+    if (normal != nullptr && normal->locality < 0) {
+      normal->locality = loc;
+    }
+    DAGNode *interm = interm_;
+    if (interm != nullptr && interm->locality < 0) {
+      interm->locality = loc;
     }
   }
 
@@ -517,7 +724,8 @@ class DAGInfo {
 
   /// Utility routine to connect nodes of the DAG
   ///
-  /// This connects the given node with the specified operation.
+  /// This connects the given node with the specified operation by adding
+  /// the edge to the DAG being built; see DAG::add_edge().
   ///
   /// \param src_info - the DAGInfo object containing the source node
   /// \param source - the DAGNode that is the source of the edge being added
@@ -528,30 +736,39 @@ class DAGInfo {
   static void link_nodes(DAGInfo *src_info, DAGNode *source,
                          DAGInfo *dest_info, DAGNode *dest,
                          Operation op, int weight) {
-    dest_info->lock();
-    dest->add_in_edge(source, op, weight);
-    dest_info->unlock();
-
-    src_info->lock();
-    source->add_out_edge(dest, op, weight);
-    src_info->unlock();
+    assert(dest_info->dag_ != nullptr);
+    dest_info->dag_->add_edge(source, dest, op, weight);
   }
 
  private:
-  /// Lock the node
-  void lock() {
-    hpx_lco_sema_p(lock_);
-  }
+  /// Are the edges of an implicit DAG being emitted
+  bool emitting() const {return dag_ != nullptr && dag_->emitting();}
 
-  /// Unlock the node
-  void unlock() {
-    hpx_lco_sema_v(lock_, HPX_NULL);
+  /// Add a node unless it exists
+  ///
+  /// Concurrent calls create at most one node.
+  ///
+  /// \param node - the node to add
+  ///
+  /// \returns - true if the node was allocated, or if the edges of an
+  ///             implicit DAG are emitted; false otherwise
+  bool add_node(std::atomic<DAGNode *> &node) {
+    if (node.load() != nullptr) {
+      return emitting();
+    }
+    DAGNode *created = new DAGNode{idx_};
+    DAGNode *expected{nullptr};
+    if (!node.compare_exchange_strong(expected, created)) {
+      delete created;
+      return emitting();
+    }
+    return true;
   }
 
   Index idx_;
-  hpx_addr_t lock_;
-  DAGNode *normal_;
-  DAGNode *interm_;
+  DAG *dag_;
+  std::atomic<DAGNode *> normal_;
+  std::atomic<DAGNode *> interm_;
   DAGNode *parts_;   // source or target
 };
 
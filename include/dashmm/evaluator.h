@@ -20,6 +20,15 @@
 /// \brief Definition of DASHMM Evaluator object
 
 
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <map>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include <hpx/hpx.h>
 #include <libhpx/libhpx.h>
 
@@ -30,9 +39,11 @@
 #include "dashmm/expansionlco.h"
 #include "dashmm/point.h"
 #include "dashmm/rankwise.h"
+#include "dashmm/reductionops.h"
 #include "dashmm/registrar.h"
 #include "dashmm/targetlco.h"
 #include "dashmm/tree.h"
+#include "dashmm/treestatistics.h"
 
 
 namespace dashmm {
@@ -44,8 +55,13 @@ namespace dashmm {
 /// two responsibilities: performing multipole method evaluations, and
 /// registration of actions with the runtime system.
 ///
-/// The interface for the object contains only one member, evaluate(), which
-/// performs a multipole method evaluation.
+/// The main member of the interface is evaluate(), which performs a
+/// multipole method evaluation. The tree built for an evaluation can be kept
+/// for the next evaluation with retain_tree(), along with its DAG and LCOs
+/// with retain_dag(), and a kept tree can be handed to the Evaluator of
+/// another kernel or method with adopt_tree(). The shape of the tree can be
+/// examined before evaluating with tree_statistics(), and the refinement
+/// limit can be chosen automatically with tune_refinement_limit().
 ///
 /// In addition, the object's constructor performs its second duty. DASHMM is
 /// a templated library. HPX-5 requires the address of functions that are to
@@ -84,6 +100,7 @@ class Evaluator {
   using targetnode_t = Node<Target>;
   using dualtree_t = DualTree<Source, Target, Expansion, Method>;
   using distropolicy_t = typename method_t::distropolicy_t;
+  using dualtreedata_t = DualTreeData<Source, Target>;
 
   /// The constuctor takes care of all action registration that DASHMM needs
   /// for one particular combination of Source, Target, Expansion and Method.
@@ -91,7 +108,15 @@ class Evaluator {
   /// had a number. Finally, a few Evaluator specific actions are registered
   /// in this constructor.
   Evaluator() : tlcoreg_{}, elcoreg_{}, snodereg_{}, tnodereg_{},
-                streereg_{}, ttreereg_{}, dtreereg_{} {
+                streereg_{}, ttreereg_{}, dtreereg_{}, retain_{false},
+                margin_{0.0}, kept_{HPX_NULL}, kept_sources_{HPX_NULL},
+                kept_targets_{HPX_NULL}, kept_limit_{0},
+                kept_target_limit_{0}, kept_adaptive_{false}, adopted_{false},
+                target_limit_{0}, adaptive_{false}, tune_{false},
+                tuned_limits_{}, implicit_{false}, retain_dag_{false},
+                kept_dag_{false}, kept_digits_{0}, kept_method_{},
+                kept_kernelparams_{}, kept_distro_{}, unif_cost_{HPX_NULL},
+                edge_bytes_{0} {
     // Actions for the evaluation
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_MARSHALLED,
                         evaluate_, evaluate_handler,
@@ -101,7 +126,20 @@ class Evaluator {
                         HPX_POINTER, HPX_SIZE_T);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         evaluate_cleanup_, evaluate_cleanup_handler,
-                        HPX_ADDR, HPX_ADDR, HPX_ADDR);
+                        HPX_ADDR, HPX_ADDR, HPX_ADDR, HPX_INT, HPX_ADDR,
+                        HPX_ADDR, HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        release_tree_, release_tree_handler,
+                        HPX_ADDR, HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        export_tree_, export_tree_handler,
+                        HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        import_tree_, import_tree_handler,
+                        HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_MARSHALLED,
+                        statistics_, statistics_handler,
+                        HPX_POINTER, HPX_SIZE_T);
   }
 
   /// Perform a multipole moment evaluation
@@ -123,7 +161,9 @@ class Evaluator {
   ///
   /// The refinement limit controls the partitioning of the domain. A given
   /// portion of the domain will be subdivided if there are more than the
-  /// given number of sources or targets in that region.
+  /// given number of sources or targets in that region. The targets can be
+  /// given their own limit, and the limits can be adapted to the density of
+  /// the points; see refinement_limits().
   ///
   /// The provided method is used as prototypes for any other copies of those
   /// objects that are required. Some methods have data associated with them.
@@ -134,6 +174,24 @@ class Evaluator {
   /// Finally, @distro is an optional parameter if the user would like the
   /// provide a policy that is not default constructed.
   ///
+  /// If the tree is retained (see retain_tree()), and the tree from the
+  /// previous evaluation was built for the same @p sources, @p targets and
+  /// @p refinement_limit, that tree is updated for the current positions of
+  /// the points instead of being built again. The same holds for a tree
+  /// taken from another Evaluator with adopt_tree(), except that the tree is
+  /// used as it is.
+  ///
+  /// If the refinement limit is tuned (see tune_refinement_limit()), and a
+  /// limit has already been chosen for @p n_digits and @p kernelparams, that
+  /// limit is used in place of @p refinement_limit.
+  ///
+  /// If the DAG is implicit (see implicit_dag()), its edges are not stored.
+  ///
+  /// If the DAG is retained (see retain_dag()), and the DAG of the previous
+  /// evaluation was kept with the tree used here, for the same @p method,
+  /// @p n_digits, @p kernelparams and @p distro, that DAG and its LCOs are
+  /// evaluated again, so that only the evaluation itself is done.
+  ///
   /// \param sources - a DASHMM Array of the source points
   /// \param targets - a DASHMM Array of the target points
   /// \param refinement_limint - the domain refinement limit
@@ -150,6 +208,30 @@ class Evaluator {
                       int refinement_limit, const method_t &method,
                       int n_digits, const std::vector<double> &kernelparams,
                       const distropolicy_t &distro = distropolicy_t { }) {
+    // A tuned limit replaces the given limit
+    bool tune{false};
+    auto tuning_key = std::make_pair(n_digits, kernelparams);
+    if (tune_) {
+      auto tuned = tuned_limits_.find(tuning_key);
+      if (tuned != tuned_limits_.end()) {
+        refinement_limit = tuned->second;
+      } else if (!implicit_) {
+        tune = true;
+      }
+    }
+
+    // The kept DAG is only valid for the tree used as it is
+    bool reuse = can_reuse(sources, targets, refinement_limit);
+    bool keep_dag = retain_ && retain_dag_;
+    bool reuse_dag = keep_dag && reuse && kept_dag_
+                     && n_digits == kept_digits_
+                     && same_as_kept(method, kept_method_)
+                     && kernelparams == kept_kernelparams_
+                     && same_as_kept(distro, kept_distro_);
+    if (reuse_dag) {
+      tune = false;
+    }
+
     // pack the arguments and call the action
     size_t n_params = kernelparams.size();
     size_t total_size = sizeof(EvaluateParams) + n_params * sizeof(double);
@@ -164,20 +246,361 @@ class Evaluator {
     args->rwaddr = HPX_NULL;
     args->alldone = HPX_NULL;
     args->middone = HPX_NULL;
+    args->target_limit = target_limit_;
+    args->adaptive = adaptive_ ? 1 : 0;
+    args->kept = kept_;
+    args->reuse = reuse ? 1 : 0;
+    args->adopted = adopted_ ? 1 : 0;
+    args->retain = retain_ ? 1 : 0;
+    args->margin = margin_;
+    args->tune = tune ? 1 : 0;
+    args->tuning = HPX_NULL;
+    args->edge_bytes = HPX_NULL;
+    args->implicit = implicit_ ? 1 : 0;
+    args->keep_dag = keep_dag ? 1 : 0;
+    args->reuse_dag = reuse_dag ? 1 : 0;
+    args->unif_cost = unif_cost_;
     for (size_t i = 0; i < n_params; ++i) {
       args->kernelparams[i] = kernelparams[i];
     }
 
-    if (HPX_SUCCESS != hpx_run(&evaluate_, nullptr, args, total_size)) {
+    EvaluateResult result{HPX_NULL, {0.0, 0.0, 0.0}, HPX_NULL, 0};
+    if (HPX_SUCCESS != hpx_run(&evaluate_, &result, args, total_size)) {
       return kRuntimeError;
     }
 
     delete [] args;
 
+    if (tune) {
+      tuned_limits_[tuning_key] = choose_limit(refinement_limit, result.cost);
+    }
+
+    kept_ = result.kept;
+    unif_cost_ = result.unif_cost;
+    edge_bytes_ = result.edge_bytes;
+    kept_sources_ = sources.data();
+    kept_targets_ = targets.data();
+    kept_limit_ = refinement_limit;
+    kept_target_limit_ = target_limit_;
+    kept_adaptive_ = adaptive_;
+    adopted_ = false;
+    kept_dag_ = keep_dag && kept_ != HPX_NULL;
+    kept_digits_ = n_digits;
+    memcpy(kept_method_, &method, sizeof(method_t));
+    kept_kernelparams_ = kernelparams;
+    memcpy(kept_distro_, &distro, sizeof(distropolicy_t));
+
     return kSuccess;
   }
 
+  /// Set how the trees are refined
+  ///
+  /// By default, both the source and the target trees are refined until
+  /// their leaves hold no more records than the refinement limit given to
+  /// evaluate(). When the sources and targets have very different densities,
+  /// as when a sparse set of targets probes a dense cloud of sources, the
+  /// same limit makes leaves that are too small in one of the trees. This
+  /// gives the target tree its own limit, @p target_limit, so that the limit
+  /// given to evaluate() only applies to the source tree.
+  ///
+  /// If @p adaptive is true, each tree is further refined only where that
+  /// pays off given the density of the other tree nearby: a leaf is not
+  /// split when its number of records, times the number of records of the
+  /// other tree expected in its region, is no more than the product of the
+  /// two limits. Where the other tree is sparse, the leaves are larger, so
+  /// that the DAG has fewer nodes and fewer operations. See
+  /// DualTree::set_leaf_limits() for details.
+  ///
+  /// When the sources and targets are the same Array, both trees are the
+  /// same, and these settings have no effect.
+  ///
+  /// \param target_limit - the refinement limit of the target tree; if
+  ///                       zero, the limit given to evaluate() is used
+  /// \param adaptive - adapt the limits to the density of the points
+  void refinement_limits(int target_limit, bool adaptive = false) {
+    target_limit_ = target_limit > 0 ? target_limit : 0;
+    adaptive_ = adaptive;
+  }
+
+  /// Keep the tree between evaluations
+  ///
+  /// When the tree is retained, the tree built during evaluate() is kept
+  /// once the evaluation is complete. If the next evaluation is for the same
+  /// Arrays and refinement limit, the tree is updated for the new positions
+  /// of the points, which is much cheaper than building it again when the
+  /// points have moved only a little, as in time-stepping. The domain of a
+  /// retained tree is made larger than the points require by the fraction
+  /// @p margin, so that the points may move out of the initial domain a bit
+  /// before a new tree must be built.
+  ///
+  /// A retained tree is destroyed by release_tree(), or by the first
+  /// evaluation that cannot use it. Any DAG kept with the tree (see
+  /// retain_dag()) is destroyed with it.
+  ///
+  /// \param retain - keep the tree between evaluations
+  /// \param margin - the fraction by which to enlarge the domain of the tree
+  void retain_tree(bool retain, double margin = 0.1) {
+    retain_ = retain;
+    margin_ = retain ? margin : 0.0;
+  }
+
+  /// Destroy the retained tree
+  ///
+  /// When DASHMM_COST_WEIGHTED_PARTITION is defined, this also destroys the
+  /// cost estimated during the previous evaluation, so the next partition is
+  /// weighted by the number of points.
+  ///
+  /// \returns - kSuccess on success; kRuntimeError if there is an error with
+  ///            the runtime.
+  ReturnCode release_tree() {
+    if (kept_ == HPX_NULL && unif_cost_ == HPX_NULL) {
+      return kSuccess;
+    }
+
+    if (HPX_SUCCESS != hpx_run(&release_tree_, nullptr, &kept_,
+                               &unif_cost_)) {
+      return kRuntimeError;
+    }
+    kept_ = HPX_NULL;
+    unif_cost_ = HPX_NULL;
+    adopted_ = false;
+    kept_dag_ = false;
+
+    return kSuccess;
+  }
+
+  /// Take the tree retained by another Evaluator
+  ///
+  /// The tree depends only on the sources and targets, and not on the kernel
+  /// or the method. When the same points are evaluated with several kernels
+  /// or methods, the tree retained by the Evaluator of one of them can be
+  /// handed to the next, so that the tree is built once for all of them, and
+  /// only the DAG and the expansions are created by each evaluation.
+  ///
+  /// The tree is moved, not copied: @p other no longer has a retained tree
+  /// afterwards, and any tree retained by this object is released first. The
+  /// next evaluate() uses the tree as it is if it is for the same Arrays and
+  /// refinement limit as the evaluation that built it, so the points must
+  /// not have moved in the meantime; the settings of refinement_limits() must
+  /// also be the same. The tree is kept after that evaluation
+  /// only if this object retains its trees (see retain_tree()), so that it
+  /// can be handed on to yet another Evaluator.
+  ///
+  /// \param other - the Evaluator with the retained tree
+  ///
+  /// \returns - kSuccess on success; kRuntimeError if there is an error with
+  ///            the runtime.
+  template <template <typename, typename> class E2,
+            template <typename, typename,
+                      template <typename, typename> class> class M2>
+  ReturnCode adopt_tree(Evaluator<Source, Target, E2, M2> &other) {
+    if (other.kept_ == HPX_NULL) {
+      return kSuccess;
+    }
+    if (kSuccess != release_tree()) {
+      return kRuntimeError;
+    }
+
+    hpx_addr_t data{HPX_NULL};
+    if (HPX_SUCCESS != hpx_run(&other.export_tree_, &data, &other.kept_)) {
+      return kRuntimeError;
+    }
+    other.kept_ = HPX_NULL;
+    other.adopted_ = false;
+    other.kept_dag_ = false;
+
+    hpx_addr_t kept{HPX_NULL};
+    if (HPX_SUCCESS != hpx_run(&import_tree_, &kept, &data)) {
+      return kRuntimeError;
+    }
+
+    kept_ = kept;
+    kept_sources_ = other.kept_sources_;
+    kept_targets_ = other.kept_targets_;
+    kept_limit_ = other.kept_limit_;
+    kept_target_limit_ = other.kept_target_limit_;
+    kept_adaptive_ = other.kept_adaptive_;
+    adopted_ = true;
+
+    return kSuccess;
+  }
+
+  /// Partition the points and report the shape of the tree
+  ///
+  /// This builds the tree that evaluate() would use for the same arguments,
+  /// and gathers statistics about it: the nodes and leaves at each level, a
+  /// histogram of the number of records in the leaves, the depth, and the
+  /// number of records and of nodes on each rank. This can be used to choose
+  /// a refinement limit, or to detect load imbalance, before paying for the
+  /// DAG and the evaluation.
+  ///
+  /// If the tree is retained (see retain_tree()), the tree is kept, and is
+  /// used by the next evaluate() with the same arguments. Otherwise, the
+  /// tree is destroyed. Likewise, a retained or adopted tree is used here if
+  /// it fits the arguments.
+  ///
+  /// \param sources - a DASHMM Array of the source points
+  /// \param targets - a DASHMM Array of the target points
+  /// \param refinement_limit - the domain refinement limit
+  /// \param stats [out] - the statistics of the tree
+  ///
+  /// \returns - kSuccess on success; kRuntimeError if there is an error with
+  ///            the runtime.
+  ReturnCode tree_statistics(const Array<source_t> &sources,
+                             const Array<target_t> &targets,
+                             int refinement_limit, TreeStatistics *stats) {
+    int num_ranks = hpx_get_num_ranks();
+    size_t n_values = TreeStatistics::packed_size(num_ranks);
+    size_t total_size = sizeof(StatisticsParams) + n_values * sizeof(size_t);
+    StatisticsParams *args =
+        reinterpret_cast<StatisticsParams *>(new char[total_size]);
+    args->sources = sources;
+    args->targets = targets;
+    args->refinement_limit = refinement_limit;
+    args->target_limit = target_limit_;
+    args->adaptive = adaptive_ ? 1 : 0;
+    args->kept = kept_;
+    args->reuse = can_reuse(sources, targets, refinement_limit) ? 1 : 0;
+    args->adopted = adopted_ ? 1 : 0;
+    args->retain = retain_ ? 1 : 0;
+    args->margin = margin_;
+    args->unif_level = 0;
+
+    // The results are returned in place of the arguments
+    if (HPX_SUCCESS != hpx_run(&statistics_, args, args, total_size)) {
+      delete [] reinterpret_cast<char *>(args);
+      return kRuntimeError;
+    }
+
+    kept_ = args->kept;
+    kept_sources_ = sources.data();
+    kept_targets_ = targets.data();
+    kept_limit_ = refinement_limit;
+    kept_target_limit_ = target_limit_;
+    kept_adaptive_ = adaptive_;
+    adopted_ = adopted_ && args->reuse;
+    kept_dag_ = false;
+
+    stats->unif_level = args->unif_level;
+    stats->unpack(args->data, num_ranks);
+
+    delete [] reinterpret_cast<char *>(args);
+
+    return kSuccess;
+  }
+
+  /// Choose the refinement limit from the measured cost of the evaluation
+  ///
+  /// A small refinement limit makes for many nodes, and so many operations
+  /// between expansions, while a large limit makes for many direct S->T
+  /// interactions. The best balance depends on the kernel, the accuracy and
+  /// the distribution of the points.
+  ///
+  /// When tuning, the first evaluation for a given accuracy and set of
+  /// kernel parameters uses the refinement limit it is given, and estimates
+  /// its own cost from the number of each operation in its DAG and from the
+  /// time taken by each kind of operation on a few leaves and edges of each
+  /// rank. The direct interactions are taken to grow in proportion to the
+  /// refinement limit, and the operations between expansions in inverse
+  /// proportion, and the limit for which the sum is smallest is used by the
+  /// following evaluations with the same accuracy and kernel parameters. As
+  /// the Evaluator is specific to the kernel, the result is kept for each
+  /// kernel, accuracy and set of kernel parameters, such as the screening
+  /// parameter of the Yukawa kernel.
+  ///
+  /// Only the refinement limit given to evaluate() is tuned. A separate
+  /// limit for the target tree (see refinement_limits()) is used as it is,
+  /// and the model takes the target leaves to be fixed.
+  ///
+  /// The cost is estimated from the edges of the DAG, so evaluations with an
+  /// implicit DAG (see implicit_dag()) do not choose a limit, though they use
+  /// one already chosen. Until a limit is chosen, tuned_refinement_limit()
+  /// returns zero.
+  ///
+  /// \param tune - choose the refinement limit automatically
+  void tune_refinement_limit(bool tune) {tune_ = tune;}
+
+  /// The refinement limit chosen for an accuracy and kernel parameters
+  ///
+  /// \param n_digits - the number of digits of accuracy
+  /// \param kernelparams - the parameters of the kernel
+  ///
+  /// \returns - the refinement limit chosen by tuning, or zero if no limit
+  ///            has been chosen for @p n_digits and @p kernelparams
+  int tuned_refinement_limit(int n_digits,
+                             const std::vector<double> &kernelparams =
+                                 std::vector<double>{}) const {
+    auto tuned = tuned_limits_.find(std::make_pair(n_digits, kernelparams));
+    return tuned == tuned_limits_.end() ? 0 : tuned->second;
+  }
+
+  /// Do not store the edges of the DAG
+  ///
+  /// The edges of the DAG are usually all found before the evaluation, and
+  /// are stored until they are copied into the LCOs. For very large problems
+  /// the edges dominate the memory used. When the DAG is implicit, the
+  /// Method is applied twice instead: first to count the edges of each node,
+  /// which is all that is needed to create the LCOs, and then again, once
+  /// the LCOs exist, to write each edge into its LCO as it is found. The
+  /// evaluation starts along each edge leaving a source leaf as it is found.
+  /// This trades a second application of the Method for the memory of the
+  /// edges; see dag_edge_bytes().
+  ///
+  /// As the edges are not available to the distribution policy, the nodes
+  /// that it would place by their edges are instead placed on the rank that
+  /// owns their part of the domain. The refinement limit is not tuned while
+  /// the DAG is implicit (see tune_refinement_limit()).
+  ///
+  /// \param implicit - do not store the edges of the DAG
+  void implicit_dag(bool implicit) {implicit_ = implicit;}
+
+  /// The memory taken by the edges of the DAG in the last evaluation
+  ///
+  /// For a DAG that is not implicit, this is the memory of all the edges
+  /// stored before they are copied into the LCOs. For an implicit DAG, the
+  /// edges are written into the LCOs as they are found, and only those from
+  /// a source leaf to a node on another rank are held for a while; this is
+  /// then the most memory those held at once. An evaluation that reuses the
+  /// kept DAG stores no edges. In each case, this is the sum over the ranks.
+  ///
+  /// \returns - the bytes of edges of the last evaluation
+  size_t dag_edge_bytes() const {return edge_bytes_;}
+
+  /// Keep the DAG between evaluations
+  ///
+  /// When the positions of the points are fixed, and only their other data
+  /// change between evaluations, as for the charges in an iterative solver,
+  /// the DAG, its distribution and its LCOs are the same for every
+  /// evaluation. When the DAG is retained, they are kept with the retained
+  /// tree once an evaluation is complete. The next evaluation for the same
+  /// Arrays, refinement limit, method, accuracy, kernel parameters and
+  /// distribution policy uses the tree as it is, and the LCOs are reset and
+  /// evaluated again, so that nothing is built.
+  ///
+  /// This only has an effect if the tree is retained (see retain_tree()).
+  /// The positions of the points, and the number of records, must not change
+  /// while the DAG is kept. The records may be reordered by an evaluation, so
+  /// the new data should be set with the help of an identifier stored in the
+  /// records. If the method, kernel parameters or distribution policy given
+  /// to evaluate() differ, the DAG is built again. The results are added to
+  /// the targets, as for any evaluation. The refinement limit is not tuned by
+  /// an evaluation that reuses the DAG.
+  ///
+  /// The kept DAG is destroyed with the tree, and also by an evaluation that
+  /// cannot use it, including one made after the DAG is no longer retained.
+  /// The edges leaving the source leaves are kept with the DAG, as the
+  /// evaluation starts from them; the other edges are only held by the LCOs.
+  ///
+  /// \param retain - keep the DAG between evaluations
+  void retain_dag(bool retain) {retain_dag_ = retain;}
+
  private:
+  template <typename S, typename T,
+            template <typename, typename> class E,
+            template <typename, typename,
+                      template <typename, typename> class> class M>
+  friend class Evaluator;
+
   /// Registrars that will be needed for evaluate to operate.
   TargetLCORegistrar<Source, Target, Expansion, Method> tlcoreg_;
   ExpansionLCORegistrar<Source, Target, Expansion, Method> elcoreg_;
@@ -187,25 +610,193 @@ class Evaluator {
   TreeRegistrar<Source, Target, Target, Expansion, Method> ttreereg_;
   DualTreeRegistrar<Source, Target, Expansion, Method> dtreereg_;
 
+  /// The tree kept from the previous evaluation
+  bool retain_;
+  double margin_;
+  hpx_addr_t kept_;
+  hpx_addr_t kept_sources_;
+  hpx_addr_t kept_targets_;
+  int kept_limit_;
+  int kept_target_limit_;
+  bool kept_adaptive_;
+  bool adopted_;        /// the kept tree was taken from another Evaluator
+
+  /// The settings of refinement_limits()
+  int target_limit_;
+  bool adaptive_;
+
+  /// The refinement limits chosen for each accuracy and kernel parameters
+  bool tune_;
+  std::map<std::pair<int, std::vector<double>>, int> tuned_limits_;
+
+  /// The DAG is implicit; see implicit_dag()
+  bool implicit_;
+
+  /// The DAG kept with the tree; see retain_dag()
+  bool retain_dag_;
+  bool kept_dag_;
+  int kept_digits_;
+  char kept_method_[sizeof(method_t)];        /// see same_as_kept()
+  std::vector<double> kept_kernelparams_;
+  char kept_distro_[sizeof(distropolicy_t)];  /// see same_as_kept()
+
+  /// The estimated cost of the uniform grid, a RankWise<UnifCost>; see
+  /// DualTree::record_unif_cost()
+  hpx_addr_t unif_cost_;
+
+  /// The bytes of edges of the last evaluation; see dag_edge_bytes()
+  size_t edge_bytes_;
+
   // The actions for evaluate
   static hpx_action_t evaluate_;
   static hpx_action_t evaluate_rank_local_;
   static hpx_action_t evaluate_cleanup_;
+  static hpx_action_t release_tree_;
+  static hpx_action_t export_tree_;
+  static hpx_action_t import_tree_;
+  static hpx_action_t statistics_;
+
+  /// Decide if the kept tree can be used for the given arguments
+  bool can_reuse(const Array<source_t> &sources,
+                 const Array<target_t> &targets, int refinement_limit) const {
+    return (retain_ || adopted_) && sources.data() == kept_sources_
+           && targets.data() == kept_targets_
+           && refinement_limit == kept_limit_
+           && target_limit_ == kept_target_limit_
+           && adaptive_ == kept_adaptive_;
+  }
+
+  /// Decide if an object is the same as the copy kept of it
+  ///
+  /// The method and the distribution policy are copied as bytes into the
+  /// parameters of the evaluation, so they are kept and compared as bytes.
+  /// Objects without data are always the same.
+  template <typename T>
+  static bool same_as_kept(const T &object, const char *kept) {
+    return std::is_empty<T>::value || !memcmp(&object, kept, sizeof(T));
+  }
 
   /// Parameters to evaluations
   struct EvaluateParams {
     Array<source_t> sources;
     Array<target_t> targets;
     size_t refinement_limit;
+    int target_limit;
+    int adaptive;
     method_t method;
     int n_digits;
     distropolicy_t distro;
     hpx_addr_t rwaddr;
     hpx_addr_t alldone;
     hpx_addr_t middone;
+    hpx_addr_t kept;
+    int reuse;
+    int adopted;
+    int retain;
+    double margin;
+    int tune;
+    hpx_addr_t tuning;
+    hpx_addr_t edge_bytes;
+    int implicit;
+    int keep_dag;
+    int reuse_dag;
+    hpx_addr_t unif_cost;
     double kernelparams[];
   };
 
+  /// Results of evaluations
+  struct EvaluateResult {
+    hpx_addr_t kept;      /// the retained tree
+    double cost[3];       /// the estimated cost; see DualTree::estimate_cost()
+    hpx_addr_t unif_cost; /// the estimated cost of the uniform grid
+    size_t edge_bytes;    /// see dag_edge_bytes()
+  };
+
+  /// Choose the refinement limit from the estimated cost of an evaluation
+  ///
+  /// The cost is modeled as a * limit + b / limit + c, fit to the estimated
+  /// cost for the limit used, and the minimum of the model is returned.
+  ///
+  /// \param limit - the refinement limit of the evaluation
+  /// \param cost - the estimated cost of the evaluation
+  ///
+  /// \returns - the refinement limit for which the model is smallest
+  static int choose_limit(int limit, const double *cost) {
+    if (cost[0] <= 0.0 || cost[1] <= 0.0) {
+      return limit;
+    }
+    double best = limit * sqrt(cost[1] / cost[0]);
+    return std::max(1, static_cast<int>(best + 0.5));
+  }
+
+  /// Parameters to, and results of, tree statistics
+  struct StatisticsParams {
+    Array<source_t> sources;
+    Array<target_t> targets;
+    int refinement_limit;
+    int target_limit;
+    int adaptive;
+    hpx_addr_t kept;
+    int reuse;
+    int adopted;
+    int retain;
+    double margin;
+    int unif_level;
+    size_t data[];
+  };
+
+  /// Get the tree for the given points
+  ///
+  /// The kept tree is used if possible, after updating it unless it was
+  /// adopted. Otherwise, it is destroyed, and a new tree is created and
+  /// partitioned.
+  ///
+  /// \param sources - the source points
+  /// \param targets - the target points
+  /// \param refinement_limit - the domain refinement limit
+  /// \param target_limit - the refinement limit of the targets; zero for
+  ///                       the same as @p refinement_limit
+  /// \param adaptive - adapt the limits to the density of the points
+  /// \param kept - global address of the kept DualTree; may be HPX_NULL
+  /// \param reuse - can the kept tree be used for these points
+  /// \param adopted - was the kept tree taken from another Evaluator
+  /// \param margin - the fraction by which to enlarge the domain
+  /// \param unif_cost - the estimated cost of the uniform grid with which to
+  ///                    weight the partition; may be HPX_NULL
+  ///
+  /// \returns - the tree
+  static RankWise<dualtree_t> prepare_tree(const Array<source_t> &sources,
+                                           const Array<target_t> &targets,
+                                           int refinement_limit,
+                                           int target_limit, int adaptive,
+                                           hpx_addr_t kept, int reuse,
+                                           int adopted, double margin,
+                                           hpx_addr_t unif_cost = HPX_NULL) {
+    RankWise<dualtree_t> global_tree{kept};
+    bool updated{false};
+    if (kept != HPX_NULL) {
+      if (reuse && adopted) {
+        updated = true;
+      } else if (reuse) {
+        updated = dualtree_t::update(global_tree, sources, targets);
+      }
+      if (!updated) {
+        dualtree_t::destroy(global_tree);
+      }
+    }
+
+    if (!updated) {
+      global_tree = dualtree_t::create(refinement_limit, sources, targets,
+                                       margin, target_limit, adaptive != 0);
+      hpx_addr_t partitiondone =
+          dualtree_t::partition(global_tree, sources, targets, unif_cost);
+      hpx_lco_wait(partitiondone);
+      hpx_lco_delete_sync(partitiondone);
+    }
+
+    return global_tree;
+  }
+
   /// The evaluation action implementation
   ///
   /// This action is a diffusive action that starts the evaluation process.
@@ -225,13 +816,21 @@ class Evaluator {
 #ifdef DASHMMEXTRATIMING
     hpx_time_t creation_begin = hpx_time_now();
 #endif
+#ifdef DASHMM_COST_WEIGHTED_PARTITION
+    // The estimated cost is kept by each Evaluator
+    if (parms->unif_cost == HPX_NULL) {
+      RankWise<UnifCost> global_cost{};
+      global_cost.allocate();
+      parms->unif_cost = global_cost.data();
+    }
+#endif
+    // A tree kept from the previous evaluation is updated if possible, but
+    // is used as it is with its kept DAG
     RankWise<dualtree_t> global_tree =
-        dualtree_t::create(parms->refinement_limit, parms->sources,
-                           parms->targets);
-    hpx_addr_t partitiondone =
-        dualtree_t::partition(global_tree, parms->sources, parms->targets);
-    hpx_lco_wait(partitiondone);
-    hpx_lco_delete_sync(partitiondone);
+        prepare_tree(parms->sources, parms->targets, parms->refinement_limit,
+                     parms->target_limit, parms->adaptive, parms->kept,
+                     parms->reuse, parms->adopted || parms->reuse_dag,
+                     parms->margin, parms->unif_cost);
 #ifdef DASHMMEXTRATIMING
     hpx_time_t creation_end = hpx_time_now();
     double creation_deltat = hpx_time_diff_us(creation_begin, creation_end);
@@ -247,13 +846,26 @@ class Evaluator {
     // The third is the expansion creation done LCO
     parms->middone = hpx_lco_and_new(hpx_get_num_ranks());
     assert(parms->middone != HPX_NULL);
+    // The last collects the estimated cost if the limit is being tuned
+    if (parms->tune) {
+      parms->tuning = hpx_lco_reduce_new(hpx_get_num_ranks(),
+                                         sizeof(double) * 3,
+                                         double_sum_ident_op, double_sum_op);
+      assert(parms->tuning != HPX_NULL);
+    }
+    // And this collects the bytes of edges of each rank
+    parms->edge_bytes = hpx_lco_reduce_new(hpx_get_num_ranks(), sizeof(size_t),
+                                           size_sum_ident, size_sum_op);
+    assert(parms->edge_bytes != HPX_NULL);
 
     // Start the work everywhere
     hpx_bcast_lsync(evaluate_rank_local_, HPX_NULL, parms, total_size);
 
     // set up dependent call on the broadcast to do evaluate cleanup
     hpx_call_when(parms->alldone, HPX_HERE, evaluate_cleanup_, HPX_NULL,
-                  &parms->rwaddr, &parms->alldone, &parms->middone);
+                  &parms->rwaddr, &parms->alldone, &parms->middone,
+                  &parms->retain, &parms->tuning, &parms->unif_cost,
+                  &parms->edge_bytes);
 
     return HPX_SUCCESS;
   }
@@ -285,10 +897,33 @@ class Evaluator {
 #ifdef DASHMMEXTRATIMING
     hpx_time_t distribute_begin = hpx_time_now();
 #endif
-    DAG *dag = tree->create_DAG();
-    parms->distro.compute_distribution(*dag);
+    // A DAG kept from the previous evaluation is already distributed
+    DAG *dag = tree->kept_DAG();
+    if (dag != nullptr && !parms->reuse_dag) {
+      tree->release_DAG();
+      dag = nullptr;
+    }
+    assert(dag != nullptr || !parms->reuse_dag);
+    if (dag == nullptr) {
+      dag = tree->create_DAG(parms->implicit, parms->keep_dag);
+#ifdef DASHMM_COST_WEIGHTED_PARTITION
+      if (!parms->implicit) {
+        tree->record_unif_cost(*dag, parms->sources.data(),
+                               parms->targets.data(), parms->unif_cost);
+      }
+#endif
+      if (parms->tuning != HPX_NULL) {
+        double cost[3];
+        tree->estimate_cost(*dag, cost);
+        hpx_lco_set_lsync(parms->tuning, sizeof(cost), cost, HPX_NULL);
+      }
+      parms->distro.compute_distribution(*dag);
+    }
 #ifdef DASHMMEXTRATIMING
     hpx_time_t distribute_end = hpx_time_now();
+    fprintf(stdout, "DAG: %d - %zu nodes %zu [B] - %zu edges %zu [B]\n",
+            hpx_get_my_rank(), dag->node_count(), dag->node_bytes(),
+            dag->edge_count(), dag->edge_bytes());
     double distribute_deltat = hpx_time_diff_us(distribute_begin,
                                                 distribute_end);
 #endif
@@ -298,7 +933,11 @@ class Evaluator {
 #ifdef DASHMMEXTRATIMING
     hpx_time_t allocate_begin = hpx_time_now();
 #endif
-    tree->create_expansions_from_DAG(parms->rwaddr);
+    if (parms->reuse_dag) {
+      tree->reset_DAG_LCOs(*dag);
+    } else {
+      tree->create_expansions_from_DAG(dag, parms->rwaddr);
+    }
 
     // NOTE: the previous has to finish for the following. So the previous
     // is a synchronous operation. The next three, however, are not. They all
@@ -326,9 +965,43 @@ class Evaluator {
 #ifdef DASHMMEXTRATIMING
     hpx_time_t evaluate_begin = hpx_time_now();
 #endif
-    tree->setup_edge_lists(dag);
-    tree->start_DAG_evaluation(global_tree);
-    hpx_addr_t heredone = tree->setup_termination_detection(dag);
+    hpx_addr_t heredone{HPX_NULL};
+    size_t edge_bytes{0};
+    if (parms->reuse_dag) {
+      // The LCOs kept their edges, and the leaves kept theirs in the DAG
+      hpx_addr_t edges_set = tree->reuse_edge_lists(dag);
+      hpx_addr_t edges_copied = tree->start_DAG_evaluation(global_tree, dag);
+      heredone = tree->setup_termination_detection(dag);
+      hpx_lco_wait(edges_set);
+      hpx_lco_wait(edges_copied);
+      hpx_lco_delete_sync(edges_set);
+      hpx_lco_delete_sync(edges_copied);
+    } else if (parms->implicit) {
+      // The edges are found again and handed to the LCOs, and the evaluation
+      // starts as they are.
+      edge_bytes = tree->emit_DAG(dag, parms->rwaddr);
+      heredone = tree->setup_termination_detection(dag);
+#ifdef DASHMMEXTRATIMING
+      fprintf(stdout, "DAG emit: %d - peak %zu [B]\n", hpx_get_my_rank(),
+              edge_bytes);
+#endif
+    } else {
+      edge_bytes = dag->edge_bytes();
+      hpx_addr_t edges_set = tree->setup_edge_lists(dag);
+      hpx_addr_t edges_copied = tree->start_DAG_evaluation(global_tree, dag);
+      heredone = tree->setup_termination_detection(dag);
+
+      // Once the LCOs hold their edges, the edges of the DAG are released so
+      // that they are not held while the evaluation runs.
+      hpx_lco_wait(edges_set);
+      hpx_lco_wait(edges_copied);
+      hpx_lco_delete_sync(edges_set);
+      hpx_lco_delete_sync(edges_copied);
+    }
+    dag->release_edges();
+    hpx_lco_set_lsync(parms->edge_bytes, sizeof(edge_bytes), &edge_bytes,
+                      HPX_NULL);
+
     hpx_lco_wait(heredone);
 #ifdef DASHMMEXTRATIMING
     hpx_time_t evaluate_end = hpx_time_now();
@@ -344,12 +1017,18 @@ class Evaluator {
     fprintf(stdout, "Evalute: %d - C/D %lg - A %lg - E %lg\n",
             hpx_get_my_rank(),
             distribute_deltat, allocate_deltat, evaluate_deltat);
+    fprintf(stdout, "LCO lookup: %d - %zu lookups - %lg [us]\n",
+            hpx_get_my_rank(), tree->lookup_count(), tree->lookup_time());
 #endif
 
-    // Delete some local stuff
+    // Delete some local stuff, unless the DAG is kept with the tree
     hpx_lco_delete_sync(heredone);
-    tree->destroy_DAG_LCOs(*dag);
-    delete dag;
+    if (parms->keep_dag) {
+      tree->keep_DAG(dag);
+    } else {
+      tree->destroy_DAG_LCOs(*dag);
+      delete dag;
+    }
 
     // Mark that we have finished the rank-local work
     hpx_lco_and_set(parms->alldone, HPX_NULL);
@@ -361,25 +1040,128 @@ class Evaluator {
   ///
   /// This is called on a single locality, and will clean up the rest of the
   /// allocated resources for this evaluation. This action also exits the
-  /// current HPX-5 epoch.
+  /// current HPX-5 epoch, giving the address of the tree if it is retained,
+  /// the estimated cost of the evaluation if the limit is being tuned, and
+  /// the bytes of edges of the DAG.
   ///
   /// \param rwaddr - global address of the DualTree
   /// \param alldone - global address of completion detection LCO
   /// \param middone - global address of synchronization LCO
+  /// \param retain - should the tree be kept
+  /// \param tuning - global address of the reduction of the estimated cost;
+  ///                 may be HPX_NULL
+  /// \param unif_cost - the estimated cost of the uniform grid; may be
+  ///                    HPX_NULL
+  /// \param edge_bytes - global address of the reduction of the bytes of
+  ///                     edges
   ///
   /// \returns HPX_SUCCESS
   static int evaluate_cleanup_handler(hpx_addr_t rwaddr, hpx_addr_t alldone,
-                                      hpx_addr_t middone) {
+                                      hpx_addr_t middone, int retain,
+                                      hpx_addr_t tuning, hpx_addr_t unif_cost,
+                                      hpx_addr_t edge_bytes) {
     hpx_lco_delete_sync(alldone);
     hpx_lco_delete_sync(middone);
 
+    EvaluateResult result{HPX_NULL, {0.0, 0.0, 0.0}, HPX_NULL, 0};
+    hpx_lco_get(edge_bytes, sizeof(result.edge_bytes), &result.edge_bytes);
+    hpx_lco_delete_sync(edge_bytes);
+    if (tuning != HPX_NULL) {
+      hpx_lco_get(tuning, sizeof(result.cost), result.cost);
+      hpx_lco_delete_sync(tuning);
+#ifdef DASHMMEXTRATIMING
+      fprintf(stdout, "Tuning: S->T %lg - expansions %lg - other %lg [us]\n",
+              result.cost[0], result.cost[1], result.cost[2]);
+#endif
+    }
+
     // clean up tree and table
-    RankWise<dualtree_t> global_tree{rwaddr};
-    dualtree_t::destroy(global_tree);
+    hpx_addr_t kept{rwaddr};
+    if (!retain) {
+      RankWise<dualtree_t> global_tree{rwaddr};
+      dualtree_t::destroy(global_tree);
+      kept = HPX_NULL;
+    }
+    result.kept = kept;
+    result.unif_cost = unif_cost;
 
     // Exit from this HPX epoch
+    hpx_exit(sizeof(result), &result);
+  }
+
+  /// Action that destroys a retained tree and the estimated cost
+  ///
+  /// \param rwaddr - global address of the DualTree; may be HPX_NULL
+  /// \param unif_cost - the estimated cost of the uniform grid; may be
+  ///                    HPX_NULL
+  ///
+  /// \returns HPX_SUCCESS
+  static int release_tree_handler(hpx_addr_t rwaddr, hpx_addr_t unif_cost) {
+    if (rwaddr != HPX_NULL) {
+      RankWise<dualtree_t> global_tree{rwaddr};
+      dualtree_t::destroy(global_tree);
+    }
+    if (unif_cost != HPX_NULL) {
+      dualtree_t::destroy_unif_cost(unif_cost);
+    }
     hpx_exit(0, nullptr);
   }
+
+  /// Action that builds a tree and gathers its statistics
+  ///
+  /// This action exits the current HPX-5 epoch, giving back the parameters
+  /// with the results filled in: the address of the tree if it is retained,
+  /// and the statistics.
+  ///
+  /// \param parms - the input arguments
+  /// \param total_size - the size of the arguments
+  ///
+  /// \returns HPX_SUCCESS
+  static int statistics_handler(StatisticsParams *parms, size_t total_size) {
+    RankWise<dualtree_t> global_tree =
+        prepare_tree(parms->sources, parms->targets, parms->refinement_limit,
+                     parms->target_limit, parms->adaptive, parms->kept,
+                     parms->reuse, parms->adopted, parms->margin);
+    parms->unif_level = dualtree_t::statistics(global_tree, parms->data);
+
+    parms->kept = global_tree.data();
+    if (!parms->retain) {
+      dualtree_t::destroy(global_tree);
+      parms->kept = HPX_NULL;
+    }
+
+    hpx_exit(total_size, parms);
+  }
+
+  /// Action that takes the state out of a retained tree
+  ///
+  /// The retained tree is destroyed. This action exits the current HPX-5
+  /// epoch, giving the address of the state of the tree.
+  ///
+  /// \param rwaddr - global address of the DualTree
+  ///
+  /// \returns HPX_SUCCESS
+  static int export_tree_handler(hpx_addr_t rwaddr) {
+    RankWise<dualtree_t> global_tree{rwaddr};
+    RankWise<dualtreedata_t> data = dualtree_t::export_tree(global_tree);
+    hpx_addr_t retval = data.data();
+    hpx_exit(sizeof(retval), &retval);
+  }
+
+  /// Action that makes a tree from the state taken from another
+  ///
+  /// This action exits the current HPX-5 epoch, giving the address of the
+  /// new tree.
+  ///
+  /// \param dataaddr - global address of the state of the tree
+  ///
+  /// \returns HPX_SUCCESS
+  static int import_tree_handler(hpx_addr_t dataaddr) {
+    RankWise<dualtreedata_t> data{dataaddr};
+    RankWise<dualtree_t> global_tree = dualtree_t::import_tree(data);
+    hpx_addr_t retval = global_tree.data();
+    hpx_exit(sizeof(retval), &retval);
+  }
 };
 
 
@@ -401,6 +1183,30 @@ template <typename S, typename T,
                     template <typename, typename> class> class M>
 hpx_action_t Evaluator<S, T, E, M>::evaluate_cleanup_ = HPX_ACTION_NULL;
 
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t Evaluator<S, T, E, M>::release_tree_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t Evaluator<S, T, E, M>::export_tree_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t Evaluator<S, T, E, M>::import_tree_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t Evaluator<S, T, E, M>::statistics_ = HPX_ACTION_NULL;
+
 
 } // namespace dashmm
 
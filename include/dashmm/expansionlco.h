@@ -123,6 +123,7 @@ class ExpansionLCO {
     Header *ldata = static_cast<Header *>(hpx_lco_user_get_user_data(lva));
 
     ldata->yet_to_arrive = n_in + 1; // to account for setting out edges
+    ldata->in_edge_count = n_in;
     ldata->index = index;
     ldata->rwaddr = rwtree;
     ldata->out_edge_count = n_out;
@@ -285,19 +286,95 @@ class ExpansionLCO {
     hpx_lco_set_lsync(data_, sizeof(int), &code, HPX_NULL);
   }
 
+  /// Write one out edge of this expansion LCO in place
+  ///
+  /// This is used when the DAG is implicit, so that the out edges are never
+  /// held anywhere but in the LCO. Each edge has its own slot, so this is
+  /// safe to call concurrently. Once every slot is written,
+  /// finish_out_edge_data() must be called.
+  ///
+  /// \param slot - the slot of the edge among the out edges of the LCO
+  /// \param edge - the out edge
+  void set_out_edge(int slot, const DAGEdge &edge) {
+    void *lva{nullptr};
+    assert(hpx_gas_try_pin(data_, &lva));
+    Header *ldata = static_cast<Header *>(hpx_lco_user_get_user_data(lva));
+    assert(slot < ldata->out_edge_count);
+
+    OutEdgeRecord *records =
+      reinterpret_cast<OutEdgeRecord *>(ldata->data + ldata->expansion_size);
+    records[slot].op = edge.op;
+    records[slot].target = edge.target->global_addx;
+    records[slot].tidx = edge.target->idx;
+    records[slot].locality = edge.target->locality;
+
+    hpx_gas_unpin(data_);
+  }
+
+  /// Mark the out edges written with set_out_edge() as complete
+  ///
+  /// This orders the out edges by locality, as set_out_edge_data() does, and
+  /// then sets the underlying LCO with them.
+  void finish_out_edge_data() {
+    void *lva{nullptr};
+    assert(hpx_gas_try_pin(data_, &lva));
+    Header *ldata = static_cast<Header *>(hpx_lco_user_get_user_data(lva));
+
+    OutEdgeRecord *records =
+      reinterpret_cast<OutEdgeRecord *>(ldata->data + ldata->expansion_size);
+    std::sort(records, records + ldata->out_edge_count,
+              [](const OutEdgeRecord &a, const OutEdgeRecord &b) {
+                return a.locality < b.locality;
+              });
+
+    hpx_gas_unpin(data_);
+    int code = SetOpCodes::kOutEdges;
+    hpx_lco_set_lsync(data_, sizeof(int), &code, HPX_NULL);
+  }
+
   /// Reset the underlying LCO
   ///
-  /// This will not only reset the underlying LCO, but will also perform an
-  /// 'empty' set of the out edge data. The intent of this method is for use
-  /// in cases where a DAG is reused multiple times. At the moment, this
-  /// functionality is not available in DASHMM, but will be soon.
+  /// This is for use when a DAG is evaluated more than once. The expansion
+  /// is zeroed and the LCO again expects all of its inputs, but the out edge
+  /// data is kept. As for a newly created LCO, the LCO will not trigger until
+  /// reuse_out_edge_data() is called, so that the LCOs of every rank can be
+  /// reset before any of them is sent a contribution. This must only be
+  /// called once the LCO has triggered.
   void reset() {
     if (data_ == HPX_NULL) return;
 
     hpx_lco_reset_sync(data_);
 
-    std::vector<DAGEdge> empty{};
-    set_out_edge_data(empty);
+    void *lva{nullptr};
+    assert(hpx_gas_try_pin(data_, &lva));
+    Header *ldata = static_cast<Header *>(hpx_lco_user_get_user_data(lva));
+
+    ldata->yet_to_arrive = ldata->in_edge_count + 1;
+
+    ReadBuffer here{ldata->data, ldata->expansion_size};
+    ViewSet views{};
+    views.interpret(here);
+    for (int i = 0; i < views.count(); ++i) {
+      memset(views.view_data(i), 0, views.view_bytes(i));
+    }
+    int n_out = ldata->out_edge_count;
+
+    hpx_gas_unpin(data_);
+
+    // the out edges are served once per trigger of the LCO
+    if (n_out != 0) {
+      int unused = 0;
+      hpx_call_when(data_, data_, spawn_out_edges_, HPX_NULL, &unused);
+    }
+  }
+
+  /// Mark the out edge data of a reset LCO as set
+  ///
+  /// This takes the place of set_out_edge_data() once the LCO has been
+  /// reset, as the out edge data from the previous evaluation is kept.
+  void reuse_out_edge_data() {
+    int code = SetOpCodes::kOutEdges;
+    hpx_lco_set_lsync(data_, sizeof(int), &code, HPX_NULL);
   }
 
  private:
@@ -324,6 +401,7 @@ class ExpansionLCO {
   /// details on the exact format can be found with the ViewSet documentation.
   struct Header {
     int yet_to_arrive;
+    int in_edge_count;
     int out_edge_count;
     size_t expansion_size;
     Index index;
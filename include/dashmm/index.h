@@ -20,6 +20,10 @@
 /// \brief An index type for specifying relative node geometry
 
 
+#include <cstddef>
+#include <cstdint>
+
+
 namespace dashmm {
 
 
@@ -111,6 +115,24 @@ class Index {
 };
 
 
+/// Hash of an Index, for use in unordered containers
+///
+/// All four components enter the hash, so that Indices at any level, however
+/// deep, are told apart.
+struct IndexHash {
+  size_t operator()(const Index &idx) const {
+    uint64_t h = (uint32_t)idx.level();
+    h = (h * 0x9e3779b97f4a7c15) ^ (uint32_t)idx.x();
+    h = (h * 0x9e3779b97f4a7c15) ^ (uint32_t)idx.y();
+    h = (h * 0x9e3779b97f4a7c15) ^ (uint32_t)idx.z();
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9;
+    h ^= h >> 29;
+    return (size_t)h;
+  }
+};
+
+
 } // namespace dashmm
 
 
@@ -38,6 +38,12 @@ extern hpx_action_t size_sum_ident;
 /// Operation for size_t summation
 extern hpx_action_t size_sum_op;
 
+/// Identity operation for double summation
+extern hpx_action_t double_sum_ident_op;
+
+/// Operation for double summation
+extern hpx_action_t double_sum_op;
+
 /// Identity operation for integer maximum
 extern hpx_action_t int_max_ident_op;
 
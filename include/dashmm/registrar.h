@@ -97,7 +97,32 @@ class NodeRegistrar {
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         node_t::partition_node_,
                         node_t::partition_node_handler,
-                        HPX_POINTER, HPX_POINTER, HPX_INT, HPX_INT);
+                        HPX_POINTER, HPX_POINTER, HPX_INT, HPX_INT,
+                        HPX_POINTER);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        node_t::classify_octants_,
+                        node_t::classify_octants_handler,
+                        HPX_POINTER, HPX_SIZE_T, HPX_POINTER, HPX_POINTER,
+                        HPX_POINTER);
+  }
+};
+
+
+/// Object that handles action registration for TreeWalk
+template <typename Walker>
+class TreeWalkRegistrar {
+ public:
+  using treewalk_t = TreeWalk<Walker>;
+
+  TreeWalkRegistrar() {
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        treewalk_t::visit_,
+                        treewalk_t::visit_handler,
+                        HPX_POINTER, HPX_POINTER, HPX_INT, HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        treewalk_t::leave_,
+                        treewalk_t::leave_handler,
+                        HPX_POINTER, HPX_POINTER, HPX_ADDR, HPX_ADDR);
   }
 };
 
@@ -129,24 +154,44 @@ class TreeRegistrar {
                         tree_t::send_node_,
                         tree_t::send_node_handler,
                         HPX_POINTER, HPX_POINTER, HPX_INT, HPX_ADDR, HPX_INT);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        tree_t::bounding_box_,
+                        tree_t::bounding_box_handler,
+                        HPX_POINTER, HPX_SIZE_T, HPX_POINTER);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         tree_t::assign_points_,
                         tree_t::assign_points_to_unif_grid,
                         HPX_POINTER, HPX_INT, HPX_POINTER, HPX_INT,
                         HPX_POINTER, HPX_POINTER);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
-                        tree_t::group_points_,
-                        tree_t::group_points_on_unif_grid,
-                        HPX_POINTER, HPX_INT, HPX_INT, HPX_POINTER,
-                        HPX_POINTER, HPX_POINTER);
+                        tree_t::scatter_points_,
+                        tree_t::scatter_points_handler,
+                        HPX_POINTER, HPX_INT, HPX_POINTER, HPX_POINTER,
+                        HPX_POINTER);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         tree_t::merge_points_,
                         tree_t::merge_points_handler,
-                        HPX_POINTER, HPX_POINTER, HPX_INT, HPX_ADDR);
+                        HPX_POINTER, HPX_POINTER, HPX_INT, HPX_ADDR,
+                        HPX_POINTER);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        tree_t::pull_points_,
+                        tree_t::pull_points_handler,
+                        HPX_ADDR, HPX_POINTER, HPX_INT, HPX_ADDR,
+                        HPX_POINTER);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         tree_t::merge_points_same_s_and_t_,
                         tree_t::merge_points_same_s_and_t_handler,
-                        HPX_POINTER, HPX_INT, HPX_POINTER, HPX_ADDR);
+                        HPX_POINTER, HPX_INT, HPX_POINTER, HPX_ADDR,
+                        HPX_POINTER);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        tree_t::collect_movers_,
+                        tree_t::collect_movers_handler,
+                        HPX_POINTER, HPX_INT, HPX_POINTER);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        tree_t::rebuild_branch_,
+                        tree_t::rebuild_branch_handler,
+                        HPX_POINTER, HPX_INT, HPX_POINTER, HPX_INT,
+                        HPX_POINTER, HPX_SIZE_T);
   }
 };
 
@@ -174,10 +219,16 @@ class DualTreeRegistrar {
                         dualtree_t::domain_geometry_op_,
                         dualtree_t::domain_geometry_op_handler,
                         HPX_POINTER, HPX_POINTER, HPX_SIZE_T);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::sample_unif_grid_,
+                        dualtree_t::sample_unif_grid_handler,
+                        HPX_ADDR, HPX_ADDR, HPX_ADDR, HPX_ADDR, HPX_INT,
+                        HPX_INT);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         dualtree_t::init_partition_,
                         dualtree_t::init_partition_handler,
-                        HPX_ADDR, HPX_ADDR, HPX_INT, HPX_ADDR, HPX_INT);
+                        HPX_ADDR, HPX_ADDR, HPX_INT, HPX_INT, HPX_INT,
+                        HPX_ADDR, HPX_INT, HPX_INT);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_MARSHALLED,
                         dualtree_t::recv_points_,
                         dualtree_t::recv_points_handler,
@@ -186,58 +237,102 @@ class DualTreeRegistrar {
                         dualtree_t::send_points_,
                         dualtree_t::send_points_handler,
                         HPX_INT, HPX_POINTER, HPX_POINTER, HPX_POINTER,
-                        HPX_POINTER, HPX_POINTER, HPX_POINTER, HPX_ADDR);
+                        HPX_POINTER, HPX_POINTER, HPX_POINTER, HPX_ADDR,
+                        HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::offer_points_,
+                        dualtree_t::offer_points_handler,
+                        HPX_INT, HPX_POINTER, HPX_POINTER, HPX_POINTER,
+                        HPX_POINTER, HPX_ADDR, HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_MARSHALLED,
+                        dualtree_t::recv_offer_,
+                        dualtree_t::recv_offer_handler,
+                        HPX_POINTER, HPX_SIZE_T);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         dualtree_t::create_dual_tree_,
                         dualtree_t::create_dual_tree_handler,
-                        HPX_ADDR, HPX_ADDR, HPX_ADDR);
+                        HPX_ADDR, HPX_ADDR, HPX_ADDR, HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::update_dual_tree_,
+                        dualtree_t::update_dual_tree_handler,
+                        HPX_ADDR, HPX_ADDR, HPX_ADDR, HPX_ADDR, HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_MARSHALLED,
+                        dualtree_t::recv_movers_,
+                        dualtree_t::recv_movers_handler,
+                        HPX_POINTER, HPX_SIZE_T);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         dualtree_t::finalize_partition_,
                         dualtree_t::finalize_partition_handler,
                         HPX_ADDR);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
-                        dualtree_t::source_apply_method_,
-                        dualtree_t::source_apply_method_handler,
-                        HPX_POINTER, HPX_POINTER, HPX_ADDR);
+                        dualtree_t::delete_unif_cost_,
+                        dualtree_t::delete_unif_cost_handler,
+                        HPX_ADDR);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
-                        dualtree_t::source_apply_method_child_done_,
-                        dualtree_t::source_apply_method_child_done_handler,
-                        HPX_POINTER, HPX_POINTER, HPX_ADDR, HPX_ADDR);
+                        dualtree_t::export_tree_,
+                        dualtree_t::export_tree_handler,
+                        HPX_ADDR, HPX_ADDR);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
-                        dualtree_t::target_apply_method_,
-                        dualtree_t::target_apply_method_handler,
-                        HPX_POINTER, HPX_POINTER, HPX_POINTER, HPX_INT,
-                        HPX_ADDR);
+                        dualtree_t::import_tree_,
+                        dualtree_t::import_tree_handler,
+                        HPX_ADDR, HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::collect_statistics_,
+                        dualtree_t::collect_statistics_handler,
+                        HPX_ADDR, HPX_ADDR);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         dualtree_t::destroy_DAG_LCOs_,
                         dualtree_t::destroy_DAG_LCOs_handler,
                         HPX_POINTER, HPX_SIZE_T, HPX_INT);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::reset_DAG_LCOs_,
+                        dualtree_t::reset_DAG_LCOs_handler,
+                        HPX_POINTER, HPX_SIZE_T, HPX_INT);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         dualtree_t::termination_detection_,
                         dualtree_t::termination_detection_handler,
                         HPX_ADDR, HPX_POINTER, HPX_SIZE_T, HPX_POINTER,
                         HPX_SIZE_T, HPX_POINTER, HPX_SIZE_T);
-    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
-                        dualtree_t::create_S_expansions_from_DAG_,
-                        dualtree_t::create_S_expansions_from_DAG_handler,
-                        HPX_ADDR, HPX_POINTER, HPX_POINTER, HPX_ADDR);
-    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
-                        dualtree_t::create_T_expansions_from_DAG_,
-                        dualtree_t::create_T_expansions_from_DAG_handler,
-                        HPX_ADDR, HPX_POINTER, HPX_POINTER, HPX_ADDR);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
                         dualtree_t::edge_lists_,
                         dualtree_t::edge_lists_handler,
-                        HPX_POINTER, HPX_SIZE_T, HPX_POINTER, HPX_SIZE_T);
+                        HPX_POINTER, HPX_POINTER, HPX_SIZE_T, HPX_POINTER,
+                        HPX_SIZE_T);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
-                        dualtree_t::instigate_dag_eval_,
-                        dualtree_t::instigate_dag_eval_handler,
-                        HPX_ADDR, HPX_POINTER);
+                        dualtree_t::reuse_edge_lists_,
+                        dualtree_t::reuse_edge_lists_handler,
+                        HPX_POINTER, HPX_SIZE_T, HPX_POINTER, HPX_SIZE_T);
     HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_MARSHALLED,
                         dualtree_t::instigate_dag_eval_remote_,
                         dualtree_t::instigate_dag_eval_remote_handler,
                         HPX_POINTER, HPX_SIZE_T);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::source_method_nodes_,
+                        dualtree_t::source_method_nodes_handler,
+                        HPX_POINTER, HPX_INT, HPX_INT, HPX_POINTER);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::create_expansions_nodes_,
+                        dualtree_t::create_expansions_nodes_handler,
+                        HPX_POINTER, HPX_POINTER, HPX_INT, HPX_INT, HPX_INT,
+                        HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::instigate_dag_eval_,
+                        dualtree_t::instigate_dag_eval_handler,
+                        HPX_POINTER, HPX_ADDR, HPX_POINTER, HPX_POINTER,
+                        HPX_ADDR);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::instigate_implicit_,
+                        dualtree_t::instigate_implicit_handler,
+                        HPX_POINTER, HPX_ADDR, HPX_POINTER, HPX_POINTER);
+    HPX_REGISTER_ACTION(HPX_DEFAULT, HPX_ATTR_NONE,
+                        dualtree_t::instigate_edge_,
+                        dualtree_t::instigate_edge_handler,
+                        HPX_POINTER, HPX_POINTER, HPX_POINTER, HPX_INT);
   }
+
+ private:
+  // Registration for the tree walk used by DualTree
+  TreeWalkRegistrar<typename dualtree_t::TargetMethodWalk> tmwalkreg_;
 };
 
 
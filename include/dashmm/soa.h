@@ -0,0 +1,240 @@
+// =============================================================================
+//  Dynamic Adaptive System for Hierarchical Multipole Methods (DASHMM)
+//
+//  Copyright (c) 2015-2017, Trustees of Indiana University,
+//  All rights reserved.
+//
+//  This software may be modified and distributed under the terms of the BSD
+//  license. See the LICENSE file for details.
+//
+//  This software was created at the Indiana University Center for Research in
+//  Extreme Scale Technologies (CREST).
+// =============================================================================
+
+
+#ifndef __DASHMM_SOA_H__
+#define __DASHMM_SOA_H__
+
+
+/// \file
+/// \brief Structure of arrays layout for sources and targets
+
+
+#include <cmath>
+#include <cstddef>
+
+#include <type_traits>
+
+#include "dashmm/point.h"
+#include "dashmm/types.h"
+
+
+namespace dashmm {
+
+
+/// Access to the members of a record by their usual names
+///
+/// This provides the accessors required by SoATraits for records that have
+/// the members 'position', 'charge' and 'phi' expected by the built-in
+/// expansions. Only the accessors that are used need to be valid for a given
+/// record type.
+template <typename Record>
+struct SoADefaultFields {
+  static const Point &position(const Record &r) {return r.position;}
+  static double charge(const Record &r) {return r.charge;}
+  static dcomplex_t &phi(Record &r) {return r.phi;}
+};
+
+
+/// Layout traits for Source and Target types
+///
+/// By default, DASHMM computes directly on the arrays of user records. The
+/// direct interactions can instead be computed on separate contiguous arrays
+/// of coordinates, charges and potentials, which the compiler can vectorize.
+/// To opt in, specialize this template for both the Source and the Target
+/// type with enabled set to true, and with static accessors for the
+/// position and charge of a source, and for the position and phi of a target.
+/// For records with the usual member names, this is simply
+///
+///   template <>
+///   struct SoATraits<SourceData> : SoADefaultFields<SourceData> {
+///     static constexpr bool enabled = true;
+///   };
+///
+/// The layout is used only with Expansions that provide kernels for it; see
+/// HasSoAKernels.
+template <typename Record>
+struct SoATraits : SoADefaultFields<Record> {
+  static constexpr bool enabled = false;
+};
+
+
+/// Indicates if an Expansion provides kernels for the SoA layout
+///
+/// Expansions that do should specialize this to derive from std::true_type,
+/// and provide
+///
+///   void S_to_T(const SourceSoA &sources, TargetSoA &targets) const;
+template <typename Expansion>
+struct HasSoAKernels : std::false_type { };
+
+
+/// Sources stored as separate arrays of coordinates and charges
+///
+/// The arrays are stored one after the other in a single buffer, so that a
+/// segment of sources can be sent in a message as is. The buffer is not owned
+/// by this object.
+class SourceSoA {
+ public:
+  /// Construct from a packed buffer
+  ///
+  /// \param buffer - the buffer, packed by pack()
+  /// \param n - the number of sources in the buffer
+  SourceSoA(void *buffer, size_t n)
+      : n_{n}, x_{static_cast<double *>(buffer)}, y_{x_ + n}, z_{y_ + n},
+        q_{z_ + n} { }
+
+  /// The size of a buffer holding a given number of sources
+  static size_t bytes(size_t n) {return 4 * n * sizeof(double);}
+
+  /// Pack a range of source records into a buffer
+  ///
+  /// \param first - the first source
+  /// \param n - the number of sources
+  /// \param buffer - the buffer; must have at least bytes(n) bytes
+  template <typename Source>
+  static void pack(const Source *first, size_t n, void *buffer) {
+    using traits_t = SoATraits<Source>;
+    SourceSoA dest{buffer, n};
+    for (size_t i = 0; i < n; ++i) {
+      const Point &pos = traits_t::position(first[i]);
+      dest.x_[i] = pos.x();
+      dest.y_[i] = pos.y();
+      dest.z_[i] = pos.z();
+      dest.q_[i] = traits_t::charge(first[i]);
+    }
+  }
+
+  size_t n() const {return n_;}
+  const double *x() const {return x_;}
+  const double *y() const {return y_;}
+  const double *z() const {return z_;}
+  const double *q() const {return q_;}
+
+ private:
+  size_t n_;
+  double *x_;
+  double *y_;
+  double *z_;
+  double *q_;
+};
+
+
+/// Targets stored as separate arrays of coordinates and potentials
+///
+/// The potential is accumulated into separate real and imaginary arrays,
+/// which start at zero, and which are added to the target records by
+/// unpack(). The arrays are stored in a single buffer that is owned by this
+/// object.
+class TargetSoA {
+ public:
+  /// Gather the positions of a range of target records
+  ///
+  /// \param first - the first target
+  /// \param n - the number of targets
+  template <typename Target>
+  TargetSoA(const Target *first, size_t n)
+      : n_{n}, x_{new double[5 * n]}, y_{x_ + n}, z_{y_ + n}, re_{z_ + n},
+        im_{re_ + n} {
+    using traits_t = SoATraits<Target>;
+    for (size_t i = 0; i < n; ++i) {
+      const Point &pos = traits_t::position(first[i]);
+      x_[i] = pos.x();
+      y_[i] = pos.y();
+      z_[i] = pos.z();
+      re_[i] = 0.0;
+      im_[i] = 0.0;
+    }
+  }
+
+  ~TargetSoA() {delete [] x_;}
+
+  TargetSoA(const TargetSoA &other) = delete;
+  TargetSoA &operator=(const TargetSoA &other) = delete;
+
+  /// Add the accumulated potential to a range of target records
+  ///
+  /// \param first - the first target; this must be the range from which
+  ///                this object was constructed
+  template <typename Target>
+  void unpack(Target *first) const {
+    using traits_t = SoATraits<Target>;
+    for (size_t i = 0; i < n_; ++i) {
+      traits_t::phi(first[i]) += dcomplex_t{re_[i], im_[i]};
+    }
+  }
+
+  size_t n() const {return n_;}
+  const double *x() const {return x_;}
+  const double *y() const {return y_;}
+  const double *z() const {return z_;}
+  double *re() {return re_;}
+  double *im() {return im_;}
+
+ private:
+  size_t n_;
+  double *x_;
+  double *y_;
+  double *z_;
+  double *re_;
+  double *im_;
+};
+
+
+
+/// Add the potential q / r of each source to the real part of each target
+///
+/// This is the direct interaction of the Laplace kernel, shared by the
+/// built-in expansions that provide it for the SoA layout. Coincident points
+/// contribute nothing.
+///
+/// NOTE: The loop over the targets is innermost so that it vectorizes. The
+/// result agrees with the kernels on the records only to rounding. Those sum
+/// the sources of each call into a local before adding it to the potential
+/// of the target, while here the sum for each target is kept in re() across
+/// every call made for its leaf, and only then added to the potential.
+///
+/// \param sources - the sources
+/// \param targets - the targets
+inline void soa_inverse_distance(const SourceSoA &sources,
+                                 TargetSoA &targets) {
+  const double *sx = sources.x();
+  const double *sy = sources.y();
+  const double *sz = sources.z();
+  const double *sq = sources.q();
+  const double *tx = targets.x();
+  const double *ty = targets.y();
+  const double *tz = targets.z();
+  double *phi = targets.re();
+  size_t n_targets = targets.n();
+
+  // Coincident points give q / infinity, which is zero
+  for (size_t j = 0; j < sources.n(); ++j) {
+    double x = sx[j];
+    double y = sy[j];
+    double z = sz[j];
+    double q = sq[j];
+    for (size_t i = 0; i < n_targets; ++i) {
+      double dx = tx[i] - x;
+      double dy = ty[i] - y;
+      double dz = tz[i] - z;
+      double dist = sqrt(dx * dx + dy * dy + dz * dz);
+      phi[i] += q / (dist > 0 ? dist : HUGE_VAL);
+    }
+  }
+}
+
+} // namespace dashmm
+
+
+#endif // __DASHMM_SOA_H__
@@ -22,9 +22,12 @@
 
 #include <cstring>
 
+#include <type_traits>
+
 #include <hpx/hpx.h>
 
 #include "dashmm/arrayref.h"
+#include "dashmm/soa.h"
 #include "dashmm/traceevents.h"
 #include "dashmm/viewset.h"
 
@@ -55,6 +58,11 @@ class TargetLCORegistrar;
 /// interact with the object very often. Mostly they will pass objects of this
 /// type to ExpansionLCO objects.
 ///
+/// If the Source and Target types opt into the SoA layout, and the Expansion
+/// supports it, the sources of each S->T contribution are sent as separate
+/// arrays, and the LCO accumulates the direct interactions in separate arrays
+/// that are added to the targets once all contributions have arrived.
+///
 /// This is a template class parameterized by the Source, Target, Expansion,
 /// and Method types for a particular evaluation of DASHMM.
 template <typename Source, typename Target,
@@ -70,6 +78,12 @@ class TargetLCO {
 
   using targetref_t = ArrayRef<Target>;
 
+  /// Is the SoA layout used for the direct interactions
+  using soa_t = std::integral_constant<bool,
+                                       SoATraits<Source>::enabled
+                                       && SoATraits<Target>::enabled
+                                       && HasSoAKernels<expansion_t>::value>;
+
   /// Construct a default object
   TargetLCO() : lco_{HPX_NULL}, n_targs_{0} { }
 
@@ -85,7 +99,8 @@ class TargetLCO {
   /// \param targets - ArrayRef indicating the global memory that the LCO is
   ///                  representing
   TargetLCO(size_t n_inputs, const targetref_t &targets) {
-    Data init{static_cast<int>(n_inputs), targets};
+    Data init{static_cast<int>(n_inputs), static_cast<int>(n_inputs),
+              targets, nullptr};
     lco_ = hpx_lco_user_new(sizeof(init), init_, operation_,
                             predicate_, &init, sizeof(init));
     assert(lco_ != HPX_NULL);
@@ -101,6 +116,24 @@ class TargetLCO {
     }
   }
 
+  /// Reset the LCO for another evaluation
+  ///
+  /// The LCO is made to expect the same number of contributions as when it
+  /// was created, so that the DAG it serves can be evaluated again. This must
+  /// only be called once the LCO has triggered.
+  void reset() {
+    if (lco_ == HPX_NULL) return;
+
+    hpx_lco_reset_sync(lco_);
+
+    void *lva{nullptr};
+    assert(hpx_gas_try_pin(lco_, &lva));
+    Data *ldata = static_cast<Data *>(hpx_lco_user_get_user_data(lva));
+    ldata->yet_to_arrive = ldata->n_inputs;
+    assert(ldata->soa == nullptr);
+    hpx_gas_unpin(lco_);
+  }
+
   /// The global address of the referred to object
   hpx_addr_t lco() const {return lco_;}
 
@@ -112,13 +145,13 @@ class TargetLCO {
   /// \param n - the number of sources
   /// \param sources - the sources themselves
   void contribute_S_to_T(size_t n, source_t *sources) const {
-    size_t inputsize = sizeof(StoT) + sizeof(source_t) * n;
+    size_t inputsize = sizeof(StoT) + source_bytes(n, soa_t{});
     StoT *input = reinterpret_cast<StoT *>(new char [inputsize]);
     assert(input);
     input->code = kStoT;
     input->count = n;
     if (n != 0) {
-      memcpy(input->sources, sources, sizeof(source_t) * n);
+      pack_sources(sources, n, input->sources, soa_t{});
     }
 
     hpx_lco_set_lsync(lco_, inputsize, input, HPX_NULL);
@@ -126,6 +159,21 @@ class TargetLCO {
     delete [] input;
   }
 
+  /// Apply the direct interactions of some sources to some targets
+  ///
+  /// This does the work of an S->T contribution, including the packing of
+  /// the records into the SoA layout, without going through an LCO. It is
+  /// used to measure the cost of the direct interactions.
+  ///
+  /// \param sources - the sources
+  /// \param n_src - the number of sources
+  /// \param targets - the targets
+  /// \param n_targs - the number of targets
+  static void direct(source_t *sources, size_t n_src, target_t *targets,
+                     size_t n_targs) {
+    direct(sources, n_src, targets, n_targs, soa_t{});
+  }
+
   /// Contribute a M->T operation to the referred targets
   ///
   /// \param bytes - the size of the serialized expansion data
@@ -163,10 +211,14 @@ class TargetLCO {
   /// LCO data type
   struct Data {
     int yet_to_arrive;
+    int n_inputs;
     targetref_t targets;
+    TargetSoA *soa;
   };
 
   /// S->T parameters type
+  ///
+  /// With the SoA layout, the sources are instead packed by SourceSoA.
   struct StoT {
     int code;
     size_t count;
@@ -220,12 +272,7 @@ class TargetLCO {
       StoT *input = static_cast<StoT *>(rhs);
 
       if (input->count) {
-        target_t *targets{lhs->targets.data()};
-
-        expansion_t expand(ViewSet{});
-        expand.S_to_T(input->sources, &input->sources[input->count],
-                       targets, &targets[lhs->targets.n()]);
-
+        apply_S_to_T(lhs, input, soa_t{});
       }
       EVENT_TRACE_DASHMM_STOT_END();
     } else if (*code == kMtoT) {
@@ -255,6 +302,77 @@ class TargetLCO {
     } else {
       assert(0 && "Incorrect code to TargetLCO");
     }
+
+    if (lhs->soa != nullptr && lhs->yet_to_arrive == 0) {
+      finish_soa(lhs, soa_t{});
+    }
+  }
+
+  /// The size of the sources in an S->T contribution
+  static size_t source_bytes(size_t n, std::false_type) {
+    return sizeof(source_t) * n;
+  }
+
+  static size_t source_bytes(size_t n, std::true_type) {
+    return SourceSoA::bytes(n);
+  }
+
+  /// Copy the sources into an S->T contribution
+  static void pack_sources(const source_t *sources, size_t n, void *dest,
+                           std::false_type) {
+    memcpy(dest, sources, sizeof(source_t) * n);
+  }
+
+  static void pack_sources(const source_t *sources, size_t n, void *dest,
+                           std::true_type) {
+    SourceSoA::pack(sources, n, dest);
+  }
+
+  /// Apply an S->T contribution to the targets
+  static void apply_S_to_T(Data *lhs, StoT *input, std::false_type) {
+    target_t *targets{lhs->targets.data()};
+    expansion_t expand(ViewSet{});
+    expand.S_to_T(input->sources, &input->sources[input->count],
+                   targets, &targets[lhs->targets.n()]);
+  }
+
+  static void apply_S_to_T(Data *lhs, StoT *input, std::true_type) {
+    // The target arrays are gathered by the first contribution, and are kept
+    // until the last contribution to the LCO.
+    if (lhs->soa == nullptr) {
+      lhs->soa = new TargetSoA{lhs->targets.data(), lhs->targets.n()};
+    }
+    SourceSoA sources{input->sources, input->count};
+    expansion_t expand(ViewSet{});
+    expand.S_to_T(sources, *lhs->soa);
+  }
+
+  /// Apply direct interactions outside of the LCO
+  static void direct(source_t *sources, size_t n_src, target_t *targets,
+                     size_t n_targs, std::false_type) {
+    expansion_t expand(ViewSet{});
+    expand.S_to_T(sources, &sources[n_src], targets, &targets[n_targs]);
+  }
+
+  static void direct(source_t *sources, size_t n_src, target_t *targets,
+                     size_t n_targs, std::true_type) {
+    char *buffer = new char[SourceSoA::bytes(n_src)];
+    SourceSoA::pack(sources, n_src, buffer);
+    SourceSoA soa_sources{buffer, n_src};
+    TargetSoA soa_targets{targets, n_targs};
+    expansion_t expand(ViewSet{});
+    expand.S_to_T(soa_sources, soa_targets);
+    soa_targets.unpack(targets);
+    delete [] buffer;
+  }
+
+  /// Add the accumulated direct interactions to the targets
+  static void finish_soa(Data *lhs, std::false_type) { }
+
+  static void finish_soa(Data *lhs, std::true_type) {
+    lhs->soa->unpack(lhs->targets.data());
+    delete lhs->soa;
+    lhs->soa = nullptr;
   }
 
   /// The LCO is set if all scheduled operations have taken place.
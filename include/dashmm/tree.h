@@ -24,18 +24,27 @@
 #include <cstdlib>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <cassert>
 
 // C++ library
 #include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 // HPX-5
 #include "hpx/hpx.h"
 
 // DASHMM
+#include "dashmm/arena.h"
 #include "dashmm/array.h"
 #include "dashmm/dag.h"
 #include "dashmm/domaingeometry.h"
@@ -45,6 +54,8 @@
 #include "dashmm/rankwise.h"
 #include "dashmm/reductionops.h"
 #include "dashmm/shareddata.h"
+#include "dashmm/treestatistics.h"
+#include "dashmm/treewalk.h"
 
 
 namespace dashmm {
@@ -66,6 +77,61 @@ template <typename Source, typename Target,
 class DualTreeRegistrar;
 
 
+/// The number of bits per dimension in a full depth Morton key
+constexpr int kMortonBits = 21;
+
+static_assert(TreeShape::kLevels > kMortonBits + 1,
+              "TreeShape must cover every level of a Morton partitioned tree");
+
+/// The most levels by which an adaptive uniform grid is refined below the
+/// level chosen from the number of ranks
+///
+/// The default level gives each rank between 8 and 64 uniform grid nodes,
+/// so the histogram of the refined grid has at most 2^15 cells per rank,
+/// which is no more than the points each rank samples to fill it.
+constexpr int kUnifRefineLevels = 3;
+
+/// Split the bits of an integer to be used in a Morton Key
+inline uint64_t morton_split(unsigned k) {
+  uint64_t split = k & 0x1fffff;
+  split = (split | split << 32) & 0x1f00000000ffff;
+  split = (split | split << 16) & 0x1f0000ff0000ff;
+  split = (split | split << 8)  & 0x100f00f00f00f00f;
+  split = (split | split << 4)  & 0x10c30c30c30c30c3;
+  split = (split | split << 2)  & 0x1249249249249249;
+  return split;
+}
+
+/// Compute the Morton key for a gives set of indices
+inline uint64_t morton_key(unsigned x, unsigned y, unsigned z) {
+  uint64_t key = 0;
+  key |= morton_split(x) | morton_split(y) << 1 | morton_split(z) << 2;
+  return key;
+}
+
+/// Compute the full depth Morton key for a position in the domain
+///
+/// The resulting 63 bit key gives the position of the point at level
+/// kMortonBits of the tree. The leading 3 * l bits of the key give the
+/// ancestor of the point at level l. The integer coordinates are computed in
+/// the same way as for the assignment of points to the uniform grid, so the
+/// key prefix agrees with that assignment.
+///
+/// \param pos - the position of the point
+/// \param geo - the domain geometry
+///
+/// \returns - the Morton key of the point
+inline uint64_t morton_key(const Point &pos, const DomainGeometry *geo) {
+  Point corner = geo->low();
+  double scale = 1.0 / geo->size();
+  int dim = 1 << kMortonBits;
+  int xid = std::min(dim - 1, (int)(dim * (pos.x() - corner.x()) * scale));
+  int yid = std::min(dim - 1, (int)(dim * (pos.y() - corner.y()) * scale));
+  int zid = std::min(dim - 1, (int)(dim * (pos.z() - corner.z()) * scale));
+  return morton_key(xid, yid, zid);
+}
+
+
 /// A Node of a tree.
 ///
 /// This is a template over the record type. In DASHMM, this will be either
@@ -76,9 +142,10 @@ class Node {
   using record_t = Record;
   using node_t = Node<Record>;
   using arrayref_t = ArrayRef<Record>;
+  using arena_t = Arena<node_t>;
 
   /// The default constructor allocates nothing, and sets all to zero.
-  Node() : idx{}, parts{}, parent{nullptr}, first_{0} {
+  Node() : idx{}, parts{}, parent{nullptr}, first_{0}, pending_{0} {
     for (int i = 0; i < 8; ++i) {
       child[i] = nullptr;
     }
@@ -86,40 +153,38 @@ class Node {
     complete_ = HPX_NULL;
   }
 
-  /// Constuct with a known index. This will set the index of the node,
-  /// and will allocate the completion detection LCO.
+  /// Constuct with a known index. This will set the index of the node.
   ///
   /// \param index - the index of the node
   Node(Index index)
-      : idx{index}, parts{}, parent{nullptr}, dag{index}, first_{0} {
+      : idx{index}, parts{}, parent{nullptr}, dag{index}, first_{0},
+        pending_{0} {
     for (int i = 0; i < 8; ++i) {
       child[i] = nullptr;
     }
     sema_ = HPX_NULL;
-    complete_ = hpx_lco_and_new(8);
+    complete_ = HPX_NULL;
   }
 
   /// Construct with an index, a particle segment and a parent
   ///
-  /// This will also create the completion detection LCO.
-  ///
   /// \param index - the node index
   /// \param parts - the particles inside the volume represented by this node
   /// \param parent - the parent of this node
   Node(Index index, arrayref_t parts, node_t *parent)
-      : idx{index}, parts{parts}, parent{parent}, dag{index}, first_{0} {
+      : idx{index}, parts{parts}, parent{parent}, dag{index}, first_{0},
+        pending_{0} {
     for (int i = 0; i < 8; ++i) {
       child[i] = nullptr;
     }
     sema_ = HPX_NULL;
-    complete_ = hpx_lco_and_new(8);
+    complete_ = HPX_NULL;
   }
 
   /// Any allocated LCOs are cleaned up explicitly.
   ///
-  /// The completion LCOs are cleaned up as they finish their detection, and
-  /// pass on any messages dependent on them. Very few nodes of the tree ever
-  /// get a lock, so those are cleaned up when needed.
+  /// Only the nodes of the uniform grid have a completion LCO, and only those
+  /// nodes have a lock; these are cleaned up when the tree is deleted.
   ~Node() { }
 
   /// Returns the first record into which new records may be copied.
@@ -135,6 +200,10 @@ class Node {
   size_t num_parts() const {return parts.n();}
 
   /// Create a completion detection and gate
+  ///
+  /// This is only used for the nodes of the uniform grid. Completion of the
+  /// partitioning of the nodes below the uniform grid is tracked with
+  /// counters in the nodes, and is signaled only to this LCO.
   void add_completion() {
     assert(complete_ == HPX_NULL);
     complete_ = hpx_lco_and_new(8);
@@ -202,21 +271,16 @@ class Node {
   /// \param geo - the domain geometry
   /// \param same_sandt - is this a run where the sources and targets are
   ///                     identical.
-  void partition(int threshold, DomainGeometry *geo, int same_sandt) {
+  /// \param arena - the arena from which to allocate the child nodes
+  void partition(int threshold, DomainGeometry *geo, int same_sandt,
+                 arena_t *arena) {
     size_t num_points = num_parts();
     assert(num_points >= 1);
     bool is_leaf = num_points <= (size_t)threshold;
 
-    if (parent && parent->complete() != HPX_NULL) {
-      hpx_call_when_with_continuation(complete_,
-          parent->complete(), hpx_lco_set_action,
-          complete_, hpx_lco_delete_action,
-          nullptr, 0);
-    }
-
     if (is_leaf) {
       // No children means this node is done with partitioning
-      hpx_lco_and_set_num(complete_, 8, HPX_NULL);
+      partition_done();
     } else {
       // Compute center of the node
       double h = geo->size() / pow(2, idx.level());
@@ -253,15 +317,12 @@ class Node {
         splits[5] = std::partition_point(splits[4], splits[6], x_comp);
         splits[7] = std::partition_point(splits[6], splits[8], x_comp);
       } else {
-        splits[4] = std::partition(splits[0], splits[8], z_comp);
-
-        splits[2] = std::partition(splits[0], splits[4], y_comp);
-        splits[6] = std::partition(splits[4], splits[8], y_comp);
-
-        splits[1] = std::partition(splits[0], splits[2], x_comp);
-        splits[3] = std::partition(splits[2], splits[4], x_comp);
-        splits[5] = std::partition(splits[4], splits[6], x_comp);
-        splits[7] = std::partition(splits[6], splits[8], x_comp);
+        double center[3]{center_x, center_y, center_z};
+        size_t count[8]{};
+        sort_into_octants(p, num_points, center, count);
+        for (int i = 0; i < 8; ++i) {
+          splits[i + 1] = splits[i] + count[i];
+        }
       }
 
       // Perform some counting
@@ -275,17 +336,154 @@ class Node {
         offset[i] = offset[i - 1] + stat[i - 1];
       }
 
-      // Create child nodes
+      // Create child nodes; the count of pending children has to be set
+      // before any of the children might finish.
+      int n_pending{0};
       for (int i = 0; i < 8; ++i) {
         if (stat[i]) {
           auto cparts = parts.slice(offset[i], stat[i]);
-          node_t *cnd = new node_t{idx.child(i), cparts, this};
-          child[i] = cnd;
+          child[i] = arena->create(idx.child(i), cparts, this);
+          ++n_pending;
+        }
+      }
+      pending_.store(n_pending);
 
+      for (int i = 0; i < 8; ++i) {
+        if (child[i]) {
+          node_t *cnd = child[i];
           hpx_call(HPX_HERE, partition_node_, HPX_NULL,
-                   &cnd, &geo, &threshold, &same_sandt);
-        } else {
-          hpx_lco_and_set(complete_, HPX_NULL);
+                   &cnd, &geo, &threshold, &same_sandt, &arena);
+        }
+      }
+    }
+  }
+
+  /// Signal that the branch below this node is partitioned
+  ///
+  /// This is called when a leaf is reached during partitioning. The pending
+  /// child count of each ancestor is decremented in turn, stopping at the
+  /// first ancestor that still has children being partitioned. If the
+  /// decrements reach the uniform grid node at the root of the branch, its
+  /// completion LCO is set, as the whole branch is then complete.
+  void partition_done() {
+    node_t *curr = this;
+    while (curr->complete_ == HPX_NULL) {
+      curr = curr->parent;
+      assert(curr != nullptr);
+      if (curr->pending_.fetch_sub(1) != 1) {
+        return;
+      }
+    }
+    hpx_lco_and_set_num(curr->complete_, 8, HPX_NULL);
+  }
+
+  /// Partition the node using Morton keys
+  ///
+  /// This is an alternative to partition() that builds the full branch below
+  /// this node in one step. A full depth Morton key is computed for each
+  /// record, and the records are sorted by their key once. After sorting, the
+  /// records for any node of the branch are contiguous, and the children of
+  /// a node are found by searching the sorted keys for the boundaries of the
+  /// eight key prefixes one level down. Each record is moved exactly once,
+  /// and no actions or LCOs are needed below this node.
+  ///
+  /// As the keys have a finite depth, the refinement stops at level
+  /// kMortonBits even if the node would otherwise be split.
+  ///
+  /// @p same_sandt will be nonzero only for target nodes, and only sometimes.
+  /// In this case the records have already been sorted by the source tree
+  /// and only the keys are computed.
+  ///
+  /// \param threshold - the partitioning threshold
+  /// \param geo - the domain geometry
+  /// \param same_sandt - is this a run where the sources and targets are
+  ///                     identical.
+  /// \param arena - the arena from which to allocate the nodes of the branch
+  void partition_by_key(int threshold, DomainGeometry *geo, int same_sandt,
+                        arena_t *arena) {
+    assert(num_parts() >= 1);
+    split_by_key(threshold, geo, same_sandt, arena);
+    hpx_lco_and_set_num(complete_, 8, HPX_NULL);
+  }
+
+  /// Build the branch below this node using Morton keys
+  ///
+  /// This does the work of partition_by_key(), without signaling completion.
+  /// This node must not have any children.
+  ///
+  /// \param threshold - the partitioning threshold
+  /// \param geo - the domain geometry
+  /// \param same_sandt - is this a run where the sources and targets are
+  ///                     identical.
+  /// \param arena - the arena from which to allocate the nodes of the branch
+  void split_by_key(int threshold, const DomainGeometry *geo, int same_sandt,
+                    arena_t *arena) {
+    size_t num_points = num_parts();
+
+    if (num_points > (size_t)threshold) {
+      record_t *p = parts.data();
+
+      std::vector<uint64_t> keys(num_points);
+      if (same_sandt) {
+        for (size_t i = 0; i < num_points; ++i) {
+          keys[i] = morton_key(p[i].position, geo);
+        }
+        assert(std::is_sorted(keys.begin(), keys.end()));
+      } else {
+        std::vector<std::pair<uint64_t, size_t>> sorter(num_points);
+        for (size_t i = 0; i < num_points; ++i) {
+          sorter[i] = std::make_pair(morton_key(p[i].position, geo), i);
+        }
+        std::sort(sorter.begin(), sorter.end());
+
+        record_t *scratch = reinterpret_cast<record_t *>(
+                                new char[sizeof(record_t) * num_points]);
+        for (size_t i = 0; i < num_points; ++i) {
+          keys[i] = sorter[i].first;
+          scratch[i] = p[sorter[i].second];
+        }
+        memcpy(p, scratch, sizeof(record_t) * num_points);
+        delete [] reinterpret_cast<char *>(scratch);
+      }
+
+      // Derive the branch from the key prefixes. NOTE: this is not recursive
+      // because HPX-5 has small default stacks.
+      struct KeyRange {
+        node_t *node;
+        size_t begin;
+        size_t end;
+      };
+      std::vector<KeyRange> V{KeyRange{this, 0, num_points}};
+      while (!V.empty()) {
+        KeyRange curr = V.back();
+        V.pop_back();
+
+        int level = curr.node->idx.level();
+        if (curr.end - curr.begin <= (size_t)threshold
+            || level >= kMortonBits) {
+          continue;
+        }
+
+        int shift = 3 * (kMortonBits - level - 1);
+        auto first = keys.begin() + curr.begin;
+        auto last = keys.begin() + curr.end;
+        for (int i = 0; i < 8; ++i) {
+          auto next = std::partition_point(first, last,
+              [shift, i](uint64_t key) {
+                return (int)((key >> shift) & 0x7) <= i;
+              });
+          size_t cbegin = first - keys.begin();
+          size_t cend = next - keys.begin();
+          if (cend > cbegin) {
+            node_t *cnd = arena->create();
+            cnd->idx = curr.node->idx.child(i);
+            cnd->dag.set_index(cnd->idx);
+            cnd->parts = parts.slice(cbegin, cend - cbegin);
+            cnd->parent = curr.node;
+            curr.node->child[i] = cnd;
+            V.push_back(KeyRange{cnd, cbegin, cend});
+          }
+          first = next;
         }
       }
     }
@@ -380,11 +578,16 @@ class Node {
   /// \param branch - buffers holding the tree structure
   /// \param tree -
   /// \param n_nodes - the number of nodes
-  void extract(const int *branch, const int *tree, int n_nodes) {
+  /// \param arena - the arena from which to allocate the nodes
+  void extract(const int *branch, const int *tree, int n_nodes,
+               arena_t *arena) {
     // Extract a compressed remote tree representation. As the tree is remote,
     // only {parent, child, idx} fields are needed.
 
-    node_t *descendants = new node_t[n_nodes]{};
+    std::vector<node_t *> descendants(n_nodes);
+    for (int i = 0; i < n_nodes; ++i) {
+      descendants[i] = arena->create();
+    }
 
     // The compressed tree is created in depth first fashion. And there are two
     // choices here to fill in the parent, child, and idx fields of the
@@ -406,8 +609,8 @@ class Node {
     for (int i = 0; i < n_nodes; ++i) {
       int pos = tree[i];
       int which = branch[i];
-      node_t *curr = &descendants[i];
-      node_t *parent = (pos < 0 ? this : &descendants[pos]);
+      node_t *curr = descendants[i];
+      node_t *parent = (pos < 0 ? this : descendants[pos]);
 
       curr->parent = parent;
       curr->idx = parent->idx.child(which);
@@ -448,31 +651,309 @@ class Node {
     return (is_leaf() && parts.n() == 0);
   }
 
-  /// Destroy the data in a branch
+  /// Replace the completion LCO of a uniform grid node
+  ///
+  /// The completion LCOs of the uniform grid nodes owned by other ranks are
+  /// deleted once their branch has been received. This creates a new LCO so
+  /// that the branch can be received again after the tree is updated. The
+  /// previous LCO must already have been deleted.
+  void renew_completion() {
+    complete_ = HPX_NULL;
+    add_completion();
+  }
+
+  /// Test if a point is inside the volume represented by this node
+  ///
+  /// The faces of the node are treated as in partition(), so that a point on
+  /// the face between two nodes is inside the node with the larger index.
+  /// Points on the high faces of the domain are inside the nodes touching
+  /// those faces.
+  ///
+  /// \param pos - the point in question
+  /// \param geo - the domain geometry
+  ///
+  /// \returns - true if the point is inside this node; false otherwise
+  bool contains(const Point &pos, const DomainGeometry *geo) const {
+    int dim = 1 << idx.level();
+    double h = geo->size() / pow(2, idx.level());
+    Point corner = geo->low();
+    int id[3] = {idx.x(), idx.y(), idx.z()};
+    for (int d = 0; d < 3; ++d) {
+      if (id[d] > 0 && pos[d] < corner[d] + id[d] * h) {
+        return false;
+      }
+      if (id[d] < dim - 1 && pos[d] >= corner[d] + (id[d] + 1) * h) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Return which child of this node would contain a point
+  ///
+  /// \param pos - the point in question
+  /// \param geo - the domain geometry
+  ///
+  /// \returns - the child index for the octant containing @p pos
+  int which_child(const Point &pos, const DomainGeometry *geo) const {
+    double h = geo->size() / pow(2, idx.level());
+    Point corner = geo->low();
+    int retval{0};
+    if (pos.x() >= corner.x() + (idx.x() + 0.5) * h) {
+      retval += 1;
+    }
+    if (pos.y() >= corner.y() + (idx.y() + 0.5) * h) {
+      retval += 2;
+    }
+    if (pos.z() >= corner.z() + (idx.z() + 0.5) * h) {
+      retval += 4;
+    }
+    return retval;
+  }
+
+  /// Remove the records that have left the leaves of this branch
   ///
-  /// This is only ever called on the local nodes. This will traverse the
-  /// branch and delete all nodes below the given node.
+  /// The records of each leaf below this node are reordered so that those
+  /// still inside the leaf come first, and the number of these is saved in
+  /// the leaf (see first()). The remaining records are appended to
+  /// @p movers.
   ///
-  /// \param root - the root of the branch.
-  static void destroy_branch(node_t *root) {
-    // NOTE: this is not recursive because HPX-5 has small default stacks.
-    std::vector<node_t *> V{root};
+  /// \param geo - the domain geometry
+  /// \param movers [out] - the records that have left their leaf
+  void collect_movers(const DomainGeometry *geo,
+                      std::vector<record_t> *movers) {
+    // NOTE: not recursive because HPX-5 has small default stacks.
+    std::vector<node_t *> V{this};
     while (!V.empty()) {
-      std::vector<node_t *> C{};
-      for (size_t i = 0; i < V.size(); ++i) {
-        assert(V[i] != nullptr);
-        for (int j = 0; j < 8; ++j) {
-          if (V[i]->child[j]) {
-            C.push_back(V[i]->child[j]);
+      node_t *curr = V.back();
+      V.pop_back();
+
+      if (curr->is_leaf()) {
+        record_t *p = curr->parts.data();
+        record_t *end = p + curr->parts.n();
+        record_t *mid = std::partition(p, end,
+            [curr, geo](const record_t &a) {
+              return curr->contains(a.position, geo);
+            });
+        curr->first_ = mid - p;
+        movers->insert(movers->end(), mid, end);
+      } else {
+        for (int i = 0; i < 8; ++i) {
+          if (curr->child[i]) {
+            V.push_back(curr->child[i]);
           }
         }
-        delete V[i];
-        V[i] = nullptr;
       }
-      V = std::move(C);
     }
   }
 
+  /// Rebuild the branch below this node after records have moved
+  ///
+  /// This is used to update a uniform grid node once collect_movers() has
+  /// been called on every node, and the records have been routed to the
+  /// uniform grid node containing them. Each incoming record is placed in
+  /// the leaf containing it, creating the leaf if needed. The records are
+  /// then laid out in @p out, which must have room for exactly the remaining
+  /// and incoming records of this branch. Nodes that have become empty are
+  /// removed, nodes with no more than @p threshold records become leaves,
+  /// and leaves with more than @p threshold records are split with
+  /// split_by_key(). With DASHMM_MORTON_PARTITION, the resulting branch is
+  /// the one that partitioning the records from scratch would give. With
+  /// partition(), it is the same down to level kMortonBits, where
+  /// split_by_key() stops refining; a leaf split here that would need more
+  /// levels is left at that level.
+  ///
+  /// \param incoming - the records that have moved into this branch
+  /// \param out - the segment into which the records are laid out
+  /// \param geo - the domain geometry
+  /// \param threshold - the partitioning threshold
+  /// \param arena - the arena from which nodes are allocated and destroyed
+  void rebuild_branch(const std::vector<record_t> &incoming, arrayref_t out,
+                      const DomainGeometry *geo, int threshold,
+                      arena_t *arena) {
+    // Place the incoming records
+    std::unordered_map<node_t *, std::vector<size_t>> placed{};
+    for (size_t i = 0; i < incoming.size(); ++i) {
+      node_t *curr = this;
+      while (!curr->is_leaf()) {
+        int which = curr->which_child(incoming[i].position, geo);
+        if (curr->child[which] == nullptr) {
+          curr->child[which] = arena->create(curr->idx.child(which),
+                                             arrayref_t{}, curr);
+        }
+        curr = curr->child[which];
+      }
+      placed[curr].push_back(i);
+    }
+
+    // List the branch in depth first order, and count the records below
+    // each node. The children of a node are listed in order, so the records
+    // of each node are contiguous when laid out in this order.
+    struct Entry {
+      node_t *node;
+      int parent;
+      size_t count;
+      size_t size;
+      size_t offset;
+    };
+    std::vector<Entry> order{};
+    std::vector<std::pair<node_t *, int>> V{std::make_pair(this, -1)};
+    while (!V.empty()) {
+      node_t *curr = V.back().first;
+      int pos = order.size();
+      order.push_back(Entry{curr, V.back().second, 0, 1, 0});
+      V.pop_back();
+
+      if (curr->is_leaf()) {
+        auto it = placed.find(curr);
+        order[pos].count = curr->first_
+                           + (it == placed.end() ? 0 : it->second.size());
+      } else {
+        for (int i = 7; i >= 0; --i) {
+          if (curr->child[i]) {
+            V.push_back(std::make_pair(curr->child[i], pos));
+          }
+        }
+      }
+    }
+    for (size_t k = order.size() - 1; k > 0; --k) {
+      order[order[k].parent].count += order[k].count;
+      order[order[k].parent].size += order[k].size;
+    }
+    assert(order[0].count == out.n());
+    std::vector<size_t> cursor(order.size(), 0);
+    for (size_t k = 1; k < order.size(); ++k) {
+      int parent = order[k].parent;
+      order[k].offset = order[parent].offset + cursor[parent];
+      cursor[parent] += order[k].count;
+    }
+
+    // Copy the records of the leaves in [first, last) of the listing to dest
+    auto copy_leaves = [&order, &placed, &incoming](size_t first, size_t last,
+                                                    record_t *dest) {
+      for (size_t k = first; k < last; ++k) {
+        node_t *curr = order[k].node;
+        if (!curr->is_leaf()) {
+          continue;
+        }
+        memcpy(dest, curr->parts.data(), sizeof(record_t) * curr->first_);
+        dest += curr->first_;
+        auto it = placed.find(curr);
+        if (it != placed.end()) {
+          for (size_t i : it->second) {
+            *dest++ = incoming[i];
+          }
+        }
+      }
+    };
+
+    // Lay out the records and fix up the structure. When a node is removed
+    // or becomes a leaf, its branch is skipped in the listing.
+    size_t k = 0;
+    while (k < order.size()) {
+      node_t *curr = order[k].node;
+      size_t next = k + order[k].size;
+
+      if (order[k].count == 0) {
+        curr->clear_branch(arena);
+        if (k == 0) {
+          curr->parts = arrayref_t{};
+        } else {
+          curr->parent->remove_child(curr);
+          arena->destroy(curr);
+        }
+      } else if (curr->is_leaf()
+                 || order[k].count <= (size_t)threshold) {
+        arrayref_t cparts = out.slice(order[k].offset, order[k].count);
+        copy_leaves(k, next, cparts.data());
+        curr->clear_branch(arena);
+        curr->parts = cparts;
+        curr->split_by_key(threshold, geo, 0, arena);
+      } else {
+        curr->parts = out.slice(order[k].offset, order[k].count);
+        next = k + 1;
+      }
+
+      k = next;
+    }
+  }
+
+  /// Move the segments of the branch below this node
+  ///
+  /// The records of this node have been copied from @p from to @p to, and
+  /// the segment of each node of the branch is moved with them.
+  ///
+  /// \param from - the old location of the records of this node
+  /// \param to - the new location of the records of this node
+  void rebase_branch(const record_t *from, record_t *to) {
+    std::vector<node_t *> V{this};
+    while (!V.empty()) {
+      node_t *curr = V.back();
+      V.pop_back();
+      curr->parts = arrayref_t{to + (curr->parts.data() - from),
+                               curr->parts.n()};
+      for (int i = 0; i < 8; ++i) {
+        if (curr->child[i]) {
+          V.push_back(curr->child[i]);
+        }
+      }
+    }
+  }
+
+  /// Make the branch below this node a copy of another branch
+  ///
+  /// This is used when the sources and targets are identical. The nodes of
+  /// this branch share the records of the nodes of @p source.
+  ///
+  /// \param source - the node whose branch is copied
+  /// \param arena - the arena from which nodes are allocated and destroyed
+  template <typename Other>
+  void mirror_branch(const Node<Other> *source, arena_t *arena) {
+    clear_branch(arena);
+    parts = arrayref_t{(record_t *)source->parts.data(), source->parts.n()};
+
+    std::vector<std::pair<const Node<Other> *, node_t *>> V{
+      std::make_pair(source, this)};
+    while (!V.empty()) {
+      const Node<Other> *from = V.back().first;
+      node_t *to = V.back().second;
+      V.pop_back();
+      for (int i = 0; i < 8; ++i) {
+        if (from->child[i]) {
+          const Node<Other> *fc = from->child[i];
+          to->child[i] = arena->create(fc->idx,
+              arrayref_t{(record_t *)fc->parts.data(), fc->parts.n()}, to);
+          V.push_back(std::make_pair(fc, to->child[i]));
+        }
+      }
+    }
+  }
+
+  /// Remove the branch below this node
+  ///
+  /// The descendants of this node are returned to @p arena, and this node
+  /// becomes a leaf.
+  ///
+  /// \param arena - the arena from which the descendants were allocated
+  void clear_branch(arena_t *arena) {
+    std::vector<node_t *> V{};
+    for (int i = 0; i < 8; ++i) {
+      if (child[i]) {
+        V.push_back(child[i]);
+        child[i] = nullptr;
+      }
+    }
+    while (!V.empty()) {
+      node_t *curr = V.back();
+      V.pop_back();
+      for (int i = 0; i < 8; ++i) {
+        if (curr->child[i]) {
+          V.push_back(curr->child[i]);
+        }
+      }
+      arena->destroy(curr);
+    }
+  }
 
   Index idx;                      /// index of the node
   arrayref_t parts;               /// segment for this node
@@ -486,100 +967,552 @@ class Node {
   friend class NodeRegistrar<Record>;
 
   static int partition_node_handler(node_t *n, DomainGeometry *geo,
-                                    int threshold, int same_sandt) {
-    n->partition(threshold, geo, same_sandt);
+                                    int threshold, int same_sandt,
+                                    arena_t *arena) {
+#ifdef DASHMM_MORTON_PARTITION
+    n->partition_by_key(threshold, geo, same_sandt, arena);
+#else
+    n->partition(threshold, geo, same_sandt, arena);
+#endif
+    return HPX_SUCCESS;
+  }
+
+  /// Return the number of chunks in which to classify the records of a node
+  ///
+  /// Each chunk has at least 16384 records, and there is at most one chunk
+  /// per worker thread. So a node is split once it has 32768 records;
+  /// smaller nodes are classified by the calling thread.
+  ///
+  /// \param n - the number of records
+  static int octant_chunks(size_t n) {
+    // The children of a node are partitioned concurrently, so only the few
+    // largest nodes near the top of each branch are worth splitting up.
+    size_t min_chunk_size = 16384;
+    size_t n_chunks = std::min((size_t)hpx_get_num_threads(),
+                               n / min_chunk_size);
+    return std::max(n_chunks, size_t{1});
+  }
+
+  /// Sort the records of a node into its octants
+  ///
+  /// This does the work of three nested std::partition calls in one pass.
+  /// The octant of each record is computed first, and the records are then
+  /// permuted in place by following cycles, so that each record is moved
+  /// only once. The octants are numbered as the children of the node: bit 0
+  /// of the octant is set if the record is not below the center in x, bit 1
+  /// likewise for y, and bit 2 for z.
+  ///
+  /// For large nodes, the octants are computed in chunks by several actions.
+  ///
+  /// \param p - the records
+  /// \param n - the number of records
+  /// \param center - the center of the node
+  /// \param count [out] - the number of records in each octant
+  static void sort_into_octants(record_t *p, size_t n, const double *center,
+                                size_t *count) {
+    std::vector<uint8_t> codes(n);
+    int n_chunks = octant_chunks(n);
+
+    if (n_chunks == 1) {
+      classify_octants_handler(p, n, center, codes.data(), count);
+    } else {
+      std::vector<size_t> chunk_count(8 * n_chunks);
+      hpx_addr_t done = hpx_lco_and_new(n_chunks);
+      assert(done != HPX_NULL);
+      for (int c = 0; c < n_chunks; ++c) {
+        size_t b = n * c / n_chunks;
+        size_t n_chunk = n * (c + 1) / n_chunks - b;
+        const record_t *p_chunk = &p[b];
+        uint8_t *codes_chunk = &codes[b];
+        size_t *count_chunk = &chunk_count[8 * c];
+        hpx_call(HPX_HERE, classify_octants_, done, &p_chunk, &n_chunk,
+                 &center, &codes_chunk, &count_chunk);
+      }
+      hpx_lco_wait(done);
+      hpx_lco_delete_sync(done);
+
+      for (int oct = 0; oct < 8; ++oct) {
+        count[oct] = 0;
+        for (int c = 0; c < n_chunks; ++c) {
+          count[oct] += chunk_count[8 * c + oct];
+        }
+      }
+    }
+
+    size_t next[8];
+    size_t end[8];
+    size_t pos{0};
+    for (int oct = 0; oct < 8; ++oct) {
+      next[oct] = pos;
+      pos += count[oct];
+      end[oct] = pos;
+    }
+
+    // Each swap puts one record in its final place
+    for (int oct = 0; oct < 8; ++oct) {
+      while (next[oct] < end[oct]) {
+        size_t i = next[oct];
+        int dest = codes[i];
+        if (dest == oct) {
+          ++next[oct];
+        } else {
+          size_t j = next[dest]++;
+          std::swap(p[i], p[j]);
+          std::swap(codes[i], codes[j]);
+        }
+      }
+    }
+  }
+
+  /// Compute the octants of a range of records
+  ///
+  /// The comparisons are written without branches so that the loop can be
+  /// vectorized.
+  ///
+  /// \param p - the records
+  /// \param n - the number of records
+  /// \param center - the center of the node
+  /// \param codes [out] - the octant of each record
+  /// \param count [out] - the number of records in each octant
+  ///
+  /// \returns - HPX_SUCCESS
+  static int classify_octants_handler(const record_t *p, size_t n,
+                                      const double *center, uint8_t *codes,
+                                      size_t *count) {
+    double cx = center[0];
+    double cy = center[1];
+    double cz = center[2];
+    for (size_t i = 0; i < n; ++i) {
+      const Point &pos = p[i].position;
+      codes[i] = (uint8_t)((pos.x() >= cx) | ((pos.y() >= cy) << 1)
+                           | ((pos.z() >= cz) << 2));
+    }
+
+    for (int oct = 0; oct < 8; ++oct) {
+      count[oct] = 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      ++count[codes[i]];
+    }
+
     return HPX_SUCCESS;
   }
 
+  static hpx_action_t classify_octants_;
+
   size_t first_;            /// first record that is available
   hpx_addr_t sema_;         /// restrict concurrent modification
   hpx_addr_t complete_;     /// This is used to indicate that partitioning is
                             ///  complete
+  std::atomic<int> pending_; /// children still being partitioned
 };
 
 template <typename R>
 hpx_action_t Node<R>::partition_node_ = HPX_ACTION_NULL;
 
+template <typename R>
+hpx_action_t Node<R>::classify_octants_ = HPX_ACTION_NULL;
 
-/////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////
 
-// Tree needs a DualTree forward declaration
-template <typename Source, typename Target,
-          template <typename, typename> class Expansion,
-          template <typename, typename,
-                    template <typename, typename> class> class Method>
-class DualTree;
+/// A compact node in the frozen form of a tree
+///
+/// The frozen tree stores its nodes in level order, with the children of each
+/// node stored contiguously. A FlatNode refers to other nodes by offsets, so
+/// it does not depend on the Record type. The records of a node are reached
+/// through its Node; see TreeData::flat_node().
+struct FlatNode {
+  Index idx;        /// the index of the node
+  int child;        /// offset of the first child; -1 for leaves
+  uint8_t mask;     /// bit i is set if the node has a child i
+
+  /// Return the offset of a given child
+  ///
+  /// \param which - the child; the node must have this child
+  ///
+  /// \returns - offset of the child in the frozen tree
+  int child_offset(int which) const {
+    assert(mask & (1 << which));
+    return child + (int)std::bitset<8>(mask & ((1 << which) - 1)).count();
+  }
+};
 
 
-/// The tree class represents one of the trees in a given evaluation
+/// The state of a tree
 ///
-/// The Tree is a template over the typical DASHMM types, as well as a
-/// Record type that indicates if this is a Source tree or a Target tree.
+/// Everything that a Tree stores depends only on the Record type, and not on
+/// the Expansion or the Method of the evaluation. Tree derives from this
+/// class, so that the state of a tree can be handed between the Tree objects
+/// of evaluations that share the Source and Target types, but not the
+/// kernel or the method; see DualTree::export_tree_handler().
 ///
-/// The nodes are arranged in a hybrid way in this tree. The top of the tree
-/// (up to and including the finest uniform level) are allocated in an array.
-/// The branches owned by this rank are allocated in the traditional fashion,
-/// one node at a time. Branches from remotes are allocated in an array.
-/// The two different schemes reflect that we sometimes know how many nodes we
-/// shall need, and other times we do not.
-template <typename Source, typename Target, typename Record,
-          template <typename, typename> class Expansion,
-          template <typename, typename,
-                    template <typename, typename> class> class Method>
-class Tree {
+/// The operations on the frozen form of a tree also only depend on the
+/// Record type, and so are provided here.
+template <typename Record>
+class TreeData {
  public:
   using record_t = Record;
   using node_t = Node<Record>;
-  using sourcenode_t = Node<Source>;
-  using targetnode_t = Node<Target>;
   using arrayref_t = ArrayRef<Record>;
-  using tree_t = Tree<Source, Target, Record, Expansion, Method>;
-  using sourcetree_t = Tree<Source, Target, Source, Expansion, Method>;
-  using dualtree_t = DualTree<Source, Target, Expansion, Method>;
+  using arena_t = Arena<node_t>;
 
-  /// Tree construction just default initializes the object
-  Tree() : root_{nullptr}, unif_grid_{nullptr}, unif_done_{HPX_NULL},
-           sorted_{} { }
+  /// Construction just default initializes the object
+  TreeData() : root_{nullptr}, unif_grid_{nullptr}, unif_done_{HPX_NULL},
+               sorted_{}, arena_{}, leaf_limit_{}, outgoing_{}, incoming_{},
+               flat_{}, flat_nodes_{}, level_first_{}, lco_index_{},
+               n_lookups_{0}, lookup_ns_{0} { }
+
+  TreeData(const TreeData<Record> &other) = delete;
+  TreeData<Record> &operator=(const TreeData<Record> &other) = delete;
 
   arrayref_t sorted() const {return sorted_;}
 
-  /// Setup some basic information during initial tree construction
+  /// Return the arena from which the nodes of this tree are allocated
+  arena_t *arena() {return &arena_;}
+
+  /// Return the most records in a leaf below a uniform grid node
   ///
-  /// This action is the target of a broadcast. The basic information about
-  /// the tree is set up in this action. The most important of which is the
-  /// allocation of the top portions of the tree containing the root, and
-  /// extending to the finest uniform level of partitioning.
+  /// \param id - the uniform grid node
+  int leaf_limit(int id) const {return leaf_limit_[id];}
+
+  /// Set the most records in a leaf below each uniform grid node
   ///
-  /// \param tree - the address of the tree on which to act
-  /// \param unif_level - the uniform partitioning level
-  static int setup_basics_handler(tree_t *tree, int unif_level) {
-    tree->unif_done_ = hpx_lco_and_new(1);
-    assert(tree->unif_done_ != HPX_NULL);
+  /// \param limits - the limit for each uniform grid node
+  void set_leaf_limits(const std::vector<int> &limits) {leaf_limit_ = limits;}
 
-    // Setup unif_grid
-    int n_top_nodes{1};
-    for (int i = 1; i < unif_level; ++i) {
-      n_top_nodes += pow(8, i);
+  /// Exchange the state of this tree with that of another
+  ///
+  /// No nodes or records are moved, so pointers into either tree remain
+  /// valid, but now belong to the other object. This is not thread safe.
+  ///
+  /// \param other - the other tree
+  void swap(TreeData<Record> &other) {
+    std::swap(root_, other.root_);
+    std::swap(unif_grid_, other.unif_grid_);
+    std::swap(unif_done_, other.unif_done_);
+    std::swap(sorted_, other.sorted_);
+    arena_.swap(other.arena_);
+    leaf_limit_.swap(other.leaf_limit_);
+    outgoing_.swap(other.outgoing_);
+    incoming_.swap(other.incoming_);
+    flat_.swap(other.flat_);
+    flat_nodes_.swap(other.flat_nodes_);
+    level_first_.swap(other.level_first_);
+    for (int kind = 0; kind < kLCOKinds; ++kind) {
+      lco_index_[kind].swap(other.lco_index_[kind]);
     }
-    int dim3 = pow(8, unif_level);
-    tree->root_ = new node_t[n_top_nodes + dim3]{};
-    tree->unif_grid_ = &tree->root_[n_top_nodes];
+    n_lookups_ = other.n_lookups_.exchange(n_lookups_);
+    lookup_ns_ = other.lookup_ns_.exchange(lookup_ns_);
+  }
 
-    tree->root_[0].idx = Index{0, 0, 0, 0};
-    int startingnode{0};
-    int stoppingnode{1};
-    for (int level = 0; level < unif_level ; ++level) {
-      for (int nd = startingnode; nd < stoppingnode; ++nd) {
-        node_t *snode = &tree->root_[nd];
+  /// Store the tree in level order in a flat array
+  ///
+  /// The evaluation only reads the tree, so once the tree is partitioned it
+  /// can be frozen into an array of FlatNode, stored in level order with the
+  /// children of each node contiguous. Passes over the tree can then loop
+  /// over the array, or over one level of it, instead of chasing pointers.
+  /// The Node objects remain, as they hold the DAG information, and are
+  /// available in the same order from flat_node().
+  ///
+  /// This must be called again if the tree changes. As this is done before
+  /// each DAG is created, the DAG nodes left from a previous DAG are removed
+  /// here. Any LCOs served by those DAG nodes must already have been
+  /// destroyed.
+  void freeze() {
+    flat_.clear();
+    flat_nodes_.clear();
+    level_first_.clear();
+
+    // A breadth first traversal gives the level order directly
+    flat_nodes_.push_back(root_);
+    for (size_t i = 0; i < flat_nodes_.size(); ++i) {
+      node_t *curr = flat_nodes_[i];
+      curr->dag.clear();
+      if ((int)level_first_.size() == curr->idx.level()) {
+        level_first_.push_back(i);
+      }
 
-        if (level != unif_level - 1) {
-          // At the lower levels, we do not require the ordering
-          int firstchild = nd * 8 + 1;
-          for (int i = 0; i < 8; ++i) {
-            node_t *scnode = &tree->root_[firstchild + i];
+      FlatNode flat{};
+      flat.idx = curr->idx;
+      flat.child = -1;
+      flat.mask = 0;
+      for (int which = 0; which < 8; ++which) {
+        if (curr->child[which] == nullptr) continue;
+        if (flat.child < 0) {
+          flat.child = flat_nodes_.size();
+        }
+        flat.mask |= (1 << which);
+        flat_nodes_.push_back(curr->child[which]);
+      }
+
+      flat_.push_back(flat);
+    }
+    level_first_.push_back(flat_.size());
+  }
+
+  /// Return the number of nodes in the frozen tree
+  int flat_size() const {return flat_.size();}
+
+  /// Return the number of levels in the frozen tree
+  int flat_levels() const {return (int)level_first_.size() - 1;}
+
+  /// Return the offset of the first node of a level in the frozen tree
+  ///
+  /// \param level - the level; flat_levels() gives the end of the array
+  int flat_level_first(int level) const {return level_first_[level];}
+
+  /// Return a node of the frozen tree
+  const FlatNode &flat(int i) const {return flat_[i];}
+
+  /// Return the Node for a node of the frozen tree
+  node_t *flat_node(int i) const {return flat_nodes_[i];}
+
+  /// Build the index of the LCOs of this tree on this rank
+  ///
+  /// The index maps the Index of a node, and the kind of LCO, to the address
+  /// of the LCO. It is used by lookup_lco_addx(), and so this must be called
+  /// once the LCOs of the frozen tree are created.
+  void index_lcos() {
+    int myrank = hpx_get_my_rank();
+    for (int kind = 0; kind < kLCOKinds; ++kind) {
+      lco_index_[kind].clear();
+    }
+
+    for (size_t i = 0; i < flat_nodes_.size(); ++i) {
+      node_t *curr = flat_nodes_[i];
+      const Index &key = curr->idx;
+      if (curr->dag.has_normal() && curr->dag.normal()->locality == myrank) {
+        lco_index_[kNormalLCO][key] = curr->dag.normal()->global_addx;
+      }
+      if (curr->dag.has_parts() && curr->dag.parts()->locality == myrank) {
+        lco_index_[kPartsLCO][key] = curr->dag.parts()->global_addx;
+      }
+      if (curr->dag.has_interm() && curr->dag.interm()->locality == myrank) {
+        lco_index_[kIntermLCO][key] = curr->dag.interm()->global_addx;
+      }
+    }
+
+    n_lookups_ = 0;
+    lookup_ns_ = 0;
+  }
+
+  /// Release the index of the LCOs
+  ///
+  /// This should be called once the LCOs are destroyed.
+  void clear_lco_index() {
+    for (int kind = 0; kind < kLCOKinds; ++kind) {
+      lco_index_[kind].clear();
+    }
+  }
+
+  /// Return the number of entries in the index of the LCOs
+  size_t lco_index_size() const {
+    size_t retval{0};
+    for (int kind = 0; kind < kLCOKinds; ++kind) {
+      retval += lco_index_[kind].size();
+    }
+    return retval;
+  }
+
+  /// Return the number of lookups since the index was built
+  ///
+  /// The lookups are only counted if DASHMMEXTRATIMING is defined.
+  size_t lookup_count() const {return n_lookups_;}
+
+  /// Return the total time in microseconds of the lookups since the index
+  /// was built
+  ///
+  /// The lookups are only timed if DASHMMEXTRATIMING is defined.
+  double lookup_time() const {return lookup_ns_ * 1.0e-3;}
+
+  /// Find the LCO address for a given index and a given operation
+  ///
+  /// This requires the index of the LCOs to be built; see index_lcos(). The
+  /// LCO must be on this rank.
+  ///
+  /// \param idx - the Index of the node in question
+  /// \param op - the edge type connecting to the index in question
+  ///
+  /// \returns - global address of the LCO serving as target of the edge
+  hpx_addr_t lookup_lco_addx(Index idx, Operation op) {
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t lookup_begin = hpx_time_now();
+#endif
+    int kind{kNormalLCO};
+    switch (op) {
+      case Operation::Nop:
+        assert(0 && "problem in lookup");
+        break;
+      case Operation::StoM:  // NOTE: fallthrough here
+      case Operation::StoL:
+      case Operation::MtoM:
+      case Operation::MtoL:
+      case Operation::LtoL:
+        kind = kNormalLCO;
+        break;
+      case Operation::MtoT: // NOTE: fallthrough here
+      case Operation::LtoT:
+      case Operation::StoT:
+        kind = kPartsLCO;
+        break;
+      case Operation::MtoI: // NOTE: fallthrough
+      case Operation::ItoI:
+        kind = kIntermLCO;
+        break;
+      case Operation::ItoL:
+        kind = kNormalLCO;
+        break;
+    }
+
+    auto found = lco_index_[kind].find(idx);
+    assert(found != lco_index_[kind].end());
+    hpx_addr_t retval = found->second;
+
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t lookup_end = hpx_time_now();
+    n_lookups_ += 1;
+    lookup_ns_ += (uint64_t)hpx_time_diff_ns(lookup_begin, lookup_end);
+#endif
+
+    return retval;
+  }
+
+
+ protected:
+  node_t *root_;            /// Root of the tree
+  node_t *unif_grid_;       /// The uniform grid
+  hpx_addr_t unif_done_;    /// An LCO indicating that the uniform partition is
+                            /// complete
+  arrayref_t sorted_;       /// A reference to the sorted point data owned by
+                            /// this tree.
+  arena_t arena_;           /// The nodes below the uniform level
+  std::vector<int> leaf_limit_;  /// most records in a leaf of each branch
+  std::vector<std::vector<record_t>> outgoing_;  /// records leaving each
+                                                 /// uniform node in an update
+  std::vector<std::vector<record_t>> incoming_;  /// records arriving at each
+                                                 /// uniform node in an update
+  std::vector<FlatNode> flat_;        /// the frozen tree in level order
+  std::vector<node_t *> flat_nodes_;  /// the Node for each frozen node
+  std::vector<int> level_first_;      /// first frozen node of each level
+
+  /// The kinds of LCO a node can have
+  enum LCOKind {
+    kNormalLCO = 0,
+    kPartsLCO = 1,
+    kIntermLCO = 2,
+    kLCOKinds = 3
+  };
+
+  /// The LCOs of each kind on this rank, by the Index of their node. The
+  /// whole Index is the key, as the tree has no depth limit unless it is
+  /// partitioned by Morton keys.
+  std::unordered_map<Index, hpx_addr_t, IndexHash> lco_index_[kLCOKinds];
+  std::atomic<size_t> n_lookups_;     /// lookups since the index was built
+  std::atomic<uint64_t> lookup_ns_;   /// time spent in those lookups
+};
+
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+// Tree needs a DualTree forward declaration
+template <typename Source, typename Target,
+          template <typename, typename> class Expansion,
+          template <typename, typename,
+                    template <typename, typename> class> class Method>
+class DualTree;
+
+
+/// The tree class represents one of the trees in a given evaluation
+///
+/// The Tree is a template over the typical DASHMM types, as well as a
+/// Record type that indicates if this is a Source tree or a Target tree.
+///
+/// The nodes are arranged in a hybrid way in this tree. The top of the tree
+/// (up to and including the finest uniform level) are allocated in an array.
+/// The branches below the uniform level, both those owned by this rank and
+/// those received from remotes, are allocated one node at a time from an
+/// Arena owned by the tree, which releases them all at once when the tree is
+/// deleted.
+template <typename Source, typename Target, typename Record,
+          template <typename, typename> class Expansion,
+          template <typename, typename,
+                    template <typename, typename> class> class Method>
+class Tree : public TreeData<Record> {
+ public:
+  using record_t = Record;
+  using node_t = Node<Record>;
+  using sourcenode_t = Node<Source>;
+  using targetnode_t = Node<Target>;
+  using arrayref_t = ArrayRef<Record>;
+  using arena_t = Arena<node_t>;
+  using tree_t = Tree<Source, Target, Record, Expansion, Method>;
+  using sourcetree_t = Tree<Source, Target, Source, Expansion, Method>;
+  using dualtree_t = DualTree<Source, Target, Expansion, Method>;
+
+  /// Tree construction just default initializes the object
+  Tree() : TreeData<Record>{} { }
+
+  /// Setup some basic information during initial tree construction
+  ///
+  /// This action is the target of a broadcast. The basic information about
+  /// the tree is set up in this action. The most important of which is the
+  /// allocation of the top portions of the tree containing the root, and
+  /// extending to the finest uniform level of partitioning.
+  ///
+  /// \param tree - the address of the tree on which to act
+  /// \param unif_level - the uniform partitioning level
+  static int setup_basics_handler(tree_t *tree, int unif_level) {
+    tree->unif_done_ = hpx_lco_and_new(1);
+    assert(tree->unif_done_ != HPX_NULL);
+
+    // Setup unif_grid
+    int n_top_nodes = top_node_count(unif_level);
+    int dim3 = pow(8, unif_level);
+    tree->root_ = new node_t[n_top_nodes + dim3]{};
+    tree->unif_grid_ = &tree->root_[n_top_nodes];
+
+    tree->root_[0].idx = Index{0, 0, 0, 0};
+    tree->link_top_nodes(unif_level);
+    for (int i = 0; i < dim3; ++i) {
+      tree->unif_grid_[i].add_lock();
+      tree->unif_grid_[i].add_completion();
+    }
+
+    return HPX_SUCCESS;
+  }
+
+  /// Return the number of nodes above the uniform level
+  ///
+  /// \param unif_level - the uniform partitioning level
+  static int top_node_count(int unif_level) {
+    int retval{1};
+    for (int i = 1; i < unif_level; ++i) {
+      retval += pow(8, i);
+    }
+    return retval;
+  }
+
+  /// Link the nodes of the tree down to the uniform level
+  ///
+  /// This sets the index, the parent and the children of every node above
+  /// the uniform level, and the index and the parent of the uniform grid
+  /// nodes. This undoes any pruning of the top of the tree.
+  ///
+  /// \param unif_level - the uniform partitioning level
+  void link_top_nodes(int unif_level) {
+    int startingnode{0};
+    int stoppingnode{1};
+    for (int level = 0; level < unif_level ; ++level) {
+      for (int nd = startingnode; nd < stoppingnode; ++nd) {
+        node_t *snode = &root_[nd];
+
+        if (level != unif_level - 1) {
+          // At the lower levels, we do not require the ordering
+          int firstchild = nd * 8 + 1;
+          for (int i = 0; i < 8; ++i) {
+            node_t *scnode = &root_[firstchild + i];
             snode->child[i] = scnode;
             scnode->idx = snode->idx.child(i);
             scnode->dag.set_index(snode->idx.child(i));
@@ -590,12 +1523,10 @@ class Tree {
           for (int i = 0; i < 8; ++i) {
             Index cindex = snode->idx.child(i);
             uint64_t morton = morton_key(cindex.x(), cindex.y(), cindex.z());
-            snode->child[i] = &tree->unif_grid_[morton];
-            tree->unif_grid_[morton].idx = cindex;
-            tree->unif_grid_[morton].dag.set_index(cindex);
-            tree->unif_grid_[morton].parent = snode;
-            tree->unif_grid_[morton].add_lock();
-            tree->unif_grid_[morton].add_completion();
+            snode->child[i] = &unif_grid_[morton];
+            unif_grid_[morton].idx = cindex;
+            unif_grid_[morton].dag.set_index(cindex);
+            unif_grid_[morton].parent = snode;
           }
         }
       }
@@ -603,68 +1534,204 @@ class Tree {
       startingnode += pow(8, level);
       stoppingnode += pow(8, level + 1);
     }
+  }
 
-    return HPX_SUCCESS;
+  /// Count the nodes of this tree on this rank for the tree statistics
+  ///
+  /// The branches below the uniform grid nodes owned by this rank are
+  /// counted. The nodes above the uniform level are the same on every rank,
+  /// so they are only counted if @p top is true.
+  ///
+  /// \param unif_level - the uniform partitioning level
+  /// \param first - the first uniform grid node owned by this rank
+  /// \param last - the last uniform grid node owned by this rank
+  /// \param top - should the nodes above the uniform level be counted
+  /// \param data [out] - the buffer of statistics for this tree; see
+  ///                     TreeShape
+  ///
+  /// \returns - the number of nodes in the branches owned by this rank
+  size_t count_nodes(int unif_level, int first, int last, bool top,
+                     size_t *data) const {
+    std::vector<const node_t *> V{};
+    if (top && unif_level > 0) {
+      V.push_back(root_);
+      while (!V.empty()) {
+        const node_t *curr = V.back();
+        V.pop_back();
+        TreeShape::count_node(data, curr->idx.level(), curr->is_leaf(),
+                              curr->num_parts());
+        if (curr->idx.level() + 1 < unif_level) {
+          for (int i = 0; i < 8; ++i) {
+            if (curr->child[i]) {
+              V.push_back(curr->child[i]);
+            }
+          }
+        }
+      }
+    }
+
+    size_t retval{0};
+    for (int i = first; i <= last; ++i) {
+      if (unif_grid_[i].is_leaf() && unif_grid_[i].num_parts() == 0) {
+        continue;
+      }
+      V.push_back(&unif_grid_[i]);
+      while (!V.empty()) {
+        const node_t *curr = V.back();
+        V.pop_back();
+        TreeShape::count_node(data, curr->idx.level(), curr->is_leaf(),
+                              curr->num_parts());
+        ++retval;
+        for (int j = 0; j < 8; ++j) {
+          if (curr->child[j]) {
+            V.push_back(curr->child[j]);
+          }
+        }
+      }
+    }
+
+    return retval;
   }
 
   /// Destroy allocated data for this tree.
   ///
-  /// This will delete the local branches of the tree as well as destroying
-  /// any locks allocated for the uniform grid, and will free the remote
-  /// branches.
+  /// This will delete the branches of the tree as well as destroying
+  /// any locks allocated for the uniform grid.
   ///
   /// \param tree - the tree on which to act
   /// \param ndim - the size of the uniform grid
   /// \param first - the first owned node of the uniform grid
   /// \param last - the last (inclusive) owned node of the uniform grid
   static int delete_tree_handler(tree_t *tree, int ndim, int first, int last) {
-    // NOTE: The difference here is that there are two different allocation
-    // schemes for the nodes.
-
-    for (int i = 0; i < first; ++i) {
+    for (int i = 0; i < ndim; ++i) {
       node_t *curr = &tree->unif_grid_[i];
       curr->delete_lock();
 
-      for (int j = 0; j < 8; ++j) {
-        node_t *child = curr->child[j];
-        if (child) {
-          delete [] child;
-          break;
-        }
+      // The completion LCOs of the remote nodes are deleted as the partition
+      // finishes.
+      if (i >= first && i <= last) {
+        hpx_lco_delete_sync(curr->complete());
       }
     }
 
-    for (int i = first; i <= last; ++i) {
-      node_t *curr = &tree->unif_grid_[i];
-      curr->delete_lock();
+    // All nodes below the uniform level come from the arena
+    tree->arena_.release();
 
-      for (int j = 0; j < 8; ++j) {
-        if (curr->child[j]) {
-          node_t::destroy_branch(curr->child[j]);
-        }
-      }
+    delete [] tree->root_;
 
-      hpx_lco_delete_sync(curr->complete());
-    }
+    hpx_lco_delete_sync(tree->unif_done_);
 
-    for (int i = last + 1; i < ndim; ++i) {
-      node_t *curr = &tree->unif_grid_[i];
-      curr->delete_lock();
+    return HPX_SUCCESS;
+  }
 
-      for (int j = 0; j < 8; ++j) {
-        node_t *child = curr->child[j];
-        if (child) {
-          delete [] child;
-          break;
-        }
-      }
+  /// Return the number of chunks into which binning work is split
+  ///
+  /// The records are divided into contiguous chunks, one per worker thread,
+  /// unless there are too few records for that to be worthwhile.
+  ///
+  /// \param npts - the number of records
+  ///
+  /// \returns - the number of chunks to use
+  static int unif_grid_chunks(size_t npts) {
+    // Below this many records per chunk, the cost of the per-chunk histograms
+    // and the extra actions outweighs the benefit.
+    size_t min_chunk_size = 4096;
+    size_t n_chunks = std::min((size_t)hpx_get_num_threads(),
+                               npts / min_chunk_size);
+    return std::max((int)n_chunks, 1);
+  }
+
+  /// Return the first record of a given chunk
+  ///
+  /// \param npts - the number of records
+  /// \param n_chunks - the number of chunks
+  /// \param chunk - the chunk in question
+  ///
+  /// \returns - the index of the first record in @p chunk
+  static size_t unif_grid_chunk_begin(size_t npts, int n_chunks, int chunk) {
+    return (npts * chunk) / n_chunks;
+  }
+
+  /// Compute the bounding box of a chunk of records
+  ///
+  /// The extent in each direction is reduced in a separate variable with a
+  /// plain comparison, rather than with fmin and fmax, which must handle NaN,
+  /// so that each comparison compiles to a branchless minimum or maximum. The
+  /// loop is still not vectorized, as the positions are strided within the
+  /// records.
+  ///
+  /// \param P - the records
+  /// \param npts - the number of records
+  /// \param var [out] - the box as (xmin, xmax, ymin, ymax, zmin, zmax)
+  ///
+  /// \returns - HPX_SUCCESS
+  static int bounding_box_handler(const record_t *P, size_t npts,
+                                  double *var) {
+    double xmin{1e50};
+    double xmax{-1e50};
+    double ymin{1e50};
+    double ymax{-1e50};
+    double zmin{1e50};
+    double zmax{-1e50};
+    for (size_t i = 0; i < npts; ++i) {
+      double x = P[i].position.x();
+      double y = P[i].position.y();
+      double z = P[i].position.z();
+      xmin = x < xmin ? x : xmin;
+      xmax = x > xmax ? x : xmax;
+      ymin = y < ymin ? y : ymin;
+      ymax = y > ymax ? y : ymax;
+      zmin = z < zmin ? z : zmin;
+      zmax = z > zmax ? z : zmax;
     }
+    var[0] = xmin;
+    var[1] = xmax;
+    var[2] = ymin;
+    var[3] = ymax;
+    var[4] = zmin;
+    var[5] = zmax;
+    return HPX_SUCCESS;
+  }
 
-    delete [] tree->root_;
+  /// Extend a bounding box to contain the given records
+  ///
+  /// The records are split into the same chunks as for the uniform grid
+  /// binning, and the box of each chunk is computed in parallel.
+  ///
+  /// This is a synchronous operation.
+  ///
+  /// \param P - the records
+  /// \param npts - the number of records
+  /// \param var [in,out] - the box as (xmin, xmax, ymin, ymax, zmin, zmax)
+  static void extend_bounding_box(const record_t *P, size_t npts,
+                                  double *var) {
+    if (npts == 0) {
+      return;
+    }
 
-    hpx_lco_delete_sync(tree->unif_done_);
+    int n_chunks = unif_grid_chunks(npts);
+    std::vector<double> chunk_var(6 * n_chunks);
 
-    return HPX_SUCCESS;
+    hpx_addr_t done = hpx_lco_and_new(n_chunks);
+    assert(done != HPX_NULL);
+    for (int c = 0; c < n_chunks; ++c) {
+      size_t b = unif_grid_chunk_begin(npts, n_chunks, c);
+      size_t e = unif_grid_chunk_begin(npts, n_chunks, c + 1);
+      size_t n_chunk = e - b;
+      const record_t *P_chunk = &P[b];
+      double *var_chunk = &chunk_var[6 * c];
+      hpx_call(HPX_HERE, bounding_box_, done, &P_chunk, &n_chunk, &var_chunk);
+    }
+    hpx_lco_wait(done);
+    hpx_lco_delete_sync(done);
+
+    for (int c = 0; c < n_chunks; ++c) {
+      const double *var_chunk = &chunk_var[6 * c];
+      for (int i = 0; i < 6; i += 2) {
+        var[i] = std::min(var[i], var_chunk[i]);
+        var[i + 1] = std::max(var[i + 1], var_chunk[i + 1]);
+      }
+    }
   }
 
   /// Assign points to the uniform grid.
@@ -675,6 +1742,9 @@ class Tree {
   /// computing the distribution of the sources and targets during tree
   /// construction.
   ///
+  /// This operates on one chunk of the local records; each chunk is given its
+  /// own histogram in @p count so that the chunks can proceed in parallel.
+  ///
   /// \param P - the records
   /// \param npts - the number of records
   /// \param geo - the overall domain geometry
@@ -706,80 +1776,136 @@ class Tree {
     return HPX_SUCCESS;
   }
 
-  /// Reorder the particles according to their place in the uniform grid
+  /// Count the records in each uniform grid node
   ///
-  /// This will rearrange the particles into their bin order. This is a stable
-  /// reordering.
+  /// This splits the records into chunks and assigns each chunk to the
+  /// uniform grid in parallel. The per-chunk histograms are left in
+  /// @p chunk_count for use by group_points_on_unif_grid(), and their sum is
+  /// accumulated into @p count.
   ///
-  /// This routine is adapted from a routine in the publicly available code
-  /// GADGET-2 (http://wwwmpa.mpa-garching.mpg.de/gadget/).
+  /// This is a synchronous operation.
   ///
-  /// \param p_in - the input records; will be sorted
+  /// \param P - the records
   /// \param npts - the number of records
+  /// \param geo - the overall domain geometry
+  /// \param unif_level - the uniform partitioning level
   /// \param dim3 - the size of the uniform grid
-  /// \param gid_of_points - the morton key for the records
-  /// \param count - the number of records per bin
-  /// \param retval [out] - offsets into the record list for each
-  ///
-  /// \returns - HPX_SUCCESS
-  static int *group_points_on_unif_grid(record_t *p_in, int npts,
-                                        int dim3, int *gid_of_points,
-                                        const int *count, int **retval) {
-    int *offset = new int[dim3]();
+  /// \param gid [out] - the morton key for each record
+  /// \param chunk_count [out] - the per chunk counts; this must have space
+  ///                            for unif_grid_chunks(npts) * dim3 values,
+  ///                            which must be zero on input
+  /// \param count [out] - the number of points per uniform grid node
+  static void count_points_on_unif_grid(const record_t *P, int npts,
+                                        const DomainGeometry *geo,
+                                        int unif_level, int dim3, int *gid,
+                                        int *chunk_count, int *count) {
+    int n_chunks = unif_grid_chunks(npts);
 
-    offset[0] = 0;
-    for (int i = 1; i < dim3; ++i) {
-      offset[i] = offset[i - 1] + count[i - 1];
+    hpx_addr_t done = hpx_lco_and_new(n_chunks);
+    assert(done != HPX_NULL);
+    for (int c = 0; c < n_chunks; ++c) {
+      int b = unif_grid_chunk_begin(npts, n_chunks, c);
+      int e = unif_grid_chunk_begin(npts, n_chunks, c + 1);
+      int n_chunk = e - b;
+      const record_t *P_chunk = &P[b];
+      int *gid_chunk = &gid[b];
+      int *count_chunk = &chunk_count[c * dim3];
+      hpx_call(HPX_HERE, assign_points_, done, &P_chunk, &n_chunk, &geo,
+               &unif_level, &gid_chunk, &count_chunk);
     }
+    hpx_lco_wait(done);
+    hpx_lco_delete_sync(done);
 
-    // Set gid to the final location of the particle; NOTE: this will modify
-    // the offset. This is corrected below
-    for (int i = 0; i < npts; ++i) {
-      int gid = gid_of_points[i];
-      gid_of_points[i] = offset[gid];
-      offset[gid]++;
+    for (int c = 0; c < n_chunks; ++c) {
+      const int *count_chunk = &chunk_count[c * dim3];
+      for (int i = 0; i < dim3; ++i) {
+        count[i] += count_chunk[i];
+      }
     }
+  }
 
-    // Declare some loop variables
-    record_t source, save;
-    int source_sort, save_sort;
-    int isource, isave, idest;
-
-    // Do an O(N) rearrangement
+  /// Scatter a chunk of records into their bin order
+  ///
+  /// \param p_in - the input records for this chunk
+  /// \param npts - the number of records in this chunk
+  /// \param gid - the morton key for the records in this chunk
+  /// \param offset - the location in @p p_out of the next record of this
+  ///                 chunk in each uniform grid node; this will be modified
+  /// \param p_out - the output records
+  ///
+  /// \returns - HPX_SUCCESS
+  static int scatter_points_handler(const record_t *p_in, int npts,
+                                    const int *gid, int *offset,
+                                    record_t *p_out) {
     for (int i = 0; i < npts; ++i) {
-      if (gid_of_points[i] != i) {
-        source = p_in[i];
-        source_sort = gid_of_points[i];
-        isource = gid_of_points[i];
-        idest = gid_of_points[i];
-
-        do {
-          save = p_in[idest];
-          save_sort = gid_of_points[idest];
-          isave = gid_of_points[idest];
-
-          p_in[idest] = source;
-          gid_of_points[idest] = source_sort;
+      p_out[offset[gid[i]]++] = p_in[i];
+    }
+    return HPX_SUCCESS;
+  }
 
-          if (idest == i) break;
+  /// Reorder the particles according to their place in the uniform grid
+  ///
+  /// This will copy the particles into @p p_out in their bin order. This is a
+  /// stable reordering.
+  ///
+  /// This is a parallel counting sort. Using the per-chunk counts computed by
+  /// count_points_on_unif_grid(), each chunk is given a private set of output
+  /// locations in each bin. The chunks are then scattered in parallel directly
+  /// into @p p_out. Because the chunks are contiguous and are given output
+  /// locations in order, the result is the same as a serial stable sort.
+  ///
+  /// This is a synchronous operation.
+  ///
+  /// \param p_in - the input records
+  /// \param npts - the number of records
+  /// \param dim3 - the size of the uniform grid
+  /// \param gid_of_points - the morton key for the records
+  /// \param count - the number of records per bin
+  /// \param chunk_count - the per chunk counts; will be overwritten
+  /// \param retval [out] - offsets into the record list for each
+  /// \param p_out [out] - the sorted records; must have space for @p npts
+  ///                      records
+  static void group_points_on_unif_grid(const record_t *p_in, int npts,
+                                        int dim3, const int *gid_of_points,
+                                        const int *count, int *chunk_count,
+                                        int **retval, record_t *p_out) {
+    int *offset = new int[dim3]();
 
-          source = save;
-          source_sort = save_sort;
-          isource = isave;
+    offset[0] = 0;
+    for (int i = 1; i < dim3; ++i) {
+      offset[i] = offset[i - 1] + count[i - 1];
+    }
+    *retval = offset;
 
-          idest = isource;
-        } while (1);
-      }
+    if (npts == 0) {
+      return;
     }
 
-    // Correct offset
+    // Turn the per chunk counts into the per chunk offsets
+    int n_chunks = unif_grid_chunks(npts);
     for (int i = 0; i < dim3; ++i) {
-      offset[i] -= count[i];
+      int curr = offset[i];
+      for (int c = 0; c < n_chunks; ++c) {
+        int incr = chunk_count[c * dim3 + i];
+        chunk_count[c * dim3 + i] = curr;
+        curr += incr;
+      }
     }
 
-    *retval = offset;
-
-    return HPX_SUCCESS;
+    hpx_addr_t done = hpx_lco_and_new(n_chunks);
+    assert(done != HPX_NULL);
+    for (int c = 0; c < n_chunks; ++c) {
+      int b = unif_grid_chunk_begin(npts, n_chunks, c);
+      int e = unif_grid_chunk_begin(npts, n_chunks, c + 1);
+      int n_chunk = e - b;
+      const record_t *p_chunk = &p_in[b];
+      const int *gid_chunk = &gid_of_points[b];
+      int *offset_chunk = &chunk_count[c * dim3];
+      hpx_call(HPX_HERE, scatter_points_, done, &p_chunk, &n_chunk,
+               &gid_chunk, &offset_chunk, &p_out);
+    }
+    hpx_lco_wait(done);
+    hpx_lco_delete_sync(done);
   }
 
   /// Receive partitioned tree nodes from a remote locality
@@ -788,7 +1914,7 @@ class Tree {
   /// of the tree, and then expands it into node objects, connectint it to
   /// the correct portion of the tree at this locality. In general, there will
   /// be one such message per uniform grid node not owned by this locality, per
-  /// tree.
+  /// tree. Any branch left from before an update is removed first.
   ///
   /// \param message_buffer - the message
   /// \param UNUSED - the size of the buffer
@@ -808,21 +1934,25 @@ class Tree {
     // something better for this.
     if (type == 0) {
       Node<Source> *grid = local_tree->unif_grid_source();
+      grid[id].clear_branch(local_tree->source_arena());
 
       if (n_nodes) {
         const int *branch = &compressed_tree[3];
         const int *tree = &compressed_tree[3 + n_nodes];
-        grid[id].extract(branch, tree, n_nodes);
+        grid[id].extract(branch, tree, n_nodes,
+                         local_tree->source_arena());
       }
 
       hpx_lco_and_set_num(grid[id].complete(), 8, HPX_NULL);
     } else {
       Node<Target> *grid = local_tree->unif_grid_target();
+      grid[id].clear_branch(local_tree->target_arena());
 
       if (n_nodes) {
         const int *branch = &compressed_tree[3];
         const int *tree = &compressed_tree[3 + n_nodes];
-        grid[id].extract(branch, tree, n_nodes);
+        grid[id].extract(branch, tree, n_nodes,
+                         local_tree->target_arena());
       }
 
       hpx_lco_and_set_num(grid[id].complete(), 8, HPX_NULL);
@@ -901,7 +2031,6 @@ class Tree {
   /// \param local_offset - where in the local data are the points for each node
   ///                       of the uniform grid
   /// \param geo - the domain geometry for the tree
-  /// \param threshold - the partitioning threshold for the tree
   /// \param temp - the local point data
   /// \param n - the uniform grid nodes
   ///
@@ -912,7 +2041,6 @@ class Tree {
                                   const int *local_count,
                                   const int *local_offset,
                                   const DomainGeometry *geo,
-                                  int threshold,
                                   const record_t *temp,
                                   node_t *n) {
     int range = last - first + 1;
@@ -949,9 +2077,11 @@ class Tree {
             if (curr->increment_first(local_count[i])) {
               // This grid does not expect remote points.
               // Spawn adaptive partitioning
+              int threshold = tree->leaf_limit(i);
               int ssat = 0;
+              arena_t *arena = &tree->arena_;
               hpx_call(HPX_HERE, node_t::partition_node_, HPX_NULL,
-                       &curr, &geo, &threshold, &ssat);
+                       &curr, &geo, &threshold, &ssat, &arena);
             }
             curr->unlock();
           }
@@ -980,7 +2110,6 @@ class Tree {
   /// \param local_offset - where in the local data are the points for each node
   ///                       of the uniform grid
   /// \param geo - the domain geometry for the tree
-  /// \param threshold - the partitioning threshold for the tree
   /// \param temp - the local point data
   /// \param n - the uniform grid nodes
   /// \param snodes - the source nodes in the uniform grid
@@ -988,7 +2117,7 @@ class Tree {
   static void init_point_exchange_same_s_and_t(
       tree_t *tree, int first, int last, const int *global_count,
       const int *local_count, const int *local_offset,
-      const DomainGeometry *geo, int threshold, const record_t *temp,
+      const DomainGeometry *geo, const record_t *temp,
       node_t *n, sourcenode_t *snodes, sourcetree_t *source_tree) {
     int range = last - first + 1;
 
@@ -1019,10 +2148,12 @@ class Tree {
             if (curr->increment_first(local_count[i])) {
               // This grid does not expect remote points.
               // Spawn adaptive partitioning
+              int threshold = tree->leaf_limit(i);
               int ssat = 1;
+              arena_t *arena = &tree->arena_;
               hpx_call_when(curr_source->complete(), HPX_HERE,
                             node_t::partition_node_, HPX_NULL,
-                            &curr, &geo, &threshold, &ssat);
+                            &curr, &geo, &threshold, &ssat, &arena);
             }
             curr->unlock();
           }
@@ -1047,10 +2178,11 @@ class Tree {
   /// \param n - the uniform grid node
   /// \param n_arrived - the number arriving in this message
   /// \param rwgas - the address of the rankwise dual tree
+  /// \param tree - the tree containing @p n
   ///
   /// \returns - HPX_SUCCESS
   static int merge_points_handler(record_t *temp, node_t *n, int n_arrived,
-                                  hpx_addr_t rwgas) {
+                                  hpx_addr_t rwgas, tree_t *tree) {
     RankWise<dualtree_t> global_tree{rwgas};
     auto local_tree = global_tree.here();
 
@@ -1062,10 +2194,50 @@ class Tree {
 
     if (n->increment_first(n_arrived)) {
       const DomainGeometry *geoarg = local_tree->domain();
-      int thresh = local_tree->refinement_limit();
+      int thresh = tree->leaf_limit(
+          get_unif_grid_index(n->idx, local_tree->unif_level()));
+      int ssat = 0;
+      arena_t *arena = &tree->arena_;
+      hpx_call(HPX_HERE, node_t::partition_node_, HPX_NULL,
+               &n, &geoarg, &thresh, &ssat, &arena);
+    }
+    n->unlock();
+
+    return HPX_SUCCESS;
+  }
+
+  /// Pull incoming points into the local array
+  ///
+  /// This action is the zero-copy counterpart of merge_points_. The points are
+  /// read directly from the global address space of the rank that grouped
+  /// them into the space reserved for them in the sorted list. As with
+  /// merge_points_, the last arrival starts the adaptive partitioning.
+  ///
+  /// \param from - the global address of the incoming points
+  /// \param n - the uniform grid node
+  /// \param n_arrived - the number of points to pull
+  /// \param rwgas - the address of the rankwise dual tree
+  /// \param tree - the tree containing @p n
+  ///
+  /// \returns - HPX_SUCCESS
+  static int pull_points_handler(hpx_addr_t from, node_t *n, int n_arrived,
+                                 hpx_addr_t rwgas, tree_t *tree) {
+    RankWise<dualtree_t> global_tree{rwgas};
+    auto local_tree = global_tree.here();
+
+    n->lock();
+    size_t first = n->first();
+    record_t *p = n->parts.data();
+    hpx_gas_memget_sync(p + first, from, sizeof(record_t) * n_arrived);
+
+    if (n->increment_first(n_arrived)) {
+      const DomainGeometry *geoarg = local_tree->domain();
+      int thresh = tree->leaf_limit(
+          get_unif_grid_index(n->idx, local_tree->unif_level()));
       int ssat = 0;
+      arena_t *arena = &tree->arena_;
       hpx_call(HPX_HERE, node_t::partition_node_, HPX_NULL,
-               &n, &geoarg, &thresh, &ssat);
+               &n, &geoarg, &thresh, &ssat, &arena);
     }
     n->unlock();
 
@@ -1080,47 +2252,144 @@ class Tree {
   /// calls to partitioning when appropriate. Note, this is now a call when
   /// waiting on the completion of the partitioning in the source tree.
   ///
-  /// \param temp - the local data
-  /// \param n - the uniform grid node
+  /// \param target_node - the uniform grid node
   /// \param n_arrived - the number arriving in this message
+  /// \param source_node - the equivalent uniform grid node of the source tree
   /// \param rwgas - the address of the rankwise dual tree
+  /// \param tree - the tree containing @p target_node
   ///
   /// \returns - HPX_SUCCESS
   static int merge_points_same_s_and_t_handler(targetnode_t *target_node,
-      int n_arrived, sourcenode_t *source_node, hpx_addr_t rwgas) {
+      int n_arrived, sourcenode_t *source_node, hpx_addr_t rwgas,
+      tree_t *tree) {
     RankWise<dualtree_t> global_tree{rwgas};
     auto local_tree = global_tree.here();
 
     target_node->lock();
     if (target_node->increment_first(n_arrived)) {
       const DomainGeometry *geoarg = local_tree->domain();
-      int thresh = local_tree->refinement_limit();
+      int thresh = tree->leaf_limit(
+          get_unif_grid_index(target_node->idx, local_tree->unif_level()));
       int ssat = 1;
+      arena_t *arena = &tree->arena_;
       hpx_call_when(source_node->complete(),
                     HPX_HERE, node_t::partition_node_, HPX_NULL,
-                    &target_node, &geoarg, &thresh, &ssat);
+                    &target_node, &geoarg, &thresh, &ssat, &arena);
     }
     target_node->unlock();
 
     return HPX_SUCCESS;
   }
 
-  /// Split the bits of an integer to be used in a Morton Key
-  static uint64_t split(unsigned k) {
-    uint64_t split = k & 0x1fffff;
-    split = (split | split << 32) & 0x1f00000000ffff;
-    split = (split | split << 16) & 0x1f0000ff0000ff;
-    split = (split | split << 8)  & 0x100f00f00f00f00f;
-    split = (split | split << 4)  & 0x10c30c30c30c30c3;
-    split = (split | split << 2)  & 0x1249249249249249;
-    return split;
+  /// Prepare the tree for an update
+  ///
+  /// This makes room for the records leaving and arriving at each node of
+  /// the uniform grid. This must occur before any records can arrive from
+  /// other ranks.
+  ///
+  /// \param dim3 - the size of the uniform grid
+  void begin_update(int dim3) {
+    outgoing_.resize(dim3);
+    incoming_.resize(dim3);
+  }
+
+  /// Release the storage used during an update
+  void end_update() {
+    outgoing_.clear();
+    incoming_.clear();
+  }
+
+  /// Return the records that left the given uniform grid node
+  const std::vector<record_t> &outgoing(int id) const {return outgoing_[id];}
+
+  /// Return the number of records arriving at the given uniform grid node
+  size_t n_incoming(int id) const {return incoming_[id].size();}
+
+  /// Add records to those arriving at uniform grid nodes
+  ///
+  /// The records are given with the uniform grid node containing each, and
+  /// are grouped by that node.
+  ///
+  /// \param ids - the uniform grid node for each record
+  /// \param records - the records; this need not be aligned
+  /// \param n - the number of records
+  void accept_movers(const int *ids, const char *records, int n) {
+    int begin = 0;
+    while (begin < n) {
+      int end = begin + 1;
+      while (end < n && ids[end] == ids[begin]) {
+        ++end;
+      }
+
+      node_t *curr = &unif_grid_[ids[begin]];
+      curr->lock();
+      std::vector<record_t> &dest = incoming_[ids[begin]];
+      size_t old_size = dest.size();
+      dest.resize(old_size + end - begin);
+      memcpy(&dest[old_size], records + sizeof(record_t) * begin,
+             sizeof(record_t) * (end - begin));
+      curr->unlock();
+
+      begin = end;
+    }
+  }
+
+  /// Action to find the records that have left their leaves
+  ///
+  /// \param tree - the tree
+  /// \param id - the uniform grid node to examine
+  /// \param geo - the domain geometry
+  ///
+  /// \returns - HPX_SUCCESS
+  static int collect_movers_handler(tree_t *tree, int id,
+                                    const DomainGeometry *geo) {
+    tree->outgoing_[id].clear();
+    tree->unif_grid_[id].collect_movers(geo, &tree->outgoing_[id]);
+    return HPX_SUCCESS;
   }
 
-  /// Compute the Morton key for a gives set of indices
-  static uint64_t morton_key(unsigned x, unsigned y, unsigned z) {
-    uint64_t key = 0;
-    key |= split(x) | split(y) << 1 | split(z) << 2;
-    return key;
+  /// Action to rebuild a branch once the moving records have arrived
+  ///
+  /// If no record has left or entered the node, the branch is kept, and its
+  /// records are only copied if @p dest is a new location. If @p dest is the
+  /// current location of the records, the branch is rebuilt into scratch
+  /// space and copied back.
+  ///
+  /// \param tree - the tree
+  /// \param id - the uniform grid node to rebuild
+  /// \param geo - the domain geometry
+  /// \param threshold - the partitioning threshold
+  /// \param dest - the new location of the records of the node
+  /// \param n - the new number of records of the node
+  ///
+  /// \returns - HPX_SUCCESS
+  static int rebuild_branch_handler(tree_t *tree, int id,
+                                    const DomainGeometry *geo, int threshold,
+                                    record_t *dest, size_t n) {
+    node_t *curr = &tree->unif_grid_[id];
+    const std::vector<record_t> &incoming = tree->incoming_[id];
+    record_t *old = curr->parts.data();
+
+    if (tree->outgoing_[id].empty() && incoming.empty()) {
+      if (n && dest != old) {
+        memcpy(dest, old, sizeof(record_t) * n);
+        curr->rebase_branch(old, dest);
+      }
+    } else if (dest == old) {
+      record_t *scratch = reinterpret_cast<record_t *>(
+                              new char[sizeof(record_t) * n]);
+      curr->rebuild_branch(incoming, arrayref_t{scratch, n}, geo, threshold,
+                           &tree->arena_);
+      memcpy(dest, scratch, sizeof(record_t) * n);
+      curr->rebase_branch(scratch, dest);
+      delete [] reinterpret_cast<char *>(scratch);
+    } else {
+      curr->rebuild_branch(incoming, arrayref_t{dest, n}, geo, threshold,
+                           &tree->arena_);
+    }
+
+    tree->incoming_[id] = std::vector<record_t>{};
+    return HPX_SUCCESS;
   }
 
   /// Compute the uniform grid index for a given Index
@@ -1145,81 +2414,30 @@ class Tree {
     }
   }
 
-  /// Find the LCO address for a given index and a given operation
-  ///
-  /// \param idx - the Index of the node in question
-  /// \param op - the edge type connecting to the index in question
-  ///
-  /// \returns - global address of the LCO serving as target of the edge
-  hpx_addr_t lookup_lco_addx(Index idx, Operation op) {
-    // This should walk to the node containing the LCO we care about
-    node_t *curr = root_;
-    bool not_found = true;
-    while (not_found) {
-      int dlevel = idx.level() - curr->idx.level();
-      assert(dlevel >= 0);
-      if (dlevel == 0) {
-        break;
-      }
-      assert(curr->idx == idx.parent(dlevel));
-      int which = idx.parent(dlevel - 1).which_child();
-      curr = curr->child[which];
-    }
-    assert(curr->idx == idx);
-
-    hpx_addr_t retval{HPX_NULL};
-    switch (op) {
-      case Operation::Nop:
-        assert(0 && "problem in lookup");
-        break;
-      case Operation::StoM:  // NOTE: fallthrough here
-      case Operation::StoL:
-      case Operation::MtoM:
-      case Operation::MtoL:
-      case Operation::LtoL:
-        assert(curr->dag.has_normal());
-        retval = curr->dag.normal()->global_addx;
-        break;
-      case Operation::MtoT: // NOTE: fallthrough here
-      case Operation::LtoT:
-      case Operation::StoT:
-        assert(curr->dag.has_parts());
-        retval = curr->dag.parts()->global_addx;
-        break;
-      case Operation::MtoI: // NOTE: fallthrough
-      case Operation::ItoI:
-        assert(curr->dag.has_interm());
-        retval = curr->dag.interm()->global_addx;
-        break;
-      case Operation::ItoL:
-        assert(curr->dag.has_normal());
-        retval = curr->dag.normal()->global_addx;
-        break;
-    }
-
-    return retval;
-  }
-
-
 private:
   friend class DualTree<Source, Target, Expansion, Method>;
   friend class TreeRegistrar<Source, Target, Record, Expansion, Method>;
 
-  node_t *root_;            /// Root of the tree
-  node_t *unif_grid_;       /// The uniform grid
-  hpx_addr_t unif_done_;    /// An LCO indicating that the uniform partition is
-                            /// complete
-  arrayref_t sorted_;       /// A reference to the sorted point data owned by
-                            /// this tree.
+  using TreeData<Record>::root_;
+  using TreeData<Record>::unif_grid_;
+  using TreeData<Record>::unif_done_;
+  using TreeData<Record>::sorted_;
+  using TreeData<Record>::arena_;
+  using TreeData<Record>::outgoing_;
+  using TreeData<Record>::incoming_;
 
   static hpx_action_t setup_basics_;
   static hpx_action_t delete_tree_;
   static hpx_action_t recv_node_;
   static hpx_action_t send_node_;
+  static hpx_action_t bounding_box_;
   static hpx_action_t assign_points_;
-  static hpx_action_t group_points_;
+  static hpx_action_t scatter_points_;
   static hpx_action_t merge_points_;
+  static hpx_action_t pull_points_;
   static hpx_action_t merge_points_same_s_and_t_;
+  static hpx_action_t collect_movers_;
+  static hpx_action_t rebuild_branch_;
 };
 
 template <typename S, typename T, typename R,
@@ -1256,7 +2474,14 @@ template <typename S, typename T, typename R,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
-hpx_action_t Tree<S, T, R, E, M>::group_points_ = HPX_ACTION_NULL;
+hpx_action_t Tree<S, T, R, E, M>::bounding_box_ = HPX_ACTION_NULL;
+
+template <typename S, typename T, typename R,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t Tree<S, T, R, E, M>::scatter_points_ = HPX_ACTION_NULL;
+
 
 template <typename S, typename T, typename R,
           template <typename, typename> class E,
@@ -1264,6 +2489,12 @@ template <typename S, typename T, typename R,
                     template <typename, typename> class> class M>
 hpx_action_t Tree<S, T, R, E, M>::merge_points_ = HPX_ACTION_NULL;
 
+template <typename S, typename T, typename R,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t Tree<S, T, R, E, M>::pull_points_ = HPX_ACTION_NULL;
+
 template <typename S, typename T, typename R,
           template <typename, typename> class E,
           template <typename, typename,
@@ -1271,6 +2502,18 @@ template <typename S, typename T, typename R,
 hpx_action_t Tree<S, T, R, E, M>::merge_points_same_s_and_t_ =
                                                           HPX_ACTION_NULL;
 
+template <typename S, typename T, typename R,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t Tree<S, T, R, E, M>::collect_movers_ = HPX_ACTION_NULL;
+
+template <typename S, typename T, typename R,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t Tree<S, T, R, E, M>::rebuild_branch_ = HPX_ACTION_NULL;
+
 
 /////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////
@@ -1278,6 +2521,47 @@ hpx_action_t Tree<S, T, R, E, M>::merge_points_same_s_and_t_ =
 /////////////////////////////////////////////////////////////////////
 
 
+/// The state of a DualTree on one rank
+///
+/// A partitioned DualTree depends only on the Source and Target types. This
+/// holds the state of a DualTree while it is handed from the DualTree of one
+/// evaluation to that of another with a different Expansion or Method; see
+/// DualTree::export_tree(). Like DualTree, this is only ever used through a
+/// RankWise object, and so is never constructed.
+template <typename Source, typename Target>
+struct DualTreeData {
+  DomainGeometry domain;          /// domain size
+  int refinement_limit;           /// refinement threshold
+  int target_limit;               /// refinement threshold of the targets
+  int adaptive;                   /// adapt the thresholds to the density
+  int unif_level;                 /// level of uniform partition
+  int dim3;                       /// number of uniform nodes
+  hpx_addr_t unif_count;          /// LCO reducing the uniform counts
+  int *unif_count_value;          /// local data storing the uniform counts
+  int *distribute;                /// the computed distribution of the nodes
+  int *rank_map;                  /// map unif grid index to rank
+  int same_sandt;                 /// Made from the same sources and targets
+  TreeData<Source> *source_tree;  /// The state of the source tree
+  TreeData<Target> *target_tree;  /// The state of the target tree
+};
+
+
+/// The estimated cost of the uniform grid nodes on one rank
+///
+/// When DASHMM_COST_WEIGHTED_PARTITION is defined, each Evaluator keeps one
+/// of these on each rank, in a RankWise object, so that the cost estimated
+/// during one evaluation can weight the partition of the next. The cost is
+/// only used for the same points and the same uniform grid; see
+/// DualTree::record_unif_cost(). Like DualTree, this is only ever used through
+/// a RankWise object, and so is never constructed.
+struct UnifCost {
+  hpx_addr_t sources;   /// the sources for which the cost was estimated
+  hpx_addr_t targets;   /// the targets for which the cost was estimated
+  int dim3;             /// number of uniform nodes
+  int64_t *cost;        /// the cost of each uniform node owned by this rank
+};
+
+
 /// The DualTree organizes the source and target tree and handles common work
 ///
 /// The DualTree manages all work that instersects between the two trees.
@@ -1301,13 +2585,18 @@ class DualTree {
   using sourcetree_t = Tree<Source, Target, Source, Expansion, Method>;
   using targettree_t = Tree<Source, Target, Target, Expansion, Method>;
   using dualtree_t = DualTree<Source, Target, Expansion, Method>;
+  using dualtreedata_t = DualTreeData<Source, Target>;
 
   /// Construction is always default
   DualTree()
-    : domain_{}, refinement_limit_{1}, unif_level_{1}, dim3_{8},
+    : domain_{}, refinement_limit_{1}, target_limit_{1}, adaptive_{0},
+      unif_level_{1}, dim3_{8},
       unif_count_{HPX_NULL}, unif_count_value_{nullptr},
       distribute_{nullptr}, method_{}, source_tree_{nullptr},
-      target_tree_{nullptr} { }
+      target_tree_{nullptr}, grouped_src_{HPX_NULL},
+      grouped_tar_{HPX_NULL}, grouped_in_gas_{false},
+      movers_arrived_{HPX_NULL},
+      kept_dag_{nullptr} { }
 
   /// We delete the copy constructor and copy assignement operator.
   DualTree(const dualtree_t &other) = delete;
@@ -1335,12 +2624,27 @@ class DualTree {
   /// Return the refinement limit used to build the tree.
   int refinement_limit() const {return refinement_limit_;}
 
+  /// Return the refinement limit used to build the target tree.
+  int target_limit() const {return target_limit_;}
+
+  /// Return whether the limits are adapted to the density of the points.
+  bool adaptive() const {return adaptive_ != 0;}
+
+  /// Return the level of the uniform grid used to distribute the points.
+  int unif_level() const {return unif_level_;}
+
   /// Return the uniform grid for the source tree.
   sourcenode_t *unif_grid_source() {return source_tree_->unif_grid_;}
 
   /// Return the uniform grid for the target tree.
   targetnode_t *unif_grid_target() {return target_tree_->unif_grid_;}
 
+  /// Return the node arena for the source tree.
+  Arena<sourcenode_t> *source_arena() {return source_tree_->arena();}
+
+  /// Return the node arena for the target tree.
+  Arena<targetnode_t> *target_arena() {return target_tree_->arena();}
+
   /// Return the number of post-sorting sources.
   size_t sorted_src_count() const {return source_tree_->sorted_.n();}
 
@@ -1447,38 +2751,281 @@ class DualTree {
   /// Return the rank owning the given unif grid node
   int rank_of_unif_grid(int idx) const {return rank_map_[idx];}
 
+  /// Record the estimated cost of the uniform grid nodes owned by this rank
+  ///
+  /// The cost of a uniform grid node is estimated as the total weight of the
+  /// edges into the DAG nodes below that uniform grid node. The weights are
+  /// those given by the Method, and so this is a model of the work rather
+  /// than a measurement of it. The edges into a node are always discovered on
+  /// the rank owning the node, so summing over the nodes owned by each rank
+  /// counts every edge once. The result is saved in @p unif_cost, and is
+  /// used to weight the distribution of the points the next time a tree of
+  /// the same points with the same uniform grid is partitioned with
+  /// @p unif_cost.
+  ///
+  /// \param dag - the DAG for this tree
+  /// \param sources - the global address of the sources of the tree
+  /// \param targets - the global address of the targets of the tree
+  /// \param unif_cost - a RankWise<UnifCost> in which to save the cost
+  void record_unif_cost(const DAG &dag, hpx_addr_t sources,
+                        hpx_addr_t targets, hpx_addr_t unif_cost) {
+    RankWise<UnifCost> global_cost{unif_cost};
+    auto saved = global_cost.here();
+    if (saved->dim3 != dim3_) {
+      delete [] saved->cost;
+      saved->cost = new int64_t[dim3_];
+      saved->dim3 = dim3_;
+    }
+    saved->sources = sources;
+    saved->targets = targets;
+    int64_t *cost = saved->cost;
+    std::fill(cost, &cost[dim3_], 0);
+    int rank = hpx_get_my_rank();
+
+    auto accumulate = [&] (const std::vector<DAGNode *> &nodes) {
+      for (auto node : nodes) {
+        std::vector<DAGEdge> out_edges = dag.out_edges(node);
+        for (auto edge = out_edges.begin(); edge != out_edges.end(); ++edge) {
+          Index idx = edge->target->idx;
+          if (idx.level() < unif_level_) {
+            continue;
+          }
+          Index cell = idx.parent(idx.level() - unif_level_);
+          int id = morton_key(cell.x(), cell.y(), cell.z());
+          if (rank_map_[id] == rank) {
+            cost[id] += edge->weight;
+          }
+        }
+      }
+    };
+
+    accumulate(dag.source_leaves);
+    accumulate(dag.source_nodes);
+    accumulate(dag.target_nodes);
+    accumulate(dag.target_leaves);
+  }
+
+  /// Estimate the cost of evaluating the part of the DAG on this rank
+  ///
+  /// The operations of the DAG are counted over the nodes owned by this
+  /// rank, as in record_unif_cost(), with the nodes above the uniform level
+  /// counted on rank 0. The cost of each kind of operation is measured by
+  /// applying it to a few leaves, or to a few edges, of this rank. The
+  /// estimate is split into three parts, which respond differently to the
+  /// refinement limit:
+  ///
+  ///   cost[0] - the direct S->T interactions, which grow in proportion to
+  ///             the refinement limit;
+  ///   cost[1] - the operations between expansions, which grow in proportion
+  ///             to the number of nodes, and so shrink in inverse proportion
+  ///             to the refinement limit;
+  ///   cost[2] - the operations between records and expansions, which depend
+  ///             mostly on the number of records.
+  ///
+  /// The table of the expansion must be set up before this is called.
+  ///
+  /// \param dag - the DAG for this tree
+  /// \param cost [out] - the estimated cost in microseconds
+  void estimate_cost(const DAG &dag, double *cost) {
+    const int n_ops = static_cast<int>(Operation::ItoL) + 1;
+    std::vector<size_t> count(n_ops, 0);
+    std::vector<std::vector<DAGEdge>> samples(n_ops);
+    int rank = hpx_get_my_rank();
+
+    // Count the operations, weighted by the records they involve
+    auto accumulate = [&] (const std::vector<DAGNode *> &nodes) {
+      for (auto node : nodes) {
+        std::vector<DAGEdge> out_edges = dag.out_edges(node);
+        for (auto edge = out_edges.begin(); edge != out_edges.end(); ++edge) {
+          if (!owns(edge->target->idx, rank)) {
+            continue;
+          }
+          int op = static_cast<int>(edge->op);
+          switch (edge->op) {
+            case Operation::StoT:
+              count[op] += edge->source->n_parts * edge->target->n_parts;
+              break;
+            case Operation::StoM:
+            case Operation::StoL:
+              count[op] += edge->source->n_parts;
+              break;
+            case Operation::MtoT:
+            case Operation::LtoT:
+              count[op] += edge->target->n_parts;
+              break;
+            default:
+              count[op] += 1;
+              if (samples[op].size() < kCostSamples) {
+                samples[op].push_back(*edge);
+              }
+              break;
+          }
+        }
+      }
+    };
+
+    accumulate(dag.source_leaves);
+    accumulate(dag.source_nodes);
+    accumulate(dag.target_nodes);
+    accumulate(dag.target_leaves);
+
+    // Time each kind of operation; the results are the time per unit counted
+    std::vector<double> unit(n_ops, 0.0);
+    for (int op = 0; op < n_ops; ++op) {
+      if (samples[op].empty()) {
+        continue;
+      }
+      double total{0.0};
+      for (size_t i = 0; i < samples[op].size(); ++i) {
+        total += time_edge(samples[op][i]);
+      }
+      unit[op] = total / samples[op].size();
+    }
+    time_leaves(count.data(), unit.data());
+
+    for (int i = 0; i < 3; ++i) {
+      cost[i] = 0.0;
+    }
+    for (int op = 0; op < n_ops; ++op) {
+      double estimate = count[op] * unit[op];
+      switch (static_cast<Operation>(op)) {
+        case Operation::StoT:
+          cost[0] += estimate;
+          break;
+        case Operation::StoM:
+        case Operation::StoL:
+        case Operation::MtoT:
+        case Operation::LtoT:
+          cost[2] += estimate;
+          break;
+        default:
+          cost[1] += estimate;
+          break;
+      }
+    }
+  }
+
   /// Create the DAG for this tree using the method specified for this object.
   ///
-  /// This will allocate and collect the DAG nodes into the returned object.
+  /// This will allocate and collect the DAG nodes into the returned object,
+  /// which is finalized.
+  ///
+  /// If @p implicit is true, the edges of the DAG are only counted. The
+  /// nodes that the distribution policy would place by their edges are
+  /// instead placed on the rank owning their part of the domain, or on rank
+  /// zero above the uniform level. Once the LCOs are created, the edges are
+  /// handed to them by emit_DAG().
+  ///
+  /// If @p keep is true, the DAG keeps the edges leaving the source leaves,
+  /// so that it can be evaluated again; see keep_DAG().
+  ///
+  /// \param implicit - create an implicit DAG
+  /// \param keep - keep the edges leaving the source leaves
   ///
   /// \returns - the resulting DAG.
-  DAG *create_DAG() {
-    // Do work on the source tree
-    hpx_addr_t sdone = hpx_lco_future_new(sizeof(int));
-    assert(sdone != HPX_NULL);
+  DAG *create_DAG(bool implicit = false, bool keep = false) {
+    // The trees may have changed since the last evaluation
+    source_tree_->freeze();
+    target_tree_->freeze();
+
+    DAG *retval = new DAG{implicit};
+    if (keep) {
+      retval->keep_leaf_edges();
+    }
+    set_DAG(retval);
+    apply_method();
+    set_DAG(nullptr);
 
-    dualtree_t *thetree = this;
-    hpx_call(HPX_HERE, source_apply_method_, HPX_NULL,
-             &thetree, &source_tree_->root_, &sdone);
+    collect_DAG_nodes(retval);
+    return retval;
+  }
 
-    hpx_lco_wait(sdone);
-    hpx_lco_delete_sync(sdone);
+  /// Hand the edges of an implicit DAG to the LCOs
+  ///
+  /// The edges of an implicit DAG are not kept. This applies the Method again
+  /// to find them, and each edge is written into the LCO serving its source
+  /// node as soon as it is found, in the space the LCO already has for its
+  /// out edges. An edge leaving a source leaf instead starts the evaluation
+  /// along that edge, so the evaluation overlaps with the search for the
+  /// remaining edges. Only the edges from a source leaf to a node on another
+  /// rank are held, until the last edge leaving the leaf is found, so that
+  /// the sources are sent to each rank once. The edges leaving nodes whose
+  /// work is done on another rank are dropped as they are found.
+  ///
+  /// The LCOs must have been created on every rank before this is called.
+  /// This is a synchronous operation. The evaluation will have started when
+  /// this returns, but it may not have ended.
+  ///
+  /// \param dag - the DAG, as created by create_DAG() with implicit set
+  /// \param rwtree - the global address of the DualTree
+  ///
+  /// \returns - the most bytes of edges held at once on this rank
+  size_t emit_DAG(DAG *dag, hpx_addr_t rwtree) {
+    assert(dag->implicit());
+
+    // The source leaves are found from their DAG nodes
+    size_t n_leaves = dag->source_leaves.size();
+    ImplicitEmit emit{this, rwtree, dag, n_leaves};
+    for (int i = 0; i < source_tree_->flat_size(); ++i) {
+      sourcenode_t *node = source_tree_->flat_node(i);
+      if (node->dag.has_parts()) {
+        emit.leaves[node->dag.parts()->id] = node;
+      }
+    }
 
-    // Do work on the target tree
-    hpx_addr_t tdone = hpx_lco_and_new(1);
-    assert(tdone != HPX_NULL);
+    DAGImplicit handoff{put_implicit_edge, close_implicit_node, &emit};
+    dag->set_handoff(&handoff);
+    set_DAG(dag);
+    apply_method();
+    set_DAG(nullptr);
+    dag->set_handoff(nullptr);
 
-    std::vector<sourcenode_t *> *consider = new std::vector<sourcenode_t *>{};
-    consider->push_back(source_tree_->root_);
-    targetnode_t *trgaddx = target_tree_->root_;
-    hpx_call(HPX_HERE, target_apply_method_, HPX_NULL,
-             &thetree, &trgaddx, &consider, &same_sandt_, &tdone);
+    // The LCOs of nodes with no out edges are not handed any
+    int myrank = hpx_get_my_rank();
+    std::vector<DAGEdge> none{};
+    for (auto group : {&dag->source_nodes, &dag->target_nodes}) {
+      for (auto node : *group) {
+        if (node->locality == myrank && node->n_out == 0) {
+          expansionlco_t expand{node->global_addx};
+          expand.set_out_edge_data(none);
+        }
+      }
+    }
 
-    hpx_lco_wait(tdone);
-    hpx_lco_delete_sync(tdone);
+    return emit.peak.load();
+  }
 
-    DAG *retval = collect_DAG_nodes();
-    return retval;
+  /// Set the DAG being built for every node of the trees
+  ///
+  /// \param dag - the DAG; see DAGInfo::set_DAG()
+  void set_DAG(DAG *dag) {
+    for (int i = 0; i < source_tree_->flat_size(); ++i) {
+      source_tree_->flat_node(i)->dag.set_DAG(dag);
+    }
+    for (int i = 0; i < target_tree_->flat_size(); ++i) {
+      target_tree_->flat_node(i)->dag.set_DAG(dag);
+    }
+  }
+
+  /// Apply the Method to the frozen trees
+  ///
+  /// This applies Method::generate and Method::aggregate to the source tree,
+  /// and then Method::inherit and Method::process to the target tree. This
+  /// is a synchronous operation.
+  void apply_method() {
+    // Do work on the source tree, one level at a time from the bottom up
+    std::vector<int> heights(source_tree_->flat_size(), 0);
+    for (int level = source_tree_->flat_levels() - 1; level >= 0; --level) {
+      run_flat_chunks(source_method_nodes_,
+                      source_tree_->flat_level_first(level),
+                      source_tree_->flat_level_first(level + 1),
+                      heights.data());
+    }
+
+    // Do work on the target tree
+    TargetMethodWalk twalk{this, same_sandt_, {}};
+    twalk.consider.push_back(source_tree_->root_);
+    TreeWalk<TargetMethodWalk>::run(twalk, target_tree_->root_);
   }
 
   /// Traverse the tree and collect the DAG nodes
@@ -1490,52 +3037,123 @@ class DualTree {
   ///
   /// This is a synchronous operation.
   ///
-  /// \param dag - a DAG object to be populated
-  DAG *collect_DAG_nodes() {
-    DAG *retval = new DAG{};
-
-    collect_DAG_nodes_from_S_node(source_tree_->root_, retval->source_leaves,
-                                  retval->source_nodes);
-    collect_DAG_nodes_from_T_node(target_tree_->root_, retval->target_leaves,
-                                  retval->target_nodes);
+  /// \param dag - a DAG object to be populated and finalized
+  void collect_DAG_nodes(DAG *dag) {
+    // NOTE: The frozen trees are traversed in reverse so that the children
+    // of a node are collected before the node.
+    for (int i = source_tree_->flat_size() - 1; i >= 0; --i) {
+      source_tree_->flat_node(i)->dag.collect_DAG_nodes(dag->source_leaves,
+                                                        dag->source_nodes);
+    }
+    for (int i = target_tree_->flat_size() - 1; i >= 0; --i) {
+      target_tree_->flat_node(i)->dag.collect_DAG_nodes(dag->target_leaves,
+                                                        dag->target_nodes);
+    }
 
     // NOTE: Note that these are non-binding requests, but this is the most
     // clear we can write this.
-    retval->source_leaves.shrink_to_fit();
-    retval->source_nodes.shrink_to_fit();
-    retval->target_nodes.shrink_to_fit();
-    retval->target_leaves.shrink_to_fit();
+    dag->source_leaves.shrink_to_fit();
+    dag->source_nodes.shrink_to_fit();
+    dag->target_nodes.shrink_to_fit();
+    dag->target_leaves.shrink_to_fit();
 
-    return retval;
+    dag->finalize();
   }
 
   /// Create the LCOs from the DAG
   ///
-  /// This will traverse the source and target tree creating any needed
-  /// expansion LCOs. Further, it will create the target LCOs in the target
-  /// tree.
+  /// This will loop over the frozen source and target trees creating any
+  /// needed expansion LCOs. Further, it will create the target LCOs in the
+  /// target tree.
   ///
   /// This is a synchronous operation.
-  void create_expansions_from_DAG(hpx_addr_t rwtree) {
-    hpx_addr_t done = hpx_lco_and_new(2);
+  ///
+  /// \param dag - the DAG
+  /// \param rwtree - the global address of the DualTree
+  void create_expansions_from_DAG(DAG *dag, hpx_addr_t rwtree) {
+    int n_src = source_tree_->flat_size();
+    int n_tar = target_tree_->flat_size();
+    int grain = std::max(kWalkGrain, 1);
+    int n_chunks = (n_src + grain - 1) / grain + (n_tar + grain - 1) / grain;
+
+    hpx_addr_t done = hpx_lco_and_new(n_chunks);
     assert(done != HPX_NULL);
 
-    dualtree_t *argthis = this;
-    sourcenode_t *srcaddx = source_tree_->root_;
-    hpx_call(HPX_HERE, create_S_expansions_from_DAG_, HPX_NULL,
-             &done, &argthis, &srcaddx, &rwtree);
-    targetnode_t *trgaddx = target_tree_->root_;
-    hpx_call(HPX_HERE, create_T_expansions_from_DAG_, HPX_NULL,
-             &done, &argthis, &trgaddx, &rwtree);
+    dualtree_t *self = this;
+    for (int type = 0; type < 2; ++type) {
+      int n_nodes = type ? n_tar : n_src;
+      for (int first = 0; first < n_nodes; first += grain) {
+        int last = std::min(first + grain, n_nodes);
+        hpx_call(HPX_HERE, create_expansions_nodes_, done,
+                 &self, &dag, &first, &last, &type, &rwtree);
+      }
+    }
 
     hpx_lco_wait(done);
     hpx_lco_delete_sync(done);
+
+    // Remote edges find their target LCOs on this rank in the index
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t index_begin = hpx_time_now();
+#endif
+    source_tree_->index_lcos();
+    target_tree_->index_lcos();
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t index_end = hpx_time_now();
+    fprintf(stdout, "LCO index: %d - %zu entries - %lg [us]\n",
+            hpx_get_my_rank(),
+            source_tree_->lco_index_size() + target_tree_->lco_index_size(),
+            hpx_time_diff_us(index_begin, index_end));
+#endif
   }
 
-  /// Sets up termination detection for a DASHMM evaluation
-  ///
-  /// This is an asynchronous operation. The returned LCO becomes the
-  /// responsibility of the caller.
+  /// Return the number of LCO address lookups since the LCOs were created
+  ///
+  /// The lookups are only counted if DASHMMEXTRATIMING is defined.
+  size_t lookup_count() const {
+    return source_tree_->lookup_count() + target_tree_->lookup_count();
+  }
+
+  /// Return the time in microseconds spent in LCO address lookups since the
+  /// LCOs were created
+  ///
+  /// The lookups are only timed if DASHMMEXTRATIMING is defined.
+  double lookup_time() const {
+    return source_tree_->lookup_time() + target_tree_->lookup_time();
+  }
+
+  /// Apply an action to chunks of a range of the frozen source tree
+  ///
+  /// The range is split into chunks of kWalkGrain nodes, each of which is
+  /// handled by a separate action. This is a synchronous operation.
+  ///
+  /// \param action - the action; this takes the DualTree, the first and last
+  ///                 offset of the chunk, and @p data
+  /// \param first - the first offset of the range
+  /// \param last - one past the last offset of the range
+  /// \param data - extra argument to the action
+  void run_flat_chunks(hpx_action_t action, int first, int last, int *data) {
+    int grain = std::max(kWalkGrain, 1);
+    int n_chunks = (last - first + grain - 1) / grain;
+    if (n_chunks == 0) return;
+
+    hpx_addr_t done = hpx_lco_and_new(n_chunks);
+    assert(done != HPX_NULL);
+
+    dualtree_t *self = this;
+    for (int cfirst = first; cfirst < last; cfirst += grain) {
+      int clast = std::min(cfirst + grain, last);
+      hpx_call(HPX_HERE, action, done, &self, &cfirst, &clast, &data);
+    }
+
+    hpx_lco_wait(done);
+    hpx_lco_delete_sync(done);
+  }
+
+  /// Sets up termination detection for a DASHMM evaluation
+  ///
+  /// This is an asynchronous operation. The returned LCO becomes the
+  /// responsibility of the caller.
   ///
   /// \param targets - vector of target nodes in the DAG
   /// \param internals - vector of internal nodes in the DAG
@@ -1568,17 +3186,26 @@ class DualTree {
   /// that information.
   ///
   /// This is an asynchronous operation. The work will have started when this
-  /// function returns, but it may not have ended. There is no returned LCO
-  /// as the termination detection cannot trigger before this is done.
+  /// function returns, but it may not have ended. The termination detection
+  /// cannot trigger before this is done, so the returned LCO is only needed
+  /// to know when the edges of the DAG have been copied into the LCOs. The
+  /// returned LCO becomes the responsibility of the caller.
   ///
   /// \param dag - DAG object
-  void setup_edge_lists(DAG *dag) {
+  ///
+  /// \returns - LCO that is set once the edge lists are set
+  hpx_addr_t setup_edge_lists(DAG *dag) {
+    hpx_addr_t retval = hpx_lco_future_new(0);
+    assert(retval != HPX_NULL);
+
     DAGNode **sdata = dag->source_nodes.data();
     size_t n_snodes = dag->source_nodes.size();
     DAGNode **tdata = dag->target_nodes.data();
     size_t n_tnodes = dag->target_nodes.size();
-    hpx_call(HPX_HERE, edge_lists_, HPX_NULL,
-             &sdata, &n_snodes, &tdata, &n_tnodes);
+    hpx_call(HPX_HERE, edge_lists_, retval,
+             &dag, &sdata, &n_snodes, &tdata, &n_tnodes);
+
+    return retval;
   }
 
   /// Initiate the DAG evaluation
@@ -1588,13 +3215,44 @@ class DualTree {
   ///
   /// This is an asynchronous operation. The termination detection cannot
   /// possibly trigger before this is completed, so waiting on the termination
-  /// of the full evaluation implicitly waits on this operation.
+  /// of the full evaluation implicitly waits on this operation. Each leaf
+  /// copies its edges out of the DAG before it starts its work; the returned
+  /// LCO is set once every leaf has done so. The returned LCO becomes the
+  /// responsibility of the caller.
   ///
   /// \param global_tree - the Dual Tree
-  void start_DAG_evaluation(RankWise<dualtree_t> &global_tree) {
-    hpx_addr_t rwaddr = global_tree.data();
-    hpx_call(HPX_HERE, instigate_dag_eval_, HPX_NULL,
-             &rwaddr, &source_tree_->root_);
+  /// \param dag - the DAG
+  ///
+  /// \returns - LCO that is set once the edges of the DAG are no longer
+  ///             needed by the leaves
+  hpx_addr_t start_DAG_evaluation(RankWise<dualtree_t> &global_tree,
+                                  DAG *dag) {
+    int myrank = hpx_get_my_rank();
+    std::vector<sourcenode_t *> leaves{};
+    for (int i = 0; i < source_tree_->flat_size(); ++i) {
+      if (source_tree_->flat(i).mask) continue;
+      sourcenode_t *node = source_tree_->flat_node(i);
+      DAGNode *parts = node->dag.parts();
+      if (parts == nullptr || parts->locality != myrank) continue;
+      leaves.push_back(node);
+    }
+
+    // NOTE: The extra input is set here, so that the LCO is set even if
+    // there are no leaves on this rank.
+    hpx_addr_t retval = hpx_lco_and_new(leaves.size() + 1);
+    assert(retval != HPX_NULL);
+
+    // NOTE: the work at the leaves dominates, so every leaf with work on
+    // this rank is given its own action.
+    dualtree_t *self = this;
+    hpx_addr_t rwtree = global_tree.data();
+    for (auto node : leaves) {
+      hpx_call(HPX_HERE, instigate_dag_eval_, HPX_NULL,
+               &self, &rwtree, &dag, &node, &retval);
+    }
+    hpx_lco_and_set(retval, HPX_NULL);
+
+    return retval;
   }
 
   /// Destroys the LCOs associated with the DAG
@@ -1624,6 +3282,93 @@ class DualTree {
 
     hpx_lco_wait(done);
     hpx_lco_delete_sync(done);
+
+    source_tree_->clear_lco_index();
+    target_tree_->clear_lco_index();
+  }
+
+  /// Keep a DAG, and its LCOs, for another evaluation
+  ///
+  /// The DAG must keep the edges of its source leaves; see
+  /// DAG::keep_leaf_edges(). The DAG and its LCOs belong to this object
+  /// until release_DAG() is called, which is done when the tree is updated,
+  /// exported or destroyed, as the DAG is no longer valid for the tree.
+  ///
+  /// \param dag - the DAG, with its LCOs
+  void keep_DAG(DAG *dag) {
+    assert(kept_dag_ == nullptr || kept_dag_ == dag);
+    assert(dag->keeps_leaf_edges());
+    kept_dag_ = dag;
+  }
+
+  /// The DAG kept for another evaluation, or nullptr if there is none
+  DAG *kept_DAG() const {return kept_dag_;}
+
+  /// Destroy the kept DAG and its LCOs
+  ///
+  /// This is a synchronous operation.
+  void release_DAG() {
+    if (kept_dag_ == nullptr) return;
+    destroy_DAG_LCOs(*kept_dag_);
+    delete kept_dag_;
+    kept_dag_ = nullptr;
+  }
+
+  /// Reset the LCOs associated with the DAG for another evaluation
+  ///
+  /// The LCOs hold the edges of the DAG, so once they are reset the DAG can
+  /// be evaluated again without creating it. The expansion LCOs do not
+  /// trigger until reuse_edge_lists() is called, which must not be done
+  /// before the LCOs are reset on every rank.
+  ///
+  /// This is a synchronous operation.
+  ///
+  /// \param dag - the DAG
+  void reset_DAG_LCOs(DAG &dag) {
+    hpx_addr_t done = hpx_lco_and_new(3);
+    assert(done != HPX_NULL);
+
+    DAGNode **data = dag.target_leaves.data();
+    size_t n_data = dag.target_leaves.size();
+    int type = 1;
+    hpx_call(HPX_HERE, reset_DAG_LCOs_, done, &data, &n_data, &type);
+
+    data = dag.target_nodes.data();
+    n_data = dag.target_nodes.size();
+    type = 0;
+    hpx_call(HPX_HERE, reset_DAG_LCOs_, done, &data, &n_data, &type);
+
+    data = dag.source_nodes.data();
+    n_data = dag.source_nodes.size();
+    type = 0;
+    hpx_call(HPX_HERE, reset_DAG_LCOs_, done, &data, &n_data, &type);
+
+    hpx_lco_wait(done);
+    hpx_lco_delete_sync(done);
+  }
+
+  /// Mark the edge lists of reset expansion LCOs as set
+  ///
+  /// This takes the place of setup_edge_lists() when the DAG is evaluated
+  /// again; the LCOs have kept their edges. This is an asynchronous
+  /// operation. The returned LCO is set once every LCO is marked, and
+  /// becomes the responsibility of the caller.
+  ///
+  /// \param dag - the DAG, with LCOs reset by reset_DAG_LCOs()
+  ///
+  /// \returns - LCO that is set once the edge lists are marked
+  hpx_addr_t reuse_edge_lists(DAG *dag) {
+    hpx_addr_t retval = hpx_lco_future_new(0);
+    assert(retval != HPX_NULL);
+
+    DAGNode **sdata = dag->source_nodes.data();
+    size_t n_snodes = dag->source_nodes.size();
+    DAGNode **tdata = dag->target_nodes.data();
+    size_t n_tnodes = dag->target_nodes.size();
+    hpx_call(HPX_HERE, reuse_edge_lists_, retval,
+             &sdata, &n_snodes, &tdata, &n_tnodes);
+
+    return retval;
   }
 
 
@@ -1637,21 +3382,47 @@ class DualTree {
   /// Further, this is to be called in a diffusive style; only a single thread
   /// should call this function.
   ///
+  /// The domain can be made larger than the points require by giving a
+  /// nonzero @p margin. This allows the points to move further before the
+  /// tree cannot be update()-ed.
+  ///
+  /// The target tree can be given its own partitioning threshold. If the
+  /// sources and targets are the same, the trees are the same, and the
+  /// target threshold is ignored. See set_leaf_limits() for the effect of
+  /// @p adaptive.
+  ///
   /// \param threshold - the partitioning threshold for the tree
   /// \param sources - the source data
   /// \param targets - the target data
+  /// \param margin - the fraction by which to enlarge the domain
+  /// \param target_threshold - the partitioning threshold for the target
+  ///                           tree; if not positive, @p threshold is used
+  /// \param adaptive - adapt the thresholds to the local density of the
+  ///                   points
   ///
   /// \returns - the RankWise object containing the dual tree
   static RankWise<dualtree_t> create(int threshold, Array<Source> sources,
-                                     Array<Target> targets) {
+                                     Array<Target> targets,
+                                     double margin = 0.0,
+                                     int target_threshold = 0,
+                                     bool adaptive = false) {
     bool same_sandt{false};
     if (sources.data() == targets.data()) {
       same_sandt = true;
     }
+    if (target_threshold <= 0 || same_sandt) {
+      target_threshold = threshold;
+    }
     hpx_addr_t domain_geometry = compute_domain_geometry(sources, targets,
                                                          same_sandt);
-    RankWise<dualtree_t> retval = setup_basic_data(threshold, domain_geometry,
-                                                   same_sandt);
+    if (margin > 0.0) {
+      domain_geometry = enlarge_bounds(domain_geometry, 1.0 + margin);
+    }
+    int unif_level = choose_unif_level(sources, targets, domain_geometry,
+                                       same_sandt);
+    RankWise<dualtree_t> retval = setup_basic_data(threshold, target_threshold,
+                                                   adaptive, domain_geometry,
+                                                   same_sandt, unif_level);
     hpx_lco_delete_sync(domain_geometry);
     return retval;
   }
@@ -1669,14 +3440,20 @@ class DualTree {
   /// single thread. This routine will handle involving all ranks in the
   /// system.
   ///
+  /// If @p unif_cost holds the cost estimated for the same points with the
+  /// same uniform grid, that cost weights the distribution of the points; see
+  /// record_unif_cost().
+  ///
   /// \param global_tree - an object previously initialized with create()
   /// \param sources - the source data
   /// \param targets - the target data
+  /// \param unif_cost - a RankWise<UnifCost>, or HPX_NULL
   ///
   /// \returns - an LCO indication completion of the partitioning.
   static hpx_addr_t partition(RankWise<dualtree_t> global_tree,
                               Array<Source> sources,
-                              Array<Target> targets) {
+                              Array<Target> targets,
+                              hpx_addr_t unif_cost = HPX_NULL) {
     hpx_addr_t retval = hpx_lco_future_new(0);
     assert(retval != HPX_NULL);
 
@@ -1684,11 +3461,82 @@ class DualTree {
     hpx_addr_t source_gas = sources.data();
     hpx_addr_t target_gas = targets.data();
     hpx_bcast_lsync(create_dual_tree_, retval,
-                    &tree_gas, &source_gas, &target_gas);
+                    &tree_gas, &source_gas, &target_gas, &unif_cost);
 
     return retval;
   }
 
+  /// Update the tree after the points have moved
+  ///
+  /// This updates a partitioned tree in place, instead of partitioning the
+  /// points from scratch. The existing nodes are kept. Each rank finds the
+  /// records that have left their leaf, and only those records are moved to
+  /// their new leaf, which may be on another rank. Afterwards, the branches
+  /// of the uniform grid nodes that records have left or entered are
+  /// rebuilt: leaves that have too many records are split, nodes with few
+  /// enough records become leaves, and empty nodes are removed; see
+  /// Node::rebuild_branch() for how this compares to partitioning from
+  /// scratch. Only the rebuilt branches are sent to the other ranks, and the
+  /// other branches are left as they are. A kept DAG is released; see
+  /// keep_DAG().
+  ///
+  /// The sources and targets must be the same Arrays that were partitioned
+  /// with this tree, and the number of records must not have changed. If the
+  /// number of records in each uniform grid node owned by a rank is
+  /// unchanged, the local segments of the arrays are kept, and only the
+  /// records of the rebuilt branches are laid out again. Otherwise, as with
+  /// partition(), the local segments of the arrays will be replaced.
+  ///
+  /// If any point has left the domain of the tree, the tree cannot be
+  /// updated. In that case, nothing is changed, and this returns false; the
+  /// tree should be destroyed, and a new tree created.
+  ///
+  /// This call is synchronous, and should be called from inside an HPX
+  /// thread in a diffusive style.
+  ///
+  /// \param global_tree - a previously partitioned tree
+  /// \param sources - the source data
+  /// \param targets - the target data
+  ///
+  /// \returns - true if the tree was updated; false otherwise
+  static bool update(RankWise<dualtree_t> global_tree, Array<Source> sources,
+                     Array<Target> targets) {
+    int num_ranks = hpx_get_num_ranks();
+    auto tree = global_tree.here();
+
+    hpx_addr_t valid = hpx_lco_reduce_new(num_ranks, sizeof(int),
+                                          int_sum_ident_op, int_sum_op);
+    assert(valid != HPX_NULL);
+    hpx_addr_t count = hpx_lco_reduce_new(num_ranks,
+                                          sizeof(int) * tree->dim3_ * 4,
+                                          int_sum_ident_op, int_sum_op);
+    assert(count != HPX_NULL);
+
+    hpx_addr_t tree_gas = global_tree.data();
+    hpx_addr_t source_gas = sources.data();
+    hpx_addr_t target_gas = targets.data();
+    hpx_bcast_rsync(update_dual_tree_, &tree_gas, &source_gas, &target_gas,
+                    &valid, &count);
+
+    int n_valid{0};
+    hpx_lco_get(valid, sizeof(int), &n_valid);
+    hpx_lco_delete_sync(valid);
+    hpx_lco_delete_sync(count);
+
+    return n_valid == num_ranks;
+  }
+
+  /// Destroy the estimated costs saved by record_unif_cost()
+  ///
+  /// This should be called from an HPX thread, in a diffusive style.
+  ///
+  /// \param unif_cost - a RankWise<UnifCost>
+  static void destroy_unif_cost(hpx_addr_t unif_cost) {
+    hpx_bcast_rsync(delete_unif_cost_, &unif_cost);
+    RankWise<UnifCost> global_cost{unif_cost};
+    global_cost.destroy();
+  }
+
   /// Destroy a distributed tree.
   ///
   /// This cleans up all allocated resources used by the DualTree.
@@ -1706,6 +3554,90 @@ class DualTree {
     global_tree.destroy();
   }
 
+  /// Gather statistics describing the shape of a distributed tree
+  ///
+  /// The nodes of the trees are counted on each rank, and the counts are
+  /// summed across ranks into @p data. See TreeStatistics::unpack() for the
+  /// meaning of the values. The cost is a walk over the nodes owned by each
+  /// rank, which is small compared to partitioning the tree, and much
+  /// smaller than the evaluation.
+  ///
+  /// This should be called from an HPX thread, in a diffusive style.
+  ///
+  /// \param global_tree - a partitioned tree
+  /// \param data [out] - TreeStatistics::packed_size() values
+  ///
+  /// \returns - the level of the uniform partition of the tree
+  static int statistics(RankWise<dualtree_t> global_tree, size_t *data) {
+    int num_ranks = hpx_get_num_ranks();
+    size_t bytes = sizeof(size_t) * TreeStatistics::packed_size(num_ranks);
+    hpx_addr_t stats = hpx_lco_reduce_new(num_ranks, bytes,
+                                          size_sum_ident, size_sum_op);
+    assert(stats != HPX_NULL);
+
+    hpx_addr_t rwtree = global_tree.data();
+    hpx_bcast_rsync(collect_statistics_, &rwtree, &stats);
+
+    hpx_lco_get(stats, bytes, data);
+    hpx_lco_delete_sync(stats);
+
+    auto tree = global_tree.here();
+    return tree->unif_level_;
+  }
+
+  /// Take the partitioned tree out of a distributed tree
+  ///
+  /// The tree depends only on the sources and targets, so a tree partitioned
+  /// for one evaluation can serve another evaluation of the same points with
+  /// a different Expansion or Method. This moves the state of the tree out
+  /// of @p global_tree, which is destroyed, so that it can be given to the
+  /// DualTree of the other evaluation with import_tree(). No nodes or records
+  /// are copied.
+  ///
+  /// This should be called from an HPX thread, in a diffusive style.
+  ///
+  /// \param global_tree - the distributed tree
+  ///
+  /// \returns - the state of the tree
+  static RankWise<dualtreedata_t> export_tree(
+      RankWise<dualtree_t> &global_tree) {
+    RankWise<dualtreedata_t> retval{};
+    retval.allocate();
+    assert(retval.valid());
+
+    hpx_addr_t rwtree = global_tree.data();
+    hpx_addr_t rwdata = retval.data();
+    hpx_bcast_rsync(export_tree_, &rwtree, &rwdata);
+
+    global_tree.destroy();
+    return retval;
+  }
+
+  /// Create a distributed tree from the state taken from another
+  ///
+  /// The DAG information left in the tree is removed when the next DAG is
+  /// created, so the result is ready for an evaluation of the same sources
+  /// and targets, provided that they have not moved since the tree was last
+  /// partitioned or updated.
+  ///
+  /// This should be called from an HPX thread, in a diffusive style.
+  ///
+  /// \param data - the state of a tree from export_tree(); this is destroyed
+  ///
+  /// \returns - the RankWise object containing the dual tree
+  static RankWise<dualtree_t> import_tree(RankWise<dualtreedata_t> &data) {
+    RankWise<dualtree_t> retval{};
+    retval.allocate();
+    assert(retval.valid());
+
+    hpx_addr_t rwtree = retval.data();
+    hpx_addr_t rwdata = data.data();
+    hpx_bcast_rsync(import_tree_, &rwtree, &rwdata);
+
+    data.destroy();
+    return retval;
+  }
+
 
  private:
   friend class DualTreeRegistrar<Source, Target, Expansion, Method>;
@@ -1721,8 +3653,9 @@ class DualTree {
   /// Action to set the domain geometry given the sources and targets
   ///
   /// This action is the target of a broadcast, and computes the domain for
-  /// the local sources and targets. The result is then given to a reduction
-  /// LCO which reduces each rank's portion.
+  /// the local sources and targets, using all the worker threads of this rank.
+  /// The result is then given to a reduction LCO which reduces each rank's
+  /// portion.
   ///
   /// \param sources_gas - the global address of the source data
   /// \param targets_gas - the global address of the target data
@@ -1735,33 +3668,16 @@ class DualTree {
                                          int same_sandt) {
     Array<source_t> sources{sources_gas};
     sourceref_t src_ref = sources.ref();
-    Source *s = src_ref.data();
 
     double var[6] = {1e50, -1e50, 1e50, -1e50, 1e50, -1e50};
 
-    for (size_t i = 0; i < src_ref.n(); ++i) {
-      var[0] = fmin(var[0], s[i].position.x());
-      var[1] = fmax(var[1], s[i].position.x());
-      var[2] = fmin(var[2], s[i].position.y());
-      var[3] = fmax(var[3], s[i].position.y());
-      var[4] = fmin(var[4], s[i].position.z());
-      var[5] = fmax(var[5], s[i].position.z());
-    }
+    sourcetree_t::extend_bounding_box(src_ref.data(), src_ref.n(), var);
 
     // Only do the targets if they are different from the sources
     if (!same_sandt) {
       Array<target_t> targets{targets_gas};
       targetref_t trg_ref = targets.ref();
-      Target *t = trg_ref.data();
-
-      for (size_t i = 0; i < trg_ref.n(); ++i) {
-        var[0] = fmin(var[0], t[i].position.x());
-        var[1] = fmax(var[1], t[i].position.x());
-        var[2] = fmin(var[2], t[i].position.y());
-        var[3] = fmax(var[3], t[i].position.y());
-        var[4] = fmin(var[4], t[i].position.z());
-        var[5] = fmax(var[5], t[i].position.z());
-      }
+      targettree_t::extend_bounding_box(trg_ref.data(), trg_ref.n(), var);
     }
 
     hpx_lco_set_lsync(domain_geometry, sizeof(double) * 6, var, HPX_NULL);
@@ -1828,6 +3744,188 @@ class DualTree {
     return domain_geometry;
   }
 
+  /// Construct the cubical domain from the reduced bounding box
+  ///
+  /// \param var - the bounding box (xmin, xmax, ymin, ymax, zmin, zmax)
+  ///
+  /// \returns - the domain geometry
+  static DomainGeometry domain_from_bounds(const double *var) {
+    double length = fmax(var[1] - var[0],
+                         fmax(var[3] - var[2], var[5] - var[4]));
+    return DomainGeometry{Point{(var[1] + var[0] - length) / 2,
+                                (var[3] + var[2] - length) / 2,
+                                (var[5] + var[4] - length) / 2}, length};
+  }
+
+  /// Enlarge the bounds of the points
+  ///
+  /// This replaces the LCO holding the bounds of the points with one holding
+  /// bounds with the same center that are larger by the given factor.
+  ///
+  /// \param bounds - the LCO into which the bounds are reduced; this is
+  ///                 deleted
+  /// \param factor - the factor by which to enlarge the bounds
+  ///
+  /// \returns - an LCO holding the enlarged bounds
+  static hpx_addr_t enlarge_bounds(hpx_addr_t bounds, double factor) {
+    double var[6];
+    hpx_lco_get(bounds, sizeof(double) * 6, &var);
+    hpx_lco_delete_sync(bounds);
+
+    for (int d = 0; d < 3; ++d) {
+      double center = 0.5 * (var[2 * d] + var[2 * d + 1]);
+      double half = 0.5 * factor * (var[2 * d + 1] - var[2 * d]);
+      var[2 * d] = center - half;
+      var[2 * d + 1] = center + half;
+    }
+
+    hpx_addr_t retval = hpx_lco_future_new(sizeof(double) * 6);
+    assert(retval != HPX_NULL);
+    hpx_lco_set_lsync(retval, sizeof(double) * 6, var, HPX_NULL);
+    return retval;
+  }
+
+  /// Action to count a sample of the local points on a fine uniform grid
+  ///
+  /// This is the target of a broadcast. Each rank takes an evenly strided
+  /// sample of its sources and targets, and counts the sampled points in
+  /// each node of the uniform grid at the given level. Each sampled point is
+  /// weighted by the stride, so that the reduced histogram estimates the
+  /// global counts.
+  ///
+  /// \param sources_gas - global address of the source data
+  /// \param targets_gas - global address of the target data
+  /// \param domain_geometry - the LCO in which the domain is reduced
+  /// \param hist - the LCO in which the histogram is reduced
+  /// \param level - the level of the uniform grid
+  /// \param same_sandt - is S == T for this tree
+  ///
+  /// \returns - HPX_SUCCESS
+  static int sample_unif_grid_handler(hpx_addr_t sources_gas,
+                                      hpx_addr_t targets_gas,
+                                      hpx_addr_t domain_geometry,
+                                      hpx_addr_t hist, int level,
+                                      int same_sandt) {
+    const size_t n_sample = 1 << 16;
+
+    double var[6];
+    hpx_lco_get(domain_geometry, sizeof(double) * 6, &var);
+    DomainGeometry geo = domain_from_bounds(var);
+
+    size_t dim3 = (size_t)1 << (3 * level);
+    int shift = 3 * (kMortonBits - level);
+    size_t *count = new size_t[dim3]();
+
+    Array<source_t> sources{sources_gas};
+    sourceref_t src_ref = sources.ref();
+    Source *s = src_ref.data();
+    size_t stride = std::max(src_ref.n() / n_sample, (size_t)1);
+    for (size_t i = 0; i < src_ref.n(); i += stride) {
+      count[morton_key(s[i].position, &geo) >> shift] += stride;
+    }
+
+    if (!same_sandt) {
+      Array<target_t> targets{targets_gas};
+      targetref_t trg_ref = targets.ref();
+      Target *t = trg_ref.data();
+      stride = std::max(trg_ref.n() / n_sample, (size_t)1);
+      for (size_t i = 0; i < trg_ref.n(); i += stride) {
+        count[morton_key(t[i].position, &geo) >> shift] += stride;
+      }
+    }
+
+    hpx_lco_set_lsync(hist, sizeof(size_t) * dim3, count, HPX_NULL);
+    delete [] count;
+
+    return HPX_SUCCESS;
+  }
+
+  /// Select the level of the uniform grid
+  ///
+  /// By default, the uniform grid has just enough levels to give each rank
+  /// a few uniform grid nodes. If DASHMM_ADAPTIVE_UNIF_GRID is defined, its
+  /// value is taken as a fraction of the per-rank share of the points, and
+  /// the grid is refined until the largest uniform grid node holds no more
+  /// than that fraction. The counts are estimated from a sample of the
+  /// points, and the refinement stops kUnifRefineLevels below the default
+  /// level, and at level kMortonBits, to bound the cost of the uniform grid.
+  ///
+  /// \param sources - the source data
+  /// \param targets - the target data
+  /// \param domain_geometry - the LCO in which the domain is reduced
+  /// \param same_sandt - is S == T for this tree
+  ///
+  /// \returns - the level of the uniform grid
+  static int choose_unif_level(Array<Source> sources, Array<Target> targets,
+                               hpx_addr_t domain_geometry, bool same_sandt) {
+    int num_ranks = hpx_get_num_ranks();
+    int level = ceil(log(num_ranks) / log(8)) + 1;
+
+#ifdef DASHMM_ADAPTIVE_UNIF_GRID
+    const int max_level = std::min(level + kUnifRefineLevels, kMortonBits);
+    if (level >= max_level) {
+      return level;
+    }
+
+    size_t dim3 = (size_t)1 << (3 * max_level);
+    hpx_addr_t hist = hpx_lco_reduce_new(num_ranks, sizeof(size_t) * dim3,
+                                         size_sum_ident, size_sum_op);
+    assert(hist != HPX_NULL);
+    hpx_addr_t sglob = sources.data();
+    hpx_addr_t tglob = targets.data();
+    int ssat = (same_sandt ? 1 : 0);
+    int hist_level = max_level;
+    hpx_bcast_lsync(sample_unif_grid_, HPX_NULL, &sglob, &tglob,
+                    &domain_geometry, &hist, &hist_level, &ssat);
+
+    std::vector<size_t> count(dim3);
+    hpx_lco_get(hist, sizeof(size_t) * dim3, count.data());
+    hpx_lco_delete_sync(hist);
+
+    double total{0};
+    for (size_t i = 0; i < dim3; ++i) {
+      total += count[i];
+    }
+    double limit = DASHMM_ADAPTIVE_UNIF_GRID * total / num_ranks;
+
+    // The children of a uniform grid node are contiguous in the Morton
+    // order, so each coarser level is found by summing groups of eight.
+    std::vector<size_t> largest(max_level + 1, 0);
+    for (int l = max_level; l >= level; --l) {
+      size_t n_cells = (size_t)1 << (3 * l);
+      for (size_t i = 0; i < n_cells; ++i) {
+        largest[l] = std::max(largest[l], count[i]);
+      }
+      if (l > level) {
+        for (size_t i = 0; i < n_cells / 8; ++i) {
+          size_t sum = 0;
+          for (int j = 0; j < 8; ++j) {
+            sum += count[8 * i + j];
+          }
+          count[i] = sum;
+        }
+      }
+    }
+
+    int chosen = max_level;
+    for (int l = level; l < max_level; ++l) {
+      if (largest[l] <= limit) {
+        chosen = l;
+        break;
+      }
+    }
+
+#ifdef DASHMMEXTRATIMING
+    fprintf(stdout, "Uniform grid: level %d (default %d) - largest node %zu "
+            "- limit %lg\n", chosen, level, largest[chosen], limit);
+#endif
+
+    level = chosen;
+#endif
+
+    return level;
+  }
+
   /// Action to perform initializtion of basic data for the local tree
   ///
   /// This is the target of a broadcast, and it sets various data about the
@@ -1836,21 +3934,26 @@ class DualTree {
   /// \param rwdata - the global address of the global tree
   /// \param count - an LCO in which the uniform grid counting is reduced
   /// \param limit - the partitioning threshold for the tree
+  /// \param target_limit - the partitioning threshold for the target tree
+  /// \param adaptive - adapt the thresholds to the density of the points
   /// \param domain_geometry - the LCO in which the domain is reduced
   /// \param same_sandt - is S == T for this tree
+  /// \param unif_level - the level of the uniform grid
   ///
   /// \returns - HPX_SUCCESS
   static int init_partition_handler(hpx_addr_t rwdata, hpx_addr_t count,
-                                    int limit, hpx_addr_t domain_geometry,
-                                    int same_sandt) {
+                                    int limit, int target_limit, int adaptive,
+                                    hpx_addr_t domain_geometry,
+                                    int same_sandt, int unif_level) {
     RankWise<dualtree_t> global_tree{rwdata};
     auto tree = global_tree.here();
 
-    int num_ranks = hpx_get_num_ranks();
-    tree->unif_level_ = ceil(log(num_ranks) / log(8)) + 1;
+    tree->unif_level_ = unif_level;
     tree->dim3_ = pow(8, tree->unif_level_);
     tree->unif_count_ = count;
     tree->refinement_limit_ = limit;
+    tree->target_limit_ = target_limit;
+    tree->adaptive_ = adaptive;
     tree->source_tree_ =
       new Tree<Source, Target, Source, Expansion, Method>{};
     tree->target_tree_ =
@@ -1872,12 +3975,7 @@ class DualTree {
     // Setup domain_
     double var[6];
     hpx_lco_get(domain_geometry, sizeof(double) * 6, &var);
-    double length = fmax(var[1] - var[0],
-                         fmax(var[3] - var[2], var[5] - var[4]));
-    DomainGeometry geo{Point{(var[1] + var[0] - length) / 2,
-                             (var[3] + var[2] - length) / 2,
-                             (var[5] + var[4] - length) / 2}, length};
-    tree->domain_ = geo;
+    tree->domain_ = domain_from_bounds(var);
 
     // Set the shared version
     //shared::set_geo(geo);
@@ -1894,13 +3992,18 @@ class DualTree {
   /// This will both allocate and setup a dual tree.
   ///
   /// \param threshold - the partitioning threshold
+  /// \param target_threshold - the partitioning threshold of the targets
+  /// \param adaptive - adapt the thresholds to the density of the points
   /// \param domain_geometry - an LCO into which the domain is reduced
   /// \param same_sandt - is S == T for this tree
+  /// \param level - the level of the uniform grid
   ///
   /// \returns - the Dual Tree
   static RankWise<dualtree_t> setup_basic_data(int threshold,
+                                               int target_threshold,
+                                               bool adaptive,
                                                hpx_addr_t domain_geometry,
-                                               bool same_sandt) {
+                                               bool same_sandt, int level) {
     RankWise<dualtree_t> retval{};
     retval.allocate();
     if (!retval.valid()) {
@@ -1910,15 +4013,15 @@ class DualTree {
 
     // Now the single things are created.
     int num_ranks = hpx_get_num_ranks();
-    int level = ceil(log(num_ranks) / log(8)) + 1;
     int dim3 = pow(8, level);
-    hpx_addr_t ucount = hpx_lco_reduce_new(num_ranks, sizeof(int) * (dim3 * 2),
-                                           int_sum_ident_op,
-                                           int_sum_op);
+    hpx_addr_t ucount = hpx_lco_reduce_new(num_ranks,
+                                           sizeof(size_t) * (dim3 * 3),
+                                           size_sum_ident, size_sum_op);
     hpx_addr_t rwdata = retval.data();
     int ssat = (same_sandt ? 1 : 0);
+    int adapt = (adaptive ? 1 : 0);
     hpx_bcast_rsync(init_partition_, &rwdata, &ucount, &threshold,
-                    &domain_geometry, &ssat);
+                    &target_threshold, &adapt, &domain_geometry, &ssat, &level);
 
     return retval;
   }
@@ -1927,164 +4030,857 @@ class DualTree {
   ///
   /// Given the uniform counts, this will provide a good guess at a
   /// distribution of those points. This operates basically through the Morton
-  /// ordering of the uniform grid nodes, and aims to have segments of the
-  /// space-filling curve which have similar total counts.
+  /// ordering of the uniform grid nodes, and divides the space-filling curve
+  /// into segments so that the largest total cost of any segment is as small
+  /// as possible. The cost of each uniform grid node is the cost estimated
+  /// during the previous evaluation if one is available, and the number of
+  /// sources and targets in the node otherwise. The estimate is a total edge
+  /// weight, so to combine it with the points, each point is given the
+  /// average estimated cost of a point. As the estimate is from the previous
+  /// points, a node is never given less weight than that of the points it
+  /// now holds, so that nodes which were empty are not free. The largest
+  /// estimated cost of any rank is then minimized.
+  ///
+  /// The smallest achievable maximum cost is found by bisection, using a
+  /// greedy packing of the segments to test feasibility. The segment
+  /// boundaries are then placed as close as possible to an even division of
+  /// the total cost without exceeding that maximum.
   ///
   /// \param num_ranks - the number of localities to divide between
-  /// \param global - the global counts
+  /// \param global - the global counts, followed by the estimated costs
   /// \param len - the number of unform grid nodes
   ///
   /// \returns - the distribution
-  static int *distribute_points(int num_ranks, const int *global, int len) {
+  static int *distribute_points(int num_ranks, const size_t *global,
+                                int len) {
     int *ret = new int[num_ranks]();
 
-    const int *s = global; // Source counts
-    const int *t = &global[len]; // Target counts
+    const size_t *s = global; // Source counts
+    const size_t *t = &global[len]; // Target counts
+    const size_t *c = &global[2 * len]; // Estimated costs
+
+    int64_t total_points = 0;
+    int64_t total_cost = 0;
+    for (int i = 0; i < len; ++i) {
+      total_points += s[i] + t[i];
+      total_cost += c[i];
+    }
+    bool use_cost = total_cost > 0 && total_points > 0;
+    double point_cost = use_cost ? (double)total_cost / total_points : 1.0;
+
+    std::vector<int64_t> cumulative(len + 1);
+    cumulative[0] = 0;
+    int64_t largest = 0;
+    for (int i = 1; i <= len; ++i) {
+      int64_t w = s[i - 1] + t[i - 1];
+      if (use_cost) {
+        w = std::max((int64_t)c[i - 1], (int64_t)ceil(w * point_cost));
+      }
+      largest = std::max(largest, w);
+      cumulative[i] = w + cumulative[i - 1];
+    }
+    int64_t total = cumulative[len];
+
+    // The last boundary reachable from start with a segment of cost at most
+    // bound.
+    auto reach = [&cumulative] (int start, int64_t bound) -> int {
+      auto end = std::upper_bound(cumulative.begin() + start, cumulative.end(),
+                                  cumulative[start] + bound);
+      return (end - cumulative.begin()) - 1;
+    };
+
+    int64_t lo = largest;
+    int64_t hi = std::max(total, largest);
+    while (lo < hi) {
+      int64_t mid = lo + (hi - lo) / 2;
+      int n_segments = 0;
+      for (int start = 0; start < len && n_segments <= num_ranks;
+           start = reach(start, mid)) {
+        ++n_segments;
+      }
+      if (n_segments <= num_ranks) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    int64_t bound = lo;
+
+    // earliest[k] is the first boundary from which the remaining nodes can
+    // be covered by k segments.
+    std::vector<int> earliest(num_ranks + 1);
+    earliest[0] = len;
+    for (int k = 1; k <= num_ranks; ++k) {
+      int64_t need = cumulative[earliest[k - 1]] - bound;
+      earliest[k] = std::lower_bound(cumulative.begin(), cumulative.end(),
+                                     need) - cumulative.begin();
+    }
+    assert(earliest[num_ranks] == 0);
+
+    int start = 0;
+    for (int split = 1; split < num_ranks; ++split) {
+      int64_t my_target = total * split / num_ranks;
+      int splitter = std::lower_bound(cumulative.begin(), cumulative.end(),
+                                      my_target) - cumulative.begin();
+      if (splitter > 0 && my_target - cumulative[splitter - 1]
+                            <= cumulative[splitter] - my_target) {
+        --splitter;
+      }
+      int lower = std::max(start, earliest[num_ranks - split]);
+      int upper = reach(start, bound);
+      assert(lower <= upper);
+      splitter = std::min(std::max(splitter, lower), upper);
+
+      ret[split - 1] = splitter - 1;
+      start = splitter;
+    }
+    ret[num_ranks - 1] = len - 1;
+
+    return ret;
+  }
+
+  /// Generate the mapping from uniform grid node to locality
+  ///
+  /// \param num_ranks - the number of localities
+  void generate_rank_map(int num_ranks) {
+    rank_map_ = new int [dim3_];
+    assert(rank_map_);
+
+    for (int i = 0; i < num_ranks; ++i) {
+      int b = first(i);
+      int e = last(i);
+      for (int j = b; j <= e; ++j) {
+        rank_map_[j] = i;
+      }
+    }
+  }
+
+  /// Set the partitioning threshold of each branch of the trees
+  ///
+  /// Normally, every branch of the source tree is refined until its leaves
+  /// hold no more than refinement_limit() sources, and every branch of the
+  /// target tree until its leaves hold no more than target_limit() targets.
+  ///
+  /// If the thresholds are adaptive, a branch of one tree is refined only
+  /// while that pays off given the density of the other tree. The direct
+  /// interactions of a leaf are taken to be its number of records times the
+  /// number of records of the other tree in the same region. Leaves holding
+  /// a number of sources and of targets equal to the thresholds are taken to
+  /// strike the right balance between these and the operations on the
+  /// expansions, so a leaf with n records is not split further when n times
+  /// the number of records of the other tree expected in its region is no
+  /// more than the product of the thresholds. The expected number is found
+  /// from the ratio of the densities of the two trees in the uniform grid
+  /// node of the branch and its neighbors. Where the other tree is sparse,
+  /// the leaves are thus larger, and there are fewer nodes and operations.
+  /// The threshold of a branch is never smaller than the threshold of its
+  /// tree, and never larger by more than kMaxLimitScale.
+  ///
+  /// This must be called once the uniform grid counts are known, and before
+  /// any branch is partitioned. The thresholds are kept for the lifetime of
+  /// the tree, including any update().
+  void set_leaf_limits() {
+    std::vector<int> slimit(dim3_, refinement_limit_);
+    std::vector<int> tlimit(dim3_, target_limit_);
+
+    if (adaptive_ && !same_sandt_) {
+      int dim = pow(2, unif_level_);
+      const int *scount = unif_count_src();
+      const int *tcount = unif_count_tar();
+      double product = (double)refinement_limit_ * target_limit_;
+
+      auto adapt = [product] (int limit, double mine, double other) {
+        double scaled = (double)limit * kMaxLimitScale;
+        if (other > 0.0) {
+          scaled = std::min(scaled, sqrt(product * mine / other));
+        }
+        scaled = std::min(scaled, (double)std::numeric_limits<int>::max());
+        return std::max(limit, static_cast<int>(scaled));
+      };
+
+      for (int x = 0; x < dim; ++x) {
+        for (int y = 0; y < dim; ++y) {
+          for (int z = 0; z < dim; ++z) {
+            // Count the records in the node and its neighbors
+            double ns{0.0};
+            double nt{0.0};
+            for (int i = std::max(x - 1, 0); i <= std::min(x + 1, dim - 1);
+                 ++i) {
+              for (int j = std::max(y - 1, 0); j <= std::min(y + 1, dim - 1);
+                   ++j) {
+                for (int k = std::max(z - 1, 0);
+                     k <= std::min(z + 1, dim - 1); ++k) {
+                  int id = morton_key(i, j, k);
+                  ns += scount[id];
+                  nt += tcount[id];
+                }
+              }
+            }
+
+            int id = morton_key(x, y, z);
+            slimit[id] = adapt(refinement_limit_, ns, nt);
+            tlimit[id] = adapt(target_limit_, nt, ns);
+          }
+        }
+      }
+    }
+
+    source_tree_->set_leaf_limits(slimit);
+    target_tree_->set_leaf_limits(tlimit);
+  }
+
+  /// The largest grouped segment in the global address space, in bytes
+  ///
+  /// The block size of the global address space is 32 bits. A rank with
+  /// more grouped points than this sends them in parcels instead; see
+  /// sort_local_points().
+  static constexpr size_t kMaxGroupedBytes =
+      std::numeric_limits<uint32_t>::max();
+
+  /// Allocate a segment of the global address space for grouped points
+  ///
+  /// The segment is a single block allocated on the calling rank, so that
+  /// any range of its records can be read with one memget. The block remains
+  /// pinned until it is freed with free_grouped_segment(). The segment must
+  /// be no larger than kMaxGroupedBytes. A failure to allocate or pin the
+  /// block stops the program.
+  ///
+  /// \param n - the number of records
+  /// \param gas [out] - the global address of the segment
+  ///
+  /// \returns - the local address of the segment; nullptr if @p n is zero
+  template <typename R>
+  static R *alloc_grouped_segment(size_t n, hpx_addr_t *gas) {
+    *gas = HPX_NULL;
+    if (n == 0) {
+      return nullptr;
+    }
+    assert(sizeof(R) * n <= kMaxGroupedBytes);
+    *gas = hpx_gas_alloc_local(1, sizeof(R) * n, 0);
+    R *retval{nullptr};
+    if (*gas == HPX_NULL || !hpx_gas_try_pin(*gas, (void **)&retval)) {
+      fprintf(stderr, "Unable to allocate %zu bytes of grouped points\n",
+              sizeof(R) * n);
+      exit(-1);
+    }
+    return retval;
+  }
+
+  /// Free a segment allocated with alloc_grouped_segment()
+  ///
+  /// \param gas [in,out] - the global address of the segment; reset to
+  ///                       HPX_NULL
+  static void free_grouped_segment(hpx_addr_t *gas) {
+    if (*gas != HPX_NULL) {
+      hpx_gas_unpin(*gas);
+      hpx_gas_free_sync(*gas);
+      *gas = HPX_NULL;
+    }
+  }
+
+  /// Count and sort the local points
+  ///
+  /// This will assign the local points to the uniform grid, and it will also
+  /// group them according to which node of the uniform grid. This will
+  /// ultimately return the local counts per uniform grid node which will later
+  /// be combined into a global count. The returned counts are allocated in
+  /// this routine; the caller assumes ownership of the returned array.
+  ///
+  /// The points are grouped with a counting sort in two passes over the
+  /// records. The first finds the uniform grid node of each record and counts
+  /// the records in each node; the second scatters the records directly into
+  /// new segments, and @p p_s and @p p_t are updated to point to those
+  /// segments. The counts must be complete before any record can be placed,
+  /// so the passes cannot be fused. The original segments
+  /// are left unchanged. The new segments are allocated as the segments of an
+  /// Array are, unless DASHMM_ZERO_COPY_EXCHANGE is defined, in which case
+  /// they are in the global address space so that other ranks can read them
+  /// directly. As a segment of the global address space is limited to
+  /// kMaxGroupedBytes, a rank with more points than that allocates its
+  /// segments as in the copying mode, and sends its points in parcels; this
+  /// is recorded in grouped_in_gas_.
+  ///
+  /// \param tree - the dual tree
+  /// \param p_s [in,out] - the source data
+  /// \param n_sources - the number of sources
+  /// \param p_t [in,out] - the target data
+  /// \param n_targets - the number of targets
+  /// \param local_offset_s - array that will be allocated and filled with the
+  ///                         local offsets for the sources
+  /// \param local_offset_t - array that will be allocated and filled with the
+  ///                         local offsets for the targets
+  /// \param unif_cost - the estimated cost of the uniform grid nodes owned by
+  ///                    this rank; nullptr if there is none
+  ///
+  /// \returns - the local source counts per uniform grid node, followed by
+  ///            the target counts
+  static int *sort_local_points(DualTree *tree, source_t **p_s,
+                                int n_sources, target_t **p_t, int n_targets,
+                                int **local_offset_s, int **local_offset_t,
+                                const int64_t *unif_cost) {
+    int *local_count = new int[tree->dim3_ * 2]();
+    int *local_scount = local_count;
+    int *local_tcount = &local_count[tree->dim3_];
+
+    int *gid_of_sources = new int[n_sources]();
+    int *gid_of_targets = new int[n_targets]();
+
+    // Space for the per chunk counts
+    int n_chunks_s = sourcetree_t::unif_grid_chunks(n_sources);
+    int n_chunks_t = targettree_t::unif_grid_chunks(n_targets);
+    int *chunk_scount = new int[n_chunks_s * tree->dim3_]();
+    int *chunk_tcount = new int[n_chunks_t * tree->dim3_]();
+
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t assign_begin = hpx_time_now();
+#endif
+
+    // Assign points to the grid
+    sourcetree_t::count_points_on_unif_grid(*p_s, n_sources, &tree->domain_,
+                                            tree->unif_level_, tree->dim3_,
+                                            gid_of_sources, chunk_scount,
+                                            local_scount);
+    targettree_t::count_points_on_unif_grid(*p_t, n_targets, &tree->domain_,
+                                            tree->unif_level_, tree->dim3_,
+                                            gid_of_targets, chunk_tcount,
+                                            local_tcount);
+
+    // Exchange counts, along with the estimated costs. These are reduced as
+    // size_t, as a cost may not fit in an int.
+    std::vector<size_t> reduced(tree->dim3_ * 3, 0);
+    std::copy(local_count, &local_count[tree->dim3_ * 2], reduced.begin());
+    if (unif_cost != nullptr) {
+      std::copy(unif_cost, &unif_cost[tree->dim3_],
+                &reduced[tree->dim3_ * 2]);
+    }
+    hpx_lco_set(tree->unif_count_, sizeof(size_t) * tree->dim3_ * 3,
+                reduced.data(), HPX_NULL, HPX_NULL);
+
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t group_begin = hpx_time_now();
+#endif
+
+    // Group points on the same grid
+    source_t *grouped_s{nullptr};
+    target_t *grouped_t{nullptr};
+    tree->grouped_in_gas_ = false;
+#ifdef DASHMM_ZERO_COPY_EXCHANGE
+    tree->grouped_in_gas_ =
+        sizeof(source_t) * (size_t)n_sources <= kMaxGroupedBytes
+        && (tree->same_sandt_
+            || sizeof(target_t) * (size_t)n_targets <= kMaxGroupedBytes);
+#endif
+    if (tree->grouped_in_gas_) {
+      grouped_s = alloc_grouped_segment<source_t>(n_sources,
+                                                  &tree->grouped_src_);
+      if (!tree->same_sandt_) {
+        grouped_t = alloc_grouped_segment<target_t>(n_targets,
+                                                    &tree->grouped_tar_);
+      }
+    } else {
+      grouped_s = reinterpret_cast<source_t *>(
+                      new char[sizeof(source_t) * n_sources]);
+      if (!tree->same_sandt_) {
+        grouped_t = reinterpret_cast<target_t *>(
+                        new char[sizeof(target_t) * n_targets]);
+      }
+    }
+    sourcetree_t::group_points_on_unif_grid(*p_s, n_sources, tree->dim3_,
+                                            gid_of_sources, local_scount,
+                                            chunk_scount, local_offset_s,
+                                            grouped_s);
+    // Only reorder targets if the sources and targets are different
+    if (!tree->same_sandt_) {
+      targettree_t::group_points_on_unif_grid(*p_t, n_targets, tree->dim3_,
+                                              gid_of_targets, local_tcount,
+                                              chunk_tcount, local_offset_t,
+                                              grouped_t);
+    }
+
+    if (grouped_s != nullptr) {
+      *p_s = grouped_s;
+      if (tree->same_sandt_) {
+        *p_t = reinterpret_cast<target_t *>(grouped_s);
+      }
+    }
+    if (grouped_t != nullptr) {
+      *p_t = grouped_t;
+    }
+
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t group_end = hpx_time_now();
+
+    // The bounding box and the counting each read every record, and the
+    // scatter reads it once more and writes it into the new segment, for
+    // four transfers of each record. The uniform grid index of each record
+    // is written by the counting and read by the scatter.
+    size_t n_points = n_sources + (tree->same_sandt_ ? 0 : n_targets);
+    size_t touched = n_sources * (4 * sizeof(source_t) + 2 * sizeof(int));
+    if (!tree->same_sandt_) {
+      touched += n_targets * (4 * sizeof(target_t) + 2 * sizeof(int));
+    }
+    fprintf(stdout, "Sort local points: %d - threads %d - assign %lg - "
+            "group %lg [us] - %lg bytes per point\n", hpx_get_my_rank(),
+            hpx_get_num_threads(),
+            hpx_time_diff_us(assign_begin, group_begin),
+            hpx_time_diff_us(group_begin, group_end),
+            n_points ? (double)touched / n_points : 0.0);
+#endif
+
+    delete [] gid_of_sources;
+    delete [] gid_of_targets;
+    delete [] chunk_scount;
+    delete [] chunk_tcount;
+
+    return local_count;
+  }
+
+  /// Merge incoming points into the sorted list and spawns adapative paritition
+  ///
+  /// This action is the 'far side' of the send points message. This will
+  /// read the incoming points and merge them with the local data. If the
+  /// uniform grid node to which they belong has received all of the points it
+  /// is waiting for, this routine will then spawn the adaptive partitioning
+  /// of that branch.
+  ///
+  /// This is a marshalled action, and so the message data is rather opaque.
+  ///
+  /// \param args - a buffer containing the incoming message.
+  /// \parma UNUSED - the size of the message.
+  static int recv_points_handler(void *args, size_t UNUSED) {
+    hpx_addr_t *rwarg = static_cast<hpx_addr_t *>(args);
+    RankWise<dualtree_t> global_tree{*rwarg};
+    auto local_tree = global_tree.here();
+
+    // Wait until the buffer is allocated before merging incoming messages
+    // We could do this as a call when, but then we need to be aware of the
+    // addresses for every rank's LCO. For now, we do this, as it is simpler.
+    sourcetree_t *stree = local_tree->source_tree_;
+    targettree_t *ttree = local_tree->target_tree_;
+    hpx_lco_wait(stree->unif_done_);
+    hpx_lco_wait(ttree->unif_done_);
+
+    int *meta = reinterpret_cast<int *>(static_cast<char *>(args)
+                                        + sizeof(hpx_addr_t));
+    int first = meta[0];
+    int last = meta[1];
+    int range = last - first + 1;
+    int recv_ns = meta[2];
+    int recv_nt = meta[3];
+    int *count_s = &meta[4]; // Used only if recv_ns > 0
+    int *count_t = count_s + range * (recv_ns > 0); // Used only if recv_nt > 0
+    source_t *recv_s =
+      reinterpret_cast<source_t *>(static_cast<char *>(args) + sizeof(int) * 4 +
+                                sizeof(hpx_addr_t) +
+                                sizeof(int) * range * (recv_ns > 0) +
+                                sizeof(int) * range * (recv_nt > 0));
+    target_t *recv_t = reinterpret_cast<target_t *>(recv_s + recv_ns);
+
+    hpx_addr_t done = hpx_lco_and_new(range * 2);
+
+    if (recv_ns) {
+      for (int i = first; i <= last; ++i) {
+        int incoming_ns = count_s[i - first];
+        if (incoming_ns) {
+          sourcenode_t *ns = &stree->unif_grid_[i];
+          hpx_call(HPX_HERE, sourcetree_t::merge_points_, done,
+                   &recv_s, &ns, &incoming_ns, rwarg, &stree);
+          recv_s += incoming_ns;
+        } else {
+          hpx_lco_and_set(done, HPX_NULL);
+        }
+      }
+    } else {
+      if (range) {
+        hpx_lco_and_set_num(done, range, HPX_NULL);
+      }
+    }
+
+    if (recv_nt) {
+      for (int i = first; i <= last; ++i) {
+        int incoming_nt = count_t[i - first];
+        if (incoming_nt) {
+          targetnode_t *nt = &ttree->unif_grid_[i];
+          hpx_call(HPX_HERE, targettree_t::merge_points_, done,
+                   &recv_t, &nt, &incoming_nt, rwarg, &ttree);
+          recv_t += incoming_nt;
+        } else {
+          hpx_lco_and_set(done, HPX_NULL);
+        }
+      }
+    } else {
+      if (local_tree->same_sandt_ && recv_ns) {
+        // S == T means do a special version of merge.
+        for (int i = first; i <= last; ++i) {
+          int incoming_nt = count_s[i - first];
+          if (incoming_nt) {
+            targetnode_t *nt = &ttree->unif_grid_[i];
+            sourcenode_t *ns = &stree->unif_grid_[i];
+            hpx_call(HPX_HERE, targettree_t::merge_points_same_s_and_t_,
+                     done, &nt, &incoming_nt, &ns, rwarg, &ttree);
+          } else {
+            hpx_lco_and_set(done, HPX_NULL);
+          }
+        }
+      } else {
+        if (range) {
+          hpx_lco_and_set_num(done, range, HPX_NULL);
+        }
+      }
+    }
+
+    // Wait until the data has been merged before releasing the parcel
+    // NOTE: This 'done' will trigger once points are merged. The action that
+    // triggers this will spawn more work, but not in a synchronous way.
+    hpx_lco_wait(done);
+    hpx_lco_delete_sync(done);
+    return HPX_SUCCESS;
+  }
+
+  /// Send a parcel of points to the remote that will assume ownership
+  ///
+  /// The points sent are for the uniform grid nodes @p first through
+  /// @p last, and the counts give the number of points sent for each of those
+  /// nodes. These need not be all of the points in those nodes. The receiver
+  /// merges the points with recv_points_. If @p sema is provided, the
+  /// semaphore is signaled once the points have been merged.
+  ///
+  /// \param rank - the rank to which we are sending
+  /// \param first - the first uniform grid node with points in the parcel
+  /// \param last - the last uniform grid node with points in the parcel
+  /// \param count_s - the source counts for nodes first through last
+  /// \param count_t - the target counts for nodes first through last
+  /// \param send_ns - the total number of sources
+  /// \param send_nt - the total number of targets
+  /// \param sources - the source data
+  /// \param targets - the target data
+  /// \param rwaddr - the global address of the dual tree
+  /// \param sema - optional semaphore to signal when merged
+  static void send_points_parcel(int rank, int first, int last,
+                                 const int *count_s, const int *count_t,
+                                 int send_ns, int send_nt,
+                                 const source_t *sources,
+                                 const target_t *targets,
+                                 hpx_addr_t rwaddr, hpx_addr_t sema) {
+    int range = last - first + 1;
+
+    // Parcel message length
+    size_t bytes = sizeof(hpx_addr_t) + sizeof(int) * 4;
+    if (send_ns) {
+      bytes += sizeof(int) * range + sizeof(source_t) * send_ns;
+    }
+    if (send_nt) {
+      bytes += sizeof(int) * range + sizeof(target_t) * send_nt;
+    }
+
+    // Acquire parcel
+    hpx_parcel_t *p = hpx_parcel_acquire(nullptr, bytes);
+    void *data = hpx_parcel_get_data(p);
+    hpx_addr_t *rwarg = static_cast<hpx_addr_t *>(data);
+    *rwarg = rwaddr;
+    int *meta = reinterpret_cast<int *>(
+                              static_cast<char *>(data) + sizeof(hpx_addr_t));
+    meta[0] = first;
+    meta[1] = last;
+    meta[2] = send_ns;
+    meta[3] = send_nt;
+
+    int *count = &meta[4];
+    if (send_ns) {
+      memcpy(count, count_s, sizeof(int) * range);
+      count += range;
+    }
+
+    if (send_nt) {
+      memcpy(count, count_t, sizeof(int) * range);
+    }
+
+    char *meta_s = static_cast<char *>(data) + sizeof(hpx_addr_t) +
+      sizeof(int) * (4 + range * (send_ns > 0) + range * (send_nt > 0));
+    if (send_ns) {
+      memcpy(meta_s, sources, sizeof(source_t) * send_ns);
+    }
+
+    char *meta_t = meta_s + send_ns * sizeof(source_t);
+    if (send_nt) {
+      memcpy(meta_t, targets, sizeof(target_t) * send_nt);
+    }
+
+    hpx_parcel_set_target(p, HPX_THERE(rank));
+    hpx_parcel_set_action(p, recv_points_);
+    if (sema != HPX_NULL) {
+      hpx_parcel_set_cont_target(p, sema);
+      hpx_parcel_set_cont_action(p, hpx_lco_set_action);
+    }
+    hpx_parcel_send(p, HPX_NULL);
+  }
+
+  /// Send points to a remote in a number of bounded parcels
+  ///
+  /// This walks through the points for uniform grid nodes @p first through
+  /// @p last, sending them in parcels of at most @p max_records points. A
+  /// uniform grid node may be split across parcels. Before each parcel is
+  /// sent, a slot is taken from @p sema; the slot is returned once the
+  /// receiver has merged those points. This bounds the number of bytes in
+  /// flight from this rank.
+  ///
+  /// \param rank - the rank to which we are sending
+  /// \param first - the first uniform grid node to send
+  /// \param last - the last uniform grid node to send
+  /// \param count - the counts per uniform grid node
+  /// \param data - the points for node @p first and onward
+  /// \param max_records - the maximum number of points per parcel
+  /// \param rwaddr - the global address of the dual tree
+  /// \param sema - the semaphore bounding the parcels in flight
+  template <typename R>
+  static void send_points_in_chunks(int rank, int first, int last,
+                                    const int *count, const R *data,
+                                    int max_records, hpx_addr_t rwaddr,
+                                    hpx_addr_t sema) {
+    std::vector<int> chunk_count{};
+    int cell = first;
+    int sent_in_cell = 0;
+    while (cell <= last) {
+      int chunk_first = cell;
+      int n_chunk = 0;
+      chunk_count.clear();
+      while (cell <= last && n_chunk < max_records) {
+        int take = std::min(count[cell] - sent_in_cell,
+                            max_records - n_chunk);
+        chunk_count.push_back(take);
+        n_chunk += take;
+        sent_in_cell += take;
+        if (sent_in_cell < count[cell]) {
+          break;
+        }
+        ++cell;
+        sent_in_cell = 0;
+      }
+
+      if (n_chunk == 0) {
+        continue;
+      }
+
+      int chunk_last = chunk_first + (int)chunk_count.size() - 1;
+      hpx_lco_sema_p(sema);
+      if (std::is_same<R, source_t>::value) {
+        send_points_parcel(rank, chunk_first, chunk_last, chunk_count.data(),
+                           nullptr, n_chunk, 0,
+                           reinterpret_cast<const source_t *>(data), nullptr,
+                           rwaddr, sema);
+      } else {
+        send_points_parcel(rank, chunk_first, chunk_last, nullptr,
+                           chunk_count.data(), 0, n_chunk, nullptr,
+                           reinterpret_cast<const target_t *>(data),
+                           rwaddr, sema);
+      }
+      data += n_chunk;
+    }
+  }
+
+  /// Send the points to the remote that will assume ownership
+  ///
+  /// This action sends points to remote localities that have been assigned
+  /// the points during distribution. If DASHMM_EXCHANGE_BUDGET is defined,
+  /// the points are sent in a stream of smaller parcels, with at most that
+  /// many bytes in flight from this rank at a time, as controlled by @p sema.
+  ///
+  /// \param rank - the rank to which we are sending
+  /// \param count_s - the source counts
+  /// \param count_t - that target counts
+  /// \param offset_s - the source offsets
+  /// \param offset_t - the target offsets
+  /// \param sources - the source data
+  /// \param targets - the target data
+  /// \param rwaddr - the global address of the dual tree
+  /// \param sema - semaphore bounding the bytes in flight
+  static int send_points_handler(int rank, int *count_s, int *count_t,
+                                 int *offset_s, int *offset_t,
+                                 source_t *sources, target_t *targets,
+                                 hpx_addr_t rwaddr, hpx_addr_t sema) {
+    RankWise<dualtree_t> global_tree{rwaddr};
+    auto local_tree = global_tree.here();
+
+    // Note: all the pointers are local to the calling rank.
+    int first = local_tree->first(rank);
+    int last = local_tree->last(rank);
+    int send_ns = 0;
+    int send_nt = 0;
+    for (int i = first; i <= last; ++i) {
+      send_ns += count_s[i];
+      send_nt += count_t[i];
+    }
+
+    // Clear out the target sends if S == T
+    if (local_tree->same_sandt_) {
+      send_nt = 0;
+    }
+
+#ifdef DASHMM_EXCHANGE_BUDGET
+    // There is no budget if the points could not be offered in the zero-copy
+    // mode, in which case they are sent whole as well.
+    if (sema == HPX_NULL) {
+      const source_t *s = send_ns ? &sources[offset_s[first]] : nullptr;
+      const target_t *t = send_nt ? &targets[offset_t[first]] : nullptr;
+      send_points_parcel(rank, first, last, &count_s[first], &count_t[first],
+                         send_ns, send_nt, s, t, rwaddr, sema);
+      return HPX_SUCCESS;
+    }
+
+    size_t chunk_bytes = (size_t)(DASHMM_EXCHANGE_BUDGET) / kExchangeSlots;
+    if (send_ns) {
+      int max_records = std::max(chunk_bytes / sizeof(source_t), (size_t)1);
+      send_points_in_chunks(rank, first, last, count_s,
+                            &sources[offset_s[first]], max_records, rwaddr,
+                            sema);
+    }
+    if (send_nt) {
+      int max_records = std::max(chunk_bytes / sizeof(target_t), (size_t)1);
+      send_points_in_chunks(rank, first, last, count_t,
+                            &targets[offset_t[first]], max_records, rwaddr,
+                            sema);
+    }
+#else
+    const source_t *s = send_ns ? &sources[offset_s[first]] : nullptr;
+    const target_t *t = send_nt ? &targets[offset_t[first]] : nullptr;
+    send_points_parcel(rank, first, last, &count_s[first], &count_t[first],
+                       send_ns, send_nt, s, t, rwaddr, sema);
+#endif
+
+    return HPX_SUCCESS;
+  }
+
+  /// Offer the points to the remote that will assume ownership
+  ///
+  /// This is the zero-copy counterpart of send_points_. Instead of copying the
+  /// points into a parcel, this sends the global address of the grouped
+  /// points, along with the counts, to the remote rank. The remote rank will
+  /// then read the points directly into its sorted segments, and set
+  /// @p pulled once it has read them all.
+  ///
+  /// \param rank - the rank to which we are sending
+  /// \param count_s - the source counts
+  /// \param count_t - that target counts
+  /// \param offset_s - the source offsets
+  /// \param offset_t - the target offsets
+  /// \param rwaddr - the global address of the dual tree
+  /// \param pulled - LCO to set once the points are read
+  ///
+  /// \returns - HPX_SUCCESS
+  static int offer_points_handler(int rank, int *count_s, int *count_t,
+                                  int *offset_s, int *offset_t,
+                                  hpx_addr_t rwaddr, hpx_addr_t pulled) {
+    RankWise<dualtree_t> global_tree{rwaddr};
+    auto local_tree = global_tree.here();
 
-    int *cumulative = new int[len + 1];
-    cumulative[0] = 0;
-    for (int i = 1; i <= len; ++i) {
-      cumulative[i] = s[i-1] + t[i-1] + cumulative[i - 1];
+    int first = local_tree->first(rank);
+    int last = local_tree->last(rank);
+    int range = last - first + 1;
+    int send_ns = 0;
+    int send_nt = 0;
+    for (int i = first; i <= last; ++i) {
+      send_ns += count_s[i];
+      send_nt += count_t[i];
     }
 
-    int target_share = cumulative[len] / num_ranks;
-
-    for (int split = 1; split < num_ranks; ++split) {
-      int my_target = target_share * split;
-      auto fcn = [&my_target] (const int &a) -> bool {return a < my_target;};
-      int *splitter = std::partition_point(cumulative, &cumulative[len + 1],
-                                           fcn);
-      int upper_delta = *splitter - my_target;
-      assert(upper_delta >= 0);
-      int lower_delta = my_target - *(splitter - 1);
-      assert(lower_delta >= 0);
-      int split_index = upper_delta < lower_delta
-                          ? splitter - cumulative
-                          : (splitter - cumulative) - 1;
-      --split_index;
-      assert(split_index >= 0);
-
-      ret[split - 1] = split_index;
+    // Clear out the target sends if S == T
+    if (local_tree->same_sandt_) {
+      send_nt = 0;
     }
-    ret[num_ranks - 1] = len - 1;
-
-    delete [] cumulative;
-
-    return ret;
-  }
 
-  /// Generate the mapping from uniform grid node to locality
-  ///
-  /// \param num_ranks - the number of localities
-  void generate_rank_map(int num_ranks) {
-    rank_map_ = new int [dim3_];
-    assert(rank_map_);
+    // Each grouped segment is one block, whose size is needed to find the
+    // address of any record in it
+    size_t block_s = 0;
+    size_t block_t = 0;
+    for (int i = 0; i < local_tree->dim3_; ++i) {
+      block_s += count_s[i];
+      block_t += count_t[i];
+    }
+    block_s *= sizeof(source_t);
+    block_t *= sizeof(target_t);
 
-    for (int i = 0; i < num_ranks; ++i) {
-      int b = first(i);
-      int e = last(i);
-      for (int j = b; j <= e; ++j) {
-        rank_map_[j] = i;
-      }
+    size_t bytes = sizeof(hpx_addr_t) * 3 + sizeof(size_t) * 2
+                   + sizeof(int) * 4;
+    if (send_ns) {
+      bytes += sizeof(int) * range;
+    }
+    if (send_nt) {
+      bytes += sizeof(int) * range;
     }
-  }
 
-  /// Count and sort the local points
-  ///
-  /// This will assign the local points to the uniform grid, and it will also
-  /// rearrange them according to which node of the uniform grid. This will
-  /// ultimately return the local counts per uniform grid node which will later
-  /// be combined into a global count. The returned counts are allocated in
-  /// this routine; the caller assumes ownership of the returned array.
-  ///
-  /// \param tree - the dual tree
-  /// \param p_s - the source data
-  /// \param n_sources - the number of sources
-  /// \param p_t - the target data
-  /// \param n_targets - the number of targets
-  /// \param local_offset_s - array that will be allocated and filled with the
-  ///                         local offsets for the sources
-  /// \param local_offset_t - array that will be allocated and filled with the
-  ///                         local offsets for the targets
-  ///
-  /// \returns - the local counts per uniform grid node
-  static int *sort_local_points(DualTree *tree, source_t *p_s,
-                                int n_sources, target_t *p_t, int n_targets,
-                                int **local_offset_s, int **local_offset_t) {
-    int *local_count = new int[tree->dim3_ * 2]();
-    int *local_scount = local_count;
-    int *local_tcount = &local_count[tree->dim3_];
+    hpx_parcel_t *p = hpx_parcel_acquire(nullptr, bytes);
+    void *data = hpx_parcel_get_data(p);
+    hpx_addr_t *addrs = static_cast<hpx_addr_t *>(data);
+    addrs[0] = rwaddr;
+    addrs[1] = HPX_NULL;
+    addrs[2] = HPX_NULL;
+    if (send_ns) {
+      addrs[1] = hpx_addr_add(local_tree->grouped_src_,
+                              sizeof(source_t) * offset_s[first], block_s);
+    }
+    if (send_nt) {
+      addrs[2] = hpx_addr_add(local_tree->grouped_tar_,
+                              sizeof(target_t) * offset_t[first], block_t);
+    }
 
-    int *gid_of_sources = new int[n_sources]();
-    int *gid_of_targets = new int[n_targets]();
+    size_t *blocks = reinterpret_cast<size_t *>(&addrs[3]);
+    blocks[0] = block_s;
+    blocks[1] = block_t;
 
-    // Assign points to the grid
-    hpx_addr_t assign_done = hpx_lco_and_new(2);
-    assert(assign_done != HPX_NULL);
-    DomainGeometry *domarg = &tree->domain_;
-    hpx_call(HPX_HERE, sourcetree_t::assign_points_, assign_done,
-             &p_s, &n_sources, &domarg, &tree->unif_level_,
-             &gid_of_sources, &local_scount);
-    hpx_call(HPX_HERE, targettree_t::assign_points_, assign_done,
-             &p_t, &n_targets, &domarg, &tree->unif_level_,
-             &gid_of_targets, &local_tcount);
-    hpx_lco_wait(assign_done);
-    hpx_lco_delete_sync(assign_done);
-
-    // Exchange counts
-    hpx_lco_set(tree->unif_count_, sizeof(int) * tree->dim3_ * 2, local_count,
-                HPX_NULL, HPX_NULL);
+    int *meta = reinterpret_cast<int *>(&blocks[2]);
+    meta[0] = first;
+    meta[1] = last;
+    meta[2] = send_ns;
+    meta[3] = send_nt;
 
-    // Group points on the same grid
-    hpx_addr_t group_done = hpx_lco_and_new(2);
-    assert(group_done != HPX_NULL);
-    hpx_call(HPX_HERE, sourcetree_t::group_points_, group_done,
-             &p_s, &n_sources, &tree->dim3_, &gid_of_sources, &local_scount,
-             &local_offset_s);
-    // Only reorder targets if the sources and targets are different
-    if (!tree->same_sandt_) {
-      hpx_call(HPX_HERE, targettree_t::group_points_, group_done,
-               &p_t, &n_targets, &tree->dim3_, &gid_of_targets, &local_tcount,
-               &local_offset_t);
-    } else {
-      hpx_lco_and_set(group_done, HPX_NULL);
+    int *count = &meta[4];
+    if (send_ns) {
+      memcpy(count, &count_s[first], sizeof(int) * range);
+      count += range;
+    }
+    if (send_nt) {
+      memcpy(count, &count_t[first], sizeof(int) * range);
     }
-    hpx_lco_wait(group_done);
-    hpx_lco_delete_sync(group_done);
 
-    delete [] gid_of_sources;
-    delete [] gid_of_targets;
+    hpx_parcel_set_target(p, HPX_THERE(rank));
+    hpx_parcel_set_action(p, recv_offer_);
+    if (pulled != HPX_NULL) {
+      hpx_parcel_set_cont_target(p, pulled);
+      hpx_parcel_set_cont_action(p, hpx_lco_set_action);
+    }
+    hpx_parcel_send(p, HPX_NULL);
 
-    return local_count;
+    return HPX_SUCCESS;
   }
 
-  /// Merge incoming points into the sorted list and spawns adapative paritition
+  /// Pull offered points into the sorted list
   ///
-  /// This action is the 'far side' of the send points message. This will
-  /// read the incoming points and merge them with the local data. If the
-  /// uniform grid node to which they belong has received all of the points it
-  /// is waiting for, this routine will then spawn the adaptive partitioning
-  /// of that branch.
+  /// This action is the 'far side' of the offer points message. For each
+  /// uniform grid node with incoming points, this spawns an action to read
+  /// those points from the global address space of the offering rank. This
+  /// returns once all the points have been read, which sets the continuation
+  /// of the offer; the partitioning of the nodes continues afterwards.
   ///
   /// This is a marshalled action, and so the message data is rather opaque.
   ///
   /// \param args - a buffer containing the incoming message.
-  /// \parma UNUSED - the size of the message.
-  static int recv_points_handler(void *args, size_t UNUSED) {
-    hpx_addr_t *rwarg = static_cast<hpx_addr_t *>(args);
+  /// \param UNUSED - the size of the message.
+  ///
+  /// \returns - HPX_SUCCESS
+  static int recv_offer_handler(void *args, size_t UNUSED) {
+    hpx_addr_t *addrs = static_cast<hpx_addr_t *>(args);
+    hpx_addr_t *rwarg = &addrs[0];
     RankWise<dualtree_t> global_tree{*rwarg};
     auto local_tree = global_tree.here();
 
-    // Wait until the buffer is allocated before merging incoming messages
-    // We could do this as a call when, but then we need to be aware of the
-    // addresses for every rank's LCO. For now, we do this, as it is simpler.
+    // Wait until the buffer is allocated before pulling points
     sourcetree_t *stree = local_tree->source_tree_;
     targettree_t *ttree = local_tree->target_tree_;
     hpx_lco_wait(stree->unif_done_);
     hpx_lco_wait(ttree->unif_done_);
 
-    int *meta = reinterpret_cast<int *>(static_cast<char *>(args)
-                                        + sizeof(hpx_addr_t));
+    size_t *blocks = reinterpret_cast<size_t *>(&addrs[3]);
+    int *meta = reinterpret_cast<int *>(&blocks[2]);
     int first = meta[0];
     int last = meta[1];
     int range = last - first + 1;
@@ -2092,23 +4888,20 @@ class DualTree {
     int recv_nt = meta[3];
     int *count_s = &meta[4]; // Used only if recv_ns > 0
     int *count_t = count_s + range * (recv_ns > 0); // Used only if recv_nt > 0
-    source_t *recv_s =
-      reinterpret_cast<source_t *>(static_cast<char *>(args) + sizeof(int) * 4 +
-                                sizeof(hpx_addr_t) +
-                                sizeof(int) * range * (recv_ns > 0) +
-                                sizeof(int) * range * (recv_nt > 0));
-    target_t *recv_t = reinterpret_cast<target_t *>(recv_s + recv_ns);
 
     hpx_addr_t done = hpx_lco_and_new(range * 2);
 
     if (recv_ns) {
+      size_t offset = 0;
       for (int i = first; i <= last; ++i) {
         int incoming_ns = count_s[i - first];
         if (incoming_ns) {
           sourcenode_t *ns = &stree->unif_grid_[i];
-          hpx_call(HPX_HERE, sourcetree_t::merge_points_, done,
-                   &recv_s, &ns, &incoming_ns, rwarg);
-          recv_s += incoming_ns;
+          hpx_addr_t from = hpx_addr_add(addrs[1], sizeof(source_t) * offset,
+                                         blocks[0]);
+          hpx_call(HPX_HERE, sourcetree_t::pull_points_, done,
+                   &from, &ns, &incoming_ns, rwarg, &stree);
+          offset += incoming_ns;
         } else {
           hpx_lco_and_set(done, HPX_NULL);
         }
@@ -2120,13 +4913,16 @@ class DualTree {
     }
 
     if (recv_nt) {
+      size_t offset = 0;
       for (int i = first; i <= last; ++i) {
         int incoming_nt = count_t[i - first];
         if (incoming_nt) {
           targetnode_t *nt = &ttree->unif_grid_[i];
-          hpx_call(HPX_HERE, targettree_t::merge_points_, done,
-                   &recv_t, &nt, &incoming_nt, rwarg);
-          recv_t += incoming_nt;
+          hpx_addr_t from = hpx_addr_add(addrs[2], sizeof(target_t) * offset,
+                                         blocks[1]);
+          hpx_call(HPX_HERE, targettree_t::pull_points_, done,
+                   &from, &nt, &incoming_nt, rwarg, &ttree);
+          offset += incoming_nt;
         } else {
           hpx_lco_and_set(done, HPX_NULL);
         }
@@ -2140,7 +4936,7 @@ class DualTree {
             targetnode_t *nt = &ttree->unif_grid_[i];
             sourcenode_t *ns = &stree->unif_grid_[i];
             hpx_call(HPX_HERE, targettree_t::merge_points_same_s_and_t_,
-                     done, &nt, &incoming_nt, &ns, rwarg);
+                     done, &nt, &incoming_nt, &ns, rwarg, &ttree);
           } else {
             hpx_lco_and_set(done, HPX_NULL);
           }
@@ -2152,99 +4948,11 @@ class DualTree {
       }
     }
 
-    // Wait until the data has been merged before releasing the parcel
-    // NOTE: This 'done' will trigger once points are merged. The action that
-    // triggers this will spawn more work, but not in a synchronous way.
     hpx_lco_wait(done);
     hpx_lco_delete_sync(done);
     return HPX_SUCCESS;
   }
 
-  /// Send the points to the remote that will assume ownership
-  ///
-  /// This action sends points to remote localities that have been assigned
-  /// the points during distribution.
-  ///
-  /// \param rank - the rank to which we are sending
-  /// \param count_s - the source counts
-  /// \param count_t - that target counts
-  /// \param offset_s - the source offsets
-  /// \param offset_t - the target offsets
-  /// \param sources - the source data
-  /// \param targets - the target data
-  /// \param rwaddr - the global address of the dual tree
-  static int send_points_handler(int rank, int *count_s, int *count_t,
-                                 int *offset_s, int *offset_t,
-                                 source_t *sources, target_t *targets,
-                                 hpx_addr_t rwaddr) {
-    RankWise<dualtree_t> global_tree{rwaddr};
-    auto local_tree = global_tree.here();
-
-    // Note: all the pointers are local to the calling rank.
-    int first = local_tree->first(rank);
-    int last = local_tree->last(rank);
-    int range = last - first + 1;
-    int send_ns = 0;
-    int send_nt = 0;
-    for (int i = first; i <= last; ++i) {
-      send_ns += count_s[i];
-      send_nt += count_t[i];
-    }
-
-    // Clear out the target sends if S == T
-    if (local_tree->same_sandt_) {
-      send_nt = 0;
-    }
-
-    // Parcel message length
-    size_t bytes = sizeof(hpx_addr_t) + sizeof(int) * 4;
-    if (send_ns) {
-      bytes += sizeof(int) * range + sizeof(source_t) * send_ns;
-    }
-    if (send_nt) {
-      bytes += sizeof(int) * range + sizeof(target_t) * send_nt;
-    }
-
-    // Acquire parcel
-    hpx_parcel_t *p = hpx_parcel_acquire(nullptr, bytes);
-    void *data = hpx_parcel_get_data(p);
-    hpx_addr_t *rwarg = static_cast<hpx_addr_t *>(data);
-    *rwarg = rwaddr;
-    int *meta = reinterpret_cast<int *>(
-                              static_cast<char *>(data) + sizeof(hpx_addr_t));
-    meta[0] = first;
-    meta[1] = last;
-    meta[2] = send_ns;
-    meta[3] = send_nt;
-
-    int *count = &meta[4];
-    if (send_ns) {
-      memcpy(count, &count_s[first], sizeof(int) * range);
-      count += range;
-    }
-
-    if (send_nt) {
-      memcpy(count, &count_t[first], sizeof(int) * range);
-    }
-
-    char *meta_s = static_cast<char *>(data) + sizeof(hpx_addr_t) +
-      sizeof(int) * (4 + range * (send_ns > 0) + range * (send_nt > 0));
-    if (send_ns) {
-      memcpy(meta_s, &sources[offset_s[first]], sizeof(source_t) * send_ns);
-    }
-
-    char *meta_t = meta_s + send_ns * sizeof(source_t);
-    if (send_nt) {
-      memcpy(meta_t, &targets[offset_t[first]], sizeof(target_t) * send_nt);
-    }
-
-    hpx_parcel_set_target(p, HPX_THERE(rank));
-    hpx_parcel_set_action(p, recv_points_);
-    hpx_parcel_send(p, HPX_NULL);
-
-    return HPX_SUCCESS;
-  }
-
   /// This will prune links in the top part of the tree that are not needed
   ///
   /// After exchanging counts, there could be some nodes at the uniform level
@@ -2272,6 +4980,105 @@ class DualTree {
     target_tree_->root_->remove_downward_links(unif_level_ - 1, 0);
   }
 
+  /// Exchange the branches of the uniform grid nodes between ranks
+  ///
+  /// Once the branch below a uniform grid node owned by this rank is
+  /// complete, it is sent to every other rank. The branches owned by other
+  /// ranks are received into this rank, after which the completion LCOs of
+  /// those uniform grid nodes are deleted. The uniform counts must be
+  /// available.
+  ///
+  /// During an update, only the branches that have changed are exchanged;
+  /// the others are already in place on every rank.
+  ///
+  /// This is an asynchronous operation. The returned LCO becomes the
+  /// responsibility of the caller.
+  ///
+  /// \param rwtree - the global address of the dual tree
+  /// \param changed - for each uniform grid node of the source tree and
+  ///                  then of the target tree, nonzero if its branch has
+  ///                  changed; nullptr if every branch is exchanged
+  ///
+  /// \returns - an LCO that is set once every branch is in place
+  hpx_addr_t exchange_branches(hpx_addr_t rwtree,
+                               const int *changed = nullptr) {
+    int rank = hpx_get_my_rank();
+    int num_ranks = hpx_get_num_ranks();
+    sourcenode_t *ns = source_tree_->unif_grid_;
+    targetnode_t *nt = target_tree_->unif_grid_;
+
+    hpx_addr_t dual_tree_complete = hpx_lco_and_new(2 * dim3_);
+    assert(dual_tree_complete != HPX_NULL);
+
+    // A branch is exchanged if it has records, and if it has changed
+    auto s_sent = [this, changed](int i) {
+      return *unif_count_src(i) != 0 && (changed == nullptr || changed[i]);
+    };
+    auto t_sent = [this, changed](int i) {
+      return *unif_count_tar(i) != 0
+             && (changed == nullptr || changed[dim3_ + i]);
+    };
+
+    for (int r = 0; r < num_ranks; ++r) {
+      int first = this->first(r);
+      int last = this->last(r);
+
+      if (r == rank) {
+        for (int i = first; i <= last; ++i) {
+          if (!s_sent(i)) {
+            hpx_lco_and_set(dual_tree_complete, HPX_NULL);
+          } else {
+            source_t *arg = sorted_src();
+            int typearg = 0;
+            assert(ns[i].complete() != HPX_NULL);
+            hpx_call_when_with_continuation(ns[i].complete(),
+                HPX_HERE, sourcetree_t::send_node_,
+                dual_tree_complete, hpx_lco_set_action,
+                &ns, &arg, &i, &rwtree, &typearg);
+          }
+
+          if (!t_sent(i)) {
+            hpx_lco_and_set(dual_tree_complete, HPX_NULL);
+          } else {
+            target_t *arg = sorted_tar();
+            int typearg = 1;
+            assert(nt[i].complete() != HPX_NULL);
+            hpx_call_when_with_continuation(nt[i].complete(),
+                HPX_HERE, targettree_t::send_node_,
+                dual_tree_complete, hpx_lco_set_action,
+                &nt, &arg, &i, &rwtree, &typearg);
+          }
+        }
+      } else {
+        for (int i = first; i <= last; ++i) {
+          assert(ns[i].complete() != HPX_NULL);
+          if (!s_sent(i)) {
+            hpx_lco_delete_sync(ns[i].complete());
+            hpx_lco_and_set(dual_tree_complete, HPX_NULL);
+          } else {
+            hpx_call_when_with_continuation(ns[i].complete(),
+                dual_tree_complete, hpx_lco_set_action,
+                ns[i].complete(), hpx_lco_delete_action,
+                nullptr, 0);
+          }
+
+          assert(nt[i].complete() != HPX_NULL);
+          if (!t_sent(i)) {
+            hpx_lco_delete_sync(nt[i].complete());
+            hpx_lco_and_set(dual_tree_complete, HPX_NULL);
+          } else {
+            hpx_call_when_with_continuation(nt[i].complete(),
+                dual_tree_complete, hpx_lco_set_action,
+                nt[i].complete(), hpx_lco_delete_action,
+                nullptr, 0);
+          }
+        }
+      }
+    }
+
+    return dual_tree_complete;
+  }
+
   /// The action responsible for dual tree partitioning
   ///
   /// This action is the target of a broadcast and manages all the work
@@ -2280,17 +5087,30 @@ class DualTree {
   /// \param rwtree - the global address of the dual tree
   /// \param sources_gas - the source data
   /// \param targets_gas - the target data
+  /// \param unif_cost - the estimated costs; see partition()
   ///
   /// \return HPX_SUCCESS
   static int create_dual_tree_handler(hpx_addr_t rwtree,
                                       hpx_addr_t sources_gas,
-                                      hpx_addr_t targets_gas) {
+                                      hpx_addr_t targets_gas,
+                                      hpx_addr_t unif_cost) {
     int rank = hpx_get_my_rank();
     int num_ranks = hpx_get_num_ranks();
 
     RankWise<dualtree_t> global_tree{rwtree};
     auto tree = global_tree.here();
 
+    // The saved cost is only usable for the same points on the same grid
+    RankWise<UnifCost> global_cost{unif_cost};
+    const int64_t *prior_cost{nullptr};
+    if (global_cost.valid()) {
+      auto saved = global_cost.here();
+      if (saved->cost != nullptr && saved->sources == sources_gas
+          && saved->targets == targets_gas && saved->dim3 == tree->dim3_) {
+        prior_cost = saved->cost;
+      }
+    }
+
     Array<source_t> sources{sources_gas};
     Array<target_t> targets{targets_gas};
 
@@ -2306,112 +5126,142 @@ class DualTree {
       // Assign points to uniform grid
       int *local_offset_s{nullptr};
       int *local_offset_t{nullptr};
-      int *local_count = sort_local_points(&*tree, p_s, n_sources,
-                                           p_t, n_targets, &local_offset_s,
-                                           &local_offset_t);
+      int *local_count = sort_local_points(&*tree, &p_s, n_sources,
+                                           &p_t, n_targets, &local_offset_s,
+                                           &local_offset_t, prior_cost);
       int *local_scount = local_count;
       int *local_tcount = &local_count[tree->dim3_];
 
+      // The grouped points are now in new segments, so the original
+      // segments are no longer needed. In the zero-copy mode, the new
+      // segments are in the global address space, and are freed separately.
+      sourceref_t grouped_src{};
+      targetref_t grouped_tar{};
+      if (!tree->grouped_in_gas_) {
+        grouped_src = sourceref_t{p_s, (size_t)n_sources};
+        grouped_tar = targetref_t{p_t, (size_t)n_targets};
+      }
+      delete [] sources.replace(grouped_src);
+      if (!tree->same_sandt_) {
+        delete [] targets.replace(grouped_tar);
+      }
+
       // Compute point distribution
-      hpx_lco_get(tree->unif_count_, sizeof(int) * (tree->dim3_ * 2),
-                  tree->unif_count_src());
-      tree->distribute_ = distribute_points(num_ranks,
-                                            tree->unif_count_src(),
+      std::vector<size_t> reduced(tree->dim3_ * 3);
+      hpx_lco_get(tree->unif_count_, sizeof(size_t) * (tree->dim3_ * 3),
+                  reduced.data());
+      std::copy(reduced.begin(), reduced.begin() + tree->dim3_ * 2,
+                tree->unif_count_src());
+      tree->distribute_ = distribute_points(num_ranks, reduced.data(),
                                             tree->dim3_);
       tree->generate_rank_map(num_ranks);
+      tree->set_leaf_limits();
 
       // Exchange points
+#ifdef DASHMMEXTRATIMING
+      hpx_time_t exchange_begin = hpx_time_now();
+#endif
       sourcenode_t *ns = tree->source_tree_->unif_grid_;
       targetnode_t *nt = tree->target_tree_->unif_grid_;
       int firstarg = tree->first(rank);
       int lastarg = tree->last(rank);
       sourcetree_t::init_point_exchange(tree->source_tree_, firstarg, lastarg,
           tree->unif_count_src(), local_scount, local_offset_s, &tree->domain_,
-          tree->refinement_limit_, p_s, ns);
+          p_s, ns);
       if (!tree->same_sandt_) {
         targettree_t::init_point_exchange(tree->target_tree_, firstarg, lastarg,
             tree->unif_count_tar(), local_tcount, local_offset_t,
-            &tree->domain_, tree->refinement_limit_, p_t, nt);
+            &tree->domain_, p_t, nt);
       } else {
         targettree_t::init_point_exchange_same_s_and_t(tree->target_tree_,
             firstarg, lastarg, tree->unif_count_tar(), local_tcount,
-            local_offset_t, &tree->domain_, tree->refinement_limit_, p_t, nt,
-            ns, tree->source_tree_);
+            local_offset_t, &tree->domain_, p_t, nt, ns, tree->source_tree_);
       }
 
       // So this one is pretty simple. It sends those points from this rank
-      // going to the other rank in a parcel.
-      for (int r = 0; r < num_ranks; ++r) {
-        if (r != rank) {
-          hpx_call(HPX_HERE, send_points_, HPX_NULL, &r, &local_scount,
-                   &local_tcount, &local_offset_s, &local_offset_t,
-                   &p_s, &p_t, &rwtree);
-        }
+      // going to the other rank in a parcel. In the zero-copy mode, only the
+      // address of the points is sent, and the other rank reads them, unless
+      // the points did not fit in the global address space. With an
+      // exchange budget, the parcels are streamed through a semaphore; the
+      // zero-copy mode has no budget, so its parcels are sent whole.
+      hpx_addr_t budget{HPX_NULL};
+      hpx_addr_t sent{HPX_NULL};
+#if defined(DASHMM_EXCHANGE_BUDGET) && !defined(DASHMM_ZERO_COPY_EXCHANGE)
+      budget = hpx_lco_sema_new(kExchangeSlots);
+      assert(budget != HPX_NULL);
+#endif
+      if (num_ranks > 1) {
+        sent = hpx_lco_and_new(num_ranks - 1);
+        assert(sent != HPX_NULL);
       }
-      hpx_addr_t dual_tree_complete = hpx_lco_and_new(2 * tree->dim3_);
-      assert(dual_tree_complete != HPX_NULL);
-
-      for (int r = 0; r < num_ranks; ++r) {
-        int first = tree->first(r);
-        int last = tree->last(r);
-
-        if (r == rank) {
-          for (int i = first; i <= last; ++i) {
-            if (*(tree->unif_count_src(i)) == 0) {
-              hpx_lco_and_set(dual_tree_complete, HPX_NULL);
-            } else {
-              source_t *arg = tree->sorted_src();
-              int typearg = 0;
-              assert(ns[i].complete() != HPX_NULL);
-              hpx_call_when_with_continuation(ns[i].complete(),
-                  HPX_HERE, sourcetree_t::send_node_,
-                  dual_tree_complete, hpx_lco_set_action,
-                  &ns, &arg, &i, &rwtree, &typearg);
-            }
-
-            if (*(tree->unif_count_tar(i)) == 0) {
-              hpx_lco_and_set(dual_tree_complete, HPX_NULL);
-            } else {
-              target_t *arg = tree->sorted_tar();
-              int typearg = 1;
-              assert(nt[i].complete() != HPX_NULL);
-              hpx_call_when_with_continuation(nt[i].complete(),
-                  HPX_HERE, targettree_t::send_node_,
-                  dual_tree_complete, hpx_lco_set_action,
-                  &nt, &arg, &i, &rwtree, &typearg);
-            }
-          }
-        } else {
-          for (int i = first; i <= last; ++i) {
-            if (*(tree->unif_count_src(i)) == 0) {
-              hpx_lco_and_set(dual_tree_complete, HPX_NULL);
-            } else {
-              assert(ns[i].complete() != HPX_NULL);
-              hpx_call_when_with_continuation(ns[i].complete(),
-                  dual_tree_complete, hpx_lco_set_action,
-                  ns[i].complete(), hpx_lco_delete_action,
-                  nullptr, 0);
-            }
-
-            if (*(tree->unif_count_tar(i)) == 0) {
-              hpx_lco_and_set(dual_tree_complete, HPX_NULL);
-            } else {
-              assert(nt[i].complete() != HPX_NULL);
-              hpx_call_when_with_continuation(nt[i].complete(),
-                  dual_tree_complete, hpx_lco_set_action,
-                  nt[i].complete(), hpx_lco_delete_action,
-                  nullptr, 0);
-            }
+      for (int r = 0; r < num_ranks; ++r) {
+        if (r != rank) {
+          if (tree->grouped_in_gas_) {
+            hpx_call(HPX_HERE, offer_points_, HPX_NULL, &r, &local_scount,
+                     &local_tcount, &local_offset_s, &local_offset_t, &rwtree,
+                     &sent);
+          } else {
+            hpx_call(HPX_HERE, send_points_, sent, &r, &local_scount,
+                     &local_tcount, &local_offset_s, &local_offset_t,
+                     &p_s, &p_t, &rwtree, &budget);
           }
         }
       }
+      hpx_addr_t dual_tree_complete = tree->exchange_branches(rwtree);
+
+      // In the zero-copy mode, this waits until the other ranks have read the
+      // points, after which the grouped points are no longer needed.
+      // Otherwise, this waits until the parcels are sent, and, with a budget,
+      // until the last of the streamed parcels is merged before releasing
+      // the semaphore.
+      if (sent != HPX_NULL) {
+        hpx_lco_wait(sent);
+        hpx_lco_delete_sync(sent);
+      }
+      free_grouped_segment(&tree->grouped_src_);
+      free_grouped_segment(&tree->grouped_tar_);
+      if (budget != HPX_NULL) {
+        for (int i = 0; i < kExchangeSlots; ++i) {
+          hpx_lco_sema_p(budget);
+        }
+        hpx_lco_delete_sync(budget);
+      }
+#ifdef DASHMMEXTRATIMING
+      hpx_time_t exchange_end = hpx_time_now();
+#endif
 
       hpx_lco_wait(dual_tree_complete);
       hpx_lco_delete_sync(dual_tree_complete);
 
+#ifdef DASHMMEXTRATIMING
+      hpx_time_t build_end = hpx_time_now();
+      size_t sent_bytes = 0;
+      for (int i = 0; i < tree->dim3_; ++i) {
+        if (tree->rank_of_unif_grid(i) != rank) {
+          sent_bytes += local_scount[i] * sizeof(source_t);
+          if (!tree->same_sandt_) {
+            sent_bytes += local_tcount[i] * sizeof(target_t);
+          }
+        }
+      }
+      fprintf(stdout, "Point exchange: %d - sent %zu bytes - %lg [us] - "
+              "tree %lg [us]\n", rank, sent_bytes,
+              hpx_time_diff_us(exchange_begin, exchange_end),
+              hpx_time_diff_us(exchange_end, build_end));
+#endif
+
       // This will prune pointless nodes from the top of the tree.
       tree->prune_topnodes();
 
+#ifdef DASHMMEXTRATIMING
+      fprintf(stdout, "Tree nodes: %d - source %zu in %zu slabs - "
+              "target %zu in %zu slabs\n", rank,
+              tree->source_arena()->n_objects(),
+              tree->source_arena()->n_slabs(),
+              tree->target_arena()->n_objects(),
+              tree->target_arena()->n_slabs());
+#endif
+
       delete [] local_count;
       delete [] local_offset_s;
       delete [] local_offset_t;
@@ -2432,6 +5282,22 @@ class DualTree {
     return HPX_SUCCESS;
   }
 
+  /// Action to delete the estimated costs saved on this rank
+  ///
+  /// This action is the target of a broadcast from destroy_unif_cost().
+  ///
+  /// \param unif_cost - a RankWise<UnifCost>
+  ///
+  /// \returns - HPX_SUCCESS
+  static int delete_unif_cost_handler(hpx_addr_t unif_cost) {
+    RankWise<UnifCost> global_cost{unif_cost};
+    auto saved = global_cost.here();
+    delete [] saved->cost;
+    saved->cost = nullptr;
+    saved->dim3 = 0;
+    return HPX_SUCCESS;
+  }
+
   /// Action to destroy the tree
   ///
   /// This action is the target of a broadcast that is used to destroy the
@@ -2443,130 +5309,612 @@ class DualTree {
   static int finalize_partition_handler(hpx_addr_t rwtree) {
     RankWise<dualtree_t> global_tree{rwtree};
     auto tree = global_tree.here();
+    tree->release_DAG();
     tree->clear_data();
     return HPX_SUCCESS;
   }
 
-  /// Collect DAG nodes from source Tree Nodes
+  /// Action counting the nodes of the local tree for the statistics
   ///
-  /// \param root - tree node
-  /// \param sources [out] - DAG nodes that are sources
-  /// \param internals [out] - other source tree DAG nodes
-  void collect_DAG_nodes_from_S_node(sourcenode_t *root,
-                                     std::vector<DAGNode *> &sources,
-                                     std::vector<DAGNode *> &internals) {
-    for (int i = 0; i < 8; ++i) {
-      if (root->child[i]) {
-        collect_DAG_nodes_from_S_node(root->child[i], sources, internals);
+  /// This is the target of a broadcast.
+  ///
+  /// \param rwtree - the global address of the DualTree
+  /// \param stats - the reduction LCO for the statistics
+  ///
+  /// \returns - HPX_SUCCESS
+  static int collect_statistics_handler(hpx_addr_t rwtree, hpx_addr_t stats) {
+    RankWise<dualtree_t> global_tree{rwtree};
+    auto tree = global_tree.here();
+    int rank = hpx_get_my_rank();
+    int num_ranks = hpx_get_num_ranks();
+    int b = tree->first(rank);
+    int e = tree->last(rank);
+
+    size_t n_values = TreeShape::packed_size(num_ranks);
+    std::vector<size_t> local(2 * n_values, 0);
+    size_t *sdata = local.data();
+    size_t *tdata = &local[n_values];
+
+    size_t n_snodes = tree->source_tree_->count_nodes(tree->unif_level_, b, e,
+                                                      rank == 0, sdata);
+    TreeShape::set_rank(sdata, num_ranks, rank,
+                        tree->source_tree_->sorted_.n(), n_snodes);
+    size_t n_tnodes = tree->target_tree_->count_nodes(tree->unif_level_, b, e,
+                                                      rank == 0, tdata);
+    TreeShape::set_rank(tdata, num_ranks, rank,
+                        tree->target_tree_->sorted_.n(), n_tnodes);
+
+    hpx_lco_set_lsync(stats, sizeof(size_t) * local.size(), local.data(),
+                      HPX_NULL);
+    return HPX_SUCCESS;
+  }
+
+  /// Action moving the state of the local tree out of the DualTree
+  ///
+  /// This is the target of a broadcast. The Tree objects of the local tree
+  /// are deleted once their state has been moved.
+  ///
+  /// \param rwtree - the global address of the DualTree
+  /// \param rwdata - the global address of the state
+  ///
+  /// \returns - HPX_SUCCESS
+  static int export_tree_handler(hpx_addr_t rwtree, hpx_addr_t rwdata) {
+    RankWise<dualtree_t> global_tree{rwtree};
+    auto tree = global_tree.here();
+    RankWise<dualtreedata_t> global_data{rwdata};
+    auto data = global_data.here();
+
+    // The kept DAG refers to this Expansion and Method
+    tree->release_DAG();
+
+    data->domain = tree->domain_;
+    data->refinement_limit = tree->refinement_limit_;
+    data->target_limit = tree->target_limit_;
+    data->adaptive = tree->adaptive_;
+    data->unif_level = tree->unif_level_;
+    data->dim3 = tree->dim3_;
+    data->unif_count = tree->unif_count_;
+    data->unif_count_value = tree->unif_count_value_;
+    data->distribute = tree->distribute_;
+    data->rank_map = tree->rank_map_;
+    data->same_sandt = tree->same_sandt_;
+
+    data->source_tree = new TreeData<Source>{};
+    data->source_tree->swap(*tree->source_tree_);
+    delete tree->source_tree_;
+    data->target_tree = new TreeData<Target>{};
+    data->target_tree->swap(*tree->target_tree_);
+    delete tree->target_tree_;
+
+    return HPX_SUCCESS;
+  }
+
+  /// Action moving the state of the local tree into the DualTree
+  ///
+  /// This is the target of a broadcast.
+  ///
+  /// \param rwtree - the global address of the DualTree
+  /// \param rwdata - the global address of the state
+  ///
+  /// \returns - HPX_SUCCESS
+  static int import_tree_handler(hpx_addr_t rwtree, hpx_addr_t rwdata) {
+    RankWise<dualtree_t> global_tree{rwtree};
+    auto tree = global_tree.here();
+    RankWise<dualtreedata_t> global_data{rwdata};
+    auto data = global_data.here();
+
+    tree->domain_ = data->domain;
+    tree->refinement_limit_ = data->refinement_limit;
+    tree->target_limit_ = data->target_limit;
+    tree->adaptive_ = data->adaptive;
+    tree->unif_level_ = data->unif_level;
+    tree->dim3_ = data->dim3;
+    tree->unif_count_ = data->unif_count;
+    tree->unif_count_value_ = data->unif_count_value;
+    tree->distribute_ = data->distribute;
+    tree->rank_map_ = data->rank_map;
+    tree->same_sandt_ = data->same_sandt;
+
+    tree->source_tree_ = new sourcetree_t{};
+    tree->source_tree_->swap(*data->source_tree);
+    delete data->source_tree;
+    tree->target_tree_ = new targettree_t{};
+    tree->target_tree_->swap(*data->target_tree);
+    delete data->target_tree;
+
+    return HPX_SUCCESS;
+  }
+
+  /// Return the uniform grid node containing a point
+  ///
+  /// \param pos - the point in question
+  ///
+  /// \returns - the index of the uniform grid node containing @p pos
+  int unif_grid_index(const Point &pos) const {
+    Point corner = domain_.low();
+    double scale = 1.0 / domain_.size();
+    int dim = pow(2, unif_level_);
+    int xid = std::min(dim - 1, (int)(dim * (pos.x() - corner.x()) * scale));
+    int yid = std::min(dim - 1, (int)(dim * (pos.y() - corner.y()) * scale));
+    int zid = std::min(dim - 1, (int)(dim * (pos.z() - corner.z()) * scale));
+    return morton_key(xid, yid, zid);
+  }
+
+  /// Sort the records that have left their uniform grid node by destination
+  ///
+  /// The records that left the uniform grid nodes @p first through @p last
+  /// of @p rtree are gathered for the rank owning their new uniform grid
+  /// node, along with the index of that node.
+  ///
+  /// \param rtree - the tree in question
+  /// \param first - the first uniform grid node owned by this rank
+  /// \param last - the last uniform grid node owned by this rank
+  /// \param ids [out] - the destination uniform grid nodes for each rank
+  /// \param records [out] - the records for each rank
+  ///
+  /// \returns - false if any record has left the domain; true otherwise
+  template <typename R>
+  bool route_movers(Tree<Source, Target, R, Expansion, Method> *rtree,
+                    int first, int last, std::vector<std::vector<int>> *ids,
+                    std::vector<std::vector<R>> *records) const {
+    bool retval{true};
+    Point low = domain_.low();
+    Point high = domain_.high();
+    for (int i = first; i <= last; ++i) {
+      for (const R &rec : rtree->outgoing(i)) {
+        bool inside{true};
+        for (int d = 0; d < 3; ++d) {
+          inside = inside && rec.position[d] >= low[d]
+                          && rec.position[d] <= high[d];
+        }
+        if (!inside) {
+          retval = false;
+          continue;
+        }
+
+        int id = unif_grid_index(rec.position);
+        int r = rank_of_unif_grid(id);
+        (*ids)[r].push_back(id);
+        (*records)[r].push_back(rec);
       }
     }
-    root->dag.collect_DAG_nodes(sources, internals);
+    return retval;
+  }
+
+  /// Order records by their destination uniform grid node
+  ///
+  /// \param ids - the destination of each record
+  /// \param records - the records
+  template <typename R>
+  static void sort_movers(std::vector<int> *ids, std::vector<R> *records) {
+    std::vector<size_t> perm(ids->size());
+    for (size_t i = 0; i < perm.size(); ++i) {
+      perm[i] = i;
+    }
+    std::stable_sort(perm.begin(), perm.end(),
+                     [ids](size_t a, size_t b) {
+                       return (*ids)[a] < (*ids)[b];
+                     });
+
+    std::vector<int> sorted_ids{};
+    std::vector<R> sorted_records{};
+    sorted_ids.reserve(perm.size());
+    sorted_records.reserve(perm.size());
+    for (size_t i : perm) {
+      sorted_ids.push_back((*ids)[i]);
+      sorted_records.push_back((*records)[i]);
+    }
+    ids->swap(sorted_ids);
+    records->swap(sorted_records);
   }
 
-  /// Collect DAG nodes from target Tree Nodes
+  /// Send the records that have moved to a uniform grid node on another rank
   ///
-  /// \param root - tree node
-  /// \param targets [out] - DAG nodes that are targets
-  /// \param internals [out] - other target tree DAG nodes
-  void collect_DAG_nodes_from_T_node(targetnode_t *root,
-                                     std::vector<DAGNode *> &targets,
-                                     std::vector<DAGNode *> &internals) {
-    for (int i = 0; i < 8; ++i) {
-      if (root->child[i]) {
-        collect_DAG_nodes_from_T_node(root->child[i], targets, internals);
+  /// One parcel is sent to each other rank for each tree during an update,
+  /// even if there are no records to send.
+  ///
+  /// \param rank - the rank to which we are sending
+  /// \param type - indicates source or target tree
+  /// \param ids - the destination uniform grid node of each record
+  /// \param records - the records
+  /// \param rwaddr - the global address of the dual tree
+  template <typename R>
+  static void send_movers(int rank, int type, const std::vector<int> &ids,
+                          const std::vector<R> &records, hpx_addr_t rwaddr) {
+    int n = ids.size();
+    size_t bytes = sizeof(hpx_addr_t) + sizeof(int) * (2 + n)
+                   + sizeof(R) * n;
+
+    hpx_parcel_t *p = hpx_parcel_acquire(nullptr, bytes);
+    void *data = hpx_parcel_get_data(p);
+    hpx_addr_t *rwarg = static_cast<hpx_addr_t *>(data);
+    *rwarg = rwaddr;
+    int *meta = reinterpret_cast<int *>(
+                              static_cast<char *>(data) + sizeof(hpx_addr_t));
+    meta[0] = type;
+    meta[1] = n;
+    if (n) {
+      memcpy(&meta[2], ids.data(), sizeof(int) * n);
+      memcpy(&meta[2 + n], records.data(), sizeof(R) * n);
+    }
+
+    hpx_parcel_set_target(p, HPX_THERE(rank));
+    hpx_parcel_set_action(p, recv_movers_);
+    hpx_parcel_send(p, HPX_NULL);
+  }
+
+  /// Receive the records that have moved to uniform grid nodes on this rank
+  ///
+  /// This is the far side of send_movers().
+  ///
+  /// \param args - a buffer containing the incoming message.
+  /// \param UNUSED - the size of the message.
+  ///
+  /// \returns - HPX_SUCCESS
+  static int recv_movers_handler(void *args, size_t UNUSED) {
+    hpx_addr_t *rwarg = static_cast<hpx_addr_t *>(args);
+    RankWise<dualtree_t> global_tree{*rwarg};
+    auto local_tree = global_tree.here();
+
+    int *meta = reinterpret_cast<int *>(
+                              static_cast<char *>(args) + sizeof(hpx_addr_t));
+    int type = meta[0];
+    int n = meta[1];
+    const char *records = reinterpret_cast<const char *>(&meta[2 + n]);
+    if (type == 0) {
+      local_tree->source_tree_->accept_movers(&meta[2], records, n);
+    } else {
+      local_tree->target_tree_->accept_movers(&meta[2], records, n);
+    }
+
+    hpx_lco_and_set(local_tree->movers_arrived_, HPX_NULL);
+    return HPX_SUCCESS;
+  }
+
+  /// Lay out the records of one tree again during an update
+  ///
+  /// This rebuilds the branches of the uniform grid nodes owned by this rank
+  /// that records have left or entered. If every such node keeps its number
+  /// of records, the sorted records of this rank are kept, and only the
+  /// rebuilt branches are laid out again. Otherwise, new sorted records are
+  /// allocated, and every branch is moved into them. This is a synchronous
+  /// operation.
+  ///
+  /// \param rtree - the tree to rebuild
+  /// \param first - the first uniform grid node owned by this rank
+  /// \param last - the last uniform grid node owned by this rank
+  /// \param counts [out] - the new number of records in each uniform grid
+  ///                       node
+  /// \param changed [out] - 1 for each uniform grid node that records have
+  ///                        left or entered; 0 otherwise
+  ///
+  /// \returns - true if new sorted records were allocated
+  template <typename R>
+  bool rebuild_branches(Tree<Source, Target, R, Expansion, Method> *rtree,
+                        int first, int last, int *counts, int *changed) {
+    size_t n_records{0};
+    int n_changed{0};
+    bool same_counts{true};
+    for (int i = first; i <= last; ++i) {
+      size_t before = rtree->unif_grid_[i].num_parts();
+      counts[i] = before - rtree->outgoing(i).size() + rtree->n_incoming(i);
+      changed[i] = !rtree->outgoing(i).empty() || rtree->n_incoming(i) != 0;
+      n_records += counts[i];
+      n_changed += changed[i];
+      same_counts = same_counts && (size_t)counts[i] == before;
+    }
+
+    if (same_counts && n_changed == 0) {
+      return false;
+    }
+
+    R *records{nullptr};
+    if (!same_counts && n_records) {
+      records = reinterpret_cast<R *>(new char[n_records * sizeof(R)]);
+    }
+
+    hpx_addr_t done = hpx_lco_and_new(same_counts ? n_changed
+                                                  : last - first + 1);
+    assert(done != HPX_NULL);
+    const DomainGeometry *geo = &domain_;
+    R *dest = records;
+    for (int i = first; i <= last; ++i) {
+      size_t n = counts[i];
+      if (same_counts) {
+        if (!changed[i]) continue;
+        dest = rtree->unif_grid_[i].parts.data();
       }
+      int threshold = rtree->leaf_limit(i);
+      hpx_call(HPX_HERE, rtree->rebuild_branch_, done,
+               &rtree, &i, &geo, &threshold, &dest, &n);
+      dest += n;
+    }
+    hpx_lco_wait(done);
+    hpx_lco_delete_sync(done);
+
+    if (same_counts) {
+      return false;
     }
-    root->dag.collect_DAG_nodes(targets, internals);
+    rtree->sorted_ = ArrayRef<R>{records, n_records};
+    return true;
   }
 
-  /// Action to create LCOs from the DAG
+  /// The action responsible for updating the dual tree
   ///
-  /// This will walk through the source tree and create the Expansion LCOs
-  /// needed by @p node. This will spawns recursively as HPX-5 actions the
-  /// full tree.
+  /// This action is the target of a broadcast and manages all the work
+  /// required to update the distributed trees. See update().
   ///
-  /// \param done - LCO address for indicating completion of LCO creation
-  /// \param tree - the DualTree
-  /// \param node - the node under examination
-  /// \param rwtree - the global address of the DualTree
+  /// \param rwtree - the global address of the dual tree
+  /// \param sources_gas - the source data
+  /// \param targets_gas - the target data
+  /// \param valid - LCO reducing the number of ranks able to update
+  /// \param count - LCO reducing the new uniform counts
   ///
   /// \returns - HPX_SUCCESS
-  static int create_S_expansions_from_DAG_handler(hpx_addr_t done,
-                                                  dualtree_t *tree,
-                                                  sourcenode_t *node,
-                                                  hpx_addr_t rwtree) {
-    Point n_center = tree->domain_.center_from_index(node->idx);
+  static int update_dual_tree_handler(hpx_addr_t rwtree,
+                                      hpx_addr_t sources_gas,
+                                      hpx_addr_t targets_gas,
+                                      hpx_addr_t valid, hpx_addr_t count) {
+    int rank = hpx_get_my_rank();
+    int num_ranks = hpx_get_num_ranks();
 
-    int myrank = hpx_get_my_rank();
+    RankWise<dualtree_t> global_tree{rwtree};
+    auto tree = global_tree.here();
 
-    // create the normal expansion if needed
-    if (node->dag.has_normal() && node->dag.normal()->locality == myrank) {
-      std::unique_ptr<expansion_t> input_expand{
-        new expansion_t{n_center, expansion_t::compute_scale(node->idx),
-                        kSourcePrimary}
-      };
-      expansionlco_t expand(node->dag.normal()->in_edges.size(),
-                            node->dag.normal()->out_edges.size(),
-                            node->idx, std::move(input_expand),
-                            rwtree);
-      node->dag.set_normal_expansion(expand.lco());
+    Array<source_t> sources{sources_gas};
+    Array<target_t> targets{targets_gas};
+
+    // The kept DAG is not valid once the points have moved
+    tree->release_DAG();
+
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t update_begin = hpx_time_now();
+#endif
+
+    int b = tree->first(rank);
+    int e = tree->last(rank);
+    int n_trees = tree->same_sandt_ ? 1 : 2;
+    sourcetree_t *stree = tree->source_tree_;
+    targettree_t *ttree = tree->target_tree_;
+    sourcenode_t *ns = stree->unif_grid_;
+    targetnode_t *nt = ttree->unif_grid_;
+
+    // Anything another rank might send to this rank has to be ready before
+    // the first collective operation below.
+    tree->movers_arrived_ = HPX_NULL;
+    if (num_ranks > 1) {
+      tree->movers_arrived_ = hpx_lco_and_new(n_trees * (num_ranks - 1));
+      assert(tree->movers_arrived_ != HPX_NULL);
+    }
+    stree->begin_update(tree->dim3_);
+    ttree->begin_update(tree->dim3_);
+    for (int i = 0; i < tree->dim3_; ++i) {
+      if (i < b || i > e) {
+        ns[i].renew_completion();
+        nt[i].renew_completion();
+      }
     }
 
-    // If there is to be an intermediate expansion, create that
-    if (node->dag.has_interm() && node->dag.interm()->locality == myrank) {
-      std::unique_ptr<expansion_t> interm_expand{
-        new expansion_t{n_center, expansion_t::compute_scale(node->idx),
-                        kSourceIntermediate}
-      };
-      expansionlco_t intexp_lco(node->dag.interm()->in_edges.size(),
-                                node->dag.interm()->out_edges.size(),
-                                node->idx,
-                                std::move(interm_expand),
-                                rwtree);
-      node->dag.set_interm_expansion(intexp_lco.lco());
+    // Find the records that have left their leaves
+    if (e >= b) {
+      hpx_addr_t scanned = hpx_lco_and_new(n_trees * (e - b + 1));
+      assert(scanned != HPX_NULL);
+      const DomainGeometry *geo = &tree->domain_;
+      for (int i = b; i <= e; ++i) {
+        hpx_call(HPX_HERE, sourcetree_t::collect_movers_, scanned,
+                 &stree, &i, &geo);
+        if (!tree->same_sandt_) {
+          hpx_call(HPX_HERE, targettree_t::collect_movers_, scanned,
+                   &ttree, &i, &geo);
+        }
+      }
+      hpx_lco_wait(scanned);
+      hpx_lco_delete_sync(scanned);
+    }
+
+    std::vector<std::vector<int>> s_ids(num_ranks);
+    std::vector<std::vector<source_t>> s_records(num_ranks);
+    std::vector<std::vector<int>> t_ids(num_ranks);
+    std::vector<std::vector<target_t>> t_records(num_ranks);
+    int valid_here = tree->route_movers(stree, b, e, &s_ids, &s_records);
+    if (!tree->same_sandt_) {
+      valid_here = tree->route_movers(ttree, b, e, &t_ids, &t_records)
+                   && valid_here;
     }
 
-    // spawn work at children
-    int n_children{node->n_children()};
+    size_t n_moved{0};
+    for (int r = 0; r < num_ranks; ++r) {
+      n_moved += s_ids[r].size() + t_ids[r].size();
+    }
 
-    if (n_children) {
-      hpx_addr_t cdone = hpx_lco_and_new(n_children);
-      assert(cdone != HPX_NULL);
+    // If any rank has a point outside of the domain, the tree is left as it
+    // was. The records have only been reordered inside their leaves.
+    hpx_lco_set(valid, sizeof(int), &valid_here, HPX_NULL, HPX_NULL);
+    int n_valid{0};
+    hpx_lco_get(valid, sizeof(int), &n_valid);
+    if (n_valid != num_ranks) {
+      for (int i = 0; i < tree->dim3_; ++i) {
+        if (i < b || i > e) {
+          hpx_lco_delete_sync(ns[i].complete());
+          hpx_lco_delete_sync(nt[i].complete());
+        }
+      }
+      if (tree->movers_arrived_ != HPX_NULL) {
+        hpx_lco_delete_sync(tree->movers_arrived_);
+      }
+      stree->end_update();
+      ttree->end_update();
+      return HPX_SUCCESS;
+    }
 
-      for (int i = 0; i < 8; ++i) {
-        if (node->child[i] != nullptr) {
-          sourcenode_t *srcaddx = node->child[i];
-          hpx_call(HPX_HERE, create_S_expansions_from_DAG_, HPX_NULL,
-                   &cdone, &tree, &srcaddx, &rwtree);
+    // Exchange the records that have moved
+    for (int r = 0; r < num_ranks; ++r) {
+      sort_movers(&s_ids[r], &s_records[r]);
+      if (r != rank) {
+        send_movers(r, 0, s_ids[r], s_records[r], rwtree);
+      } else {
+        stree->accept_movers(s_ids[r].data(),
+                             reinterpret_cast<char *>(s_records[r].data()),
+                             s_ids[r].size());
+      }
+
+      if (!tree->same_sandt_) {
+        sort_movers(&t_ids[r], &t_records[r]);
+        if (r != rank) {
+          send_movers(r, 1, t_ids[r], t_records[r], rwtree);
+        } else {
+          ttree->accept_movers(t_ids[r].data(),
+                               reinterpret_cast<char *>(t_records[r].data()),
+                               t_ids[r].size());
         }
       }
+    }
+    if (tree->movers_arrived_ != HPX_NULL) {
+      hpx_lco_wait(tree->movers_arrived_);
+      hpx_lco_delete_sync(tree->movers_arrived_);
+      tree->movers_arrived_ = HPX_NULL;
+    }
 
-      // This will set the parent's LCO as well as delete cdone
-      hpx_call_when(cdone, cdone, hpx_lco_delete_action,
-                    done, nullptr, 0);
+    // Rebuild the branches owned by this rank that have changed. The counts
+    // are followed by a flag for each changed branch, so that every rank
+    // knows which branches it has to receive again.
+    int dim3 = tree->dim3_;
+    int *local_count = new int[dim3 * 4]();
+    int *local_scount = local_count;
+    int *local_tcount = &local_count[dim3];
+    int *local_schanged = &local_count[2 * dim3];
+    int *local_tchanged = &local_count[3 * dim3];
+    bool s_moved = tree->rebuild_branches(stree, b, e, local_scount,
+                                          local_schanged);
+    bool t_moved{false};
+    if (!tree->same_sandt_) {
+      t_moved = tree->rebuild_branches(ttree, b, e, local_tcount,
+                                       local_tchanged);
     } else {
-      hpx_lco_set(done, 0, nullptr, HPX_NULL, HPX_NULL);
+      for (int i = b; i <= e; ++i) {
+        if (local_schanged[i] || s_moved) {
+          nt[i].mirror_branch(&ns[i], ttree->arena());
+        }
+        local_tcount[i] = local_scount[i];
+        local_tchanged[i] = local_schanged[i];
+      }
+      if (s_moved) {
+        ArrayRef<Source> ssort = stree->sorted();
+        ttree->sorted_ = targetref_t{(target_t *)ssort.data(), ssort.n()};
+      }
+    }
+    for (int i = b; i <= e; ++i) {
+      // The branch is complete, even if it was empty before.
+      hpx_lco_delete_sync(ns[i].complete());
+      ns[i].renew_completion();
+      hpx_lco_and_set_num(ns[i].complete(), 8, HPX_NULL);
+      hpx_lco_delete_sync(nt[i].complete());
+      nt[i].renew_completion();
+      hpx_lco_and_set_num(nt[i].complete(), 8, HPX_NULL);
+    }
+
+    // Exchange the new counts, and then the changed branches. A changed
+    // branch of another rank is cleared when it is received; one that has
+    // become empty is not sent, so it is cleared here.
+    int *global_count = new int[dim3 * 4];
+    hpx_lco_set(count, sizeof(int) * dim3 * 4, local_count,
+                HPX_NULL, HPX_NULL);
+    hpx_lco_get(count, sizeof(int) * dim3 * 4, global_count);
+    memcpy(tree->unif_count_src(), global_count, sizeof(int) * dim3 * 2);
+    delete [] local_count;
+
+    const int *changed = &global_count[2 * dim3];
+    for (int i = 0; i < dim3; ++i) {
+      if (i >= b && i <= e) continue;
+      if (changed[i] && *tree->unif_count_src(i) == 0) {
+        ns[i].clear_branch(stree->arena());
+      }
+      if (changed[dim3 + i] && *tree->unif_count_tar(i) == 0) {
+        nt[i].clear_branch(ttree->arena());
+      }
+    }
+
+    stree->link_top_nodes(tree->unif_level_);
+    ttree->link_top_nodes(tree->unif_level_);
+    tree->prune_topnodes();
+
+    hpx_addr_t dual_tree_complete = tree->exchange_branches(rwtree, changed);
+    hpx_lco_wait(dual_tree_complete);
+    hpx_lco_delete_sync(dual_tree_complete);
+    delete [] global_count;
+
+    // Replace segment in the array, if it was replaced
+    if (s_moved) {
+      delete [] sources.replace(stree->sorted_);
+    }
+    if (t_moved) {
+      delete [] targets.replace(ttree->sorted_);
     }
 
+    stree->end_update();
+    ttree->end_update();
+
+#ifdef DASHMMEXTRATIMING
+    hpx_time_t update_end = hpx_time_now();
+    fprintf(stdout, "Tree update: %d - moved %zu of %zu - %lg [us]\n",
+            rank, n_moved, stree->sorted_.n() + (tree->same_sandt_ ? 0 :
+                                                 ttree->sorted_.n()),
+            hpx_time_diff_us(update_begin, update_end));
+#endif
+
     return HPX_SUCCESS;
   }
 
-  /// Action to create LCOs from the DAG
+  /// Action creating the Expansion LCOs and Target LCOs of a frozen tree
   ///
-  /// This will walk through the target tree and create the Expansion LCOs
-  /// needed by @p node. This will spawns recursively as HPX-5 actions the
-  /// full tree.
+  /// NOTE: For the target tree, the DAG of the nodes below a node with a
+  /// parts node is empty, so nothing is created for them.
   ///
-  /// \param done - LCO address for indicating completion of LCO creation
   /// \param tree - the DualTree
-  /// \param node - the node under examination
+  /// \param dag - the DAG
+  /// \param first - the first offset in the frozen tree
+  /// \param last - one past the last offset in the frozen tree
+  /// \param type - 0 for the source tree, 1 for the target tree
   /// \param rwtree - the global address of the DualTree
   ///
   /// \returns - HPX_SUCCESS
-  static int create_T_expansions_from_DAG_handler(hpx_addr_t done,
-                                                  dualtree_t *tree,
-                                                  targetnode_t *node,
-                                                  hpx_addr_t rwtree) {
+  static int create_expansions_nodes_handler(dualtree_t *tree, DAG *dag,
+                                             int first, int last, int type,
+                                             hpx_addr_t rwtree) {
+    for (int i = first; i < last; ++i) {
+      if (type) {
+        targetnode_t *node = tree->target_tree_->flat_node(i);
+        create_expansions_node(tree, dag, node, rwtree, kTargetPrimary,
+                               kTargetIntermediate);
+
+        // Here is where we make the target lco if needed
+        if (node->dag.has_parts()
+            && node->dag.parts()->locality == hpx_get_my_rank()) {
+          targetlco_t tlco{dag->in_degree(node->dag.parts()), node->parts};
+          node->dag.set_targetlco(tlco.lco(), tlco.n());
+        }
+      } else {
+        sourcenode_t *node = tree->source_tree_->flat_node(i);
+        create_expansions_node(tree, dag, node, rwtree, kSourcePrimary,
+                               kSourceIntermediate);
+      }
+    }
+    return HPX_SUCCESS;
+  }
+
+  /// Create the Expansion LCOs of a node that are on this rank
+  ///
+  /// \param tree - the DualTree
+  /// \param dag - the DAG
+  /// \param node - the node of either tree
+  /// \param rwtree - the global address of the DualTree
+  /// \param primary - the role of the normal expansion
+  /// \param intermediate - the role of the intermediate expansion
+  template <typename NodeType>
+  static void create_expansions_node(dualtree_t *tree, const DAG *dag,
+                                     NodeType *node, hpx_addr_t rwtree,
+                                     ExpansionRole primary,
+                                     ExpansionRole intermediate) {
     Point n_center = tree->domain_.center_from_index(node->idx);
 
     int myrank = hpx_get_my_rank();
@@ -2575,10 +5923,10 @@ class DualTree {
     if (node->dag.has_normal() && node->dag.normal()->locality == myrank) {
       std::unique_ptr<expansion_t> input_expand{
         new expansion_t{n_center, expansion_t::compute_scale(node->idx),
-                        kTargetPrimary}
+                        primary}
       };
-      expansionlco_t expand(node->dag.normal()->in_edges.size(),
-                            node->dag.normal()->out_edges.size(),
+      expansionlco_t expand(dag->in_degree(node->dag.normal()),
+                            dag->out_degree(node->dag.normal()),
                             node->idx, std::move(input_expand),
                             rwtree);
       node->dag.set_normal_expansion(expand.lco());
@@ -2588,182 +5936,208 @@ class DualTree {
     if (node->dag.has_interm() && node->dag.interm()->locality == myrank) {
       std::unique_ptr<expansion_t> interm_expand{
         new expansion_t{n_center, expansion_t::compute_scale(node->idx),
-                        kTargetIntermediate}
+                        intermediate}
       };
-      expansionlco_t intexp_lco(node->dag.interm()->in_edges.size(),
-                                node->dag.interm()->out_edges.size(),
+      expansionlco_t intexp_lco(dag->in_degree(node->dag.interm()),
+                                dag->out_degree(node->dag.interm()),
                                 node->idx,
                                 std::move(interm_expand),
                                 rwtree);
       node->dag.set_interm_expansion(intexp_lco.lco());
     }
+  }
 
-    // NOTE: this spawn through the tree does not end when the tree ends.
-    // Instead, we have to check if this node has a parts node in the DAG.
-    // If so, this branch is done, and we need not spawn more.
-
-    // Here is where we make the target lco if needed
-    if (node->dag.has_parts()) {
-      if (node->dag.parts()->locality == myrank) {
-        targetlco_t tlco{node->dag.parts()->in_edges.size(), node->parts};
-        node->dag.set_targetlco(tlco.lco(), tlco.n());
+  /// Action to set the edge lists of the LCOs
+  ///
+  /// \param dag - the DAG
+  /// \param snodes - source DAG nodes
+  /// \param n_snodes - the number of source nodes
+  /// \param tnodes - target DAG nodes
+  /// \param n_tnodes - the number of target nodes
+  ///
+  /// \returns - HPX_SUCCESS
+  static int edge_lists_handler(DAG *dag, DAGNode **snodes, size_t n_snodes,
+                                DAGNode **tnodes, size_t n_tnodes) {
+    int myrank = hpx_get_my_rank();
+    for (size_t i = 0; i < n_snodes; ++i) {
+      if (snodes[i]->locality == myrank) {
+        expansionlco_t expand{snodes[i]->global_addx};
+        std::vector<DAGEdge> out_edges = dag->out_edges(snodes[i]);
+        expand.set_out_edge_data(out_edges);
+      }
+    }
+    for (size_t i = 0; i < n_tnodes; ++i) {
+      if (tnodes[i]->locality == myrank) {
+        expansionlco_t expand{tnodes[i]->global_addx};
+        std::vector<DAGEdge> out_edges = dag->out_edges(tnodes[i]);
+        expand.set_out_edge_data(out_edges);
       }
+    }
+    return HPX_SUCCESS;
+  }
 
-      hpx_lco_set(done, 0, nullptr, HPX_NULL, HPX_NULL);
-    } else {
-      hpx_addr_t cdone = hpx_lco_and_new(node->n_children());
-      assert(cdone != HPX_NULL);
+  /// Action starting the DAG evaluation work at a leaf of the source tree
+  ///
+  /// \param tree - the DualTree
+  /// \param rwtree - the global address of the DualTree
+  /// \param dag - the DAG
+  /// \param node - the leaf
+  /// \param copied - LCO to set once the edges are copied out of the DAG
+  ///
+  /// \returns - HPX_SUCCESS
+  static int instigate_dag_eval_handler(dualtree_t *tree, hpx_addr_t rwtree,
+                                        DAG *dag, sourcenode_t *node,
+                                        hpx_addr_t copied) {
+    instigate_dag_eval_leaf(tree, rwtree, dag, node, copied);
+    return HPX_SUCCESS;
+  }
 
-      for (int i = 0; i < 8; ++i) {
-        if (node->child[i] != nullptr) {
-          targetnode_t *trgaddx = node->child[i];
-          hpx_call(HPX_HERE, create_T_expansions_from_DAG_, HPX_NULL,
-                   &cdone, &tree, &trgaddx, &rwtree);
-        }
-      }
+  /// Start the DAG evaluation work at a leaf of the source tree
+  ///
+  /// \param tree - the DualTree
+  /// \param rwtree - the global address of the DualTree
+  /// \param dag - the DAG
+  /// \param node - the leaf
+  /// \param copied - LCO to set once the edges are copied out of the DAG
+  static void instigate_dag_eval_leaf(dualtree_t *tree, hpx_addr_t rwtree,
+                                      const DAG *dag, sourcenode_t *node,
+                                      hpx_addr_t copied) {
+    DAGNode *parts = node->dag.parts();
+    if (parts != nullptr && parts->locality != hpx_get_my_rank()) {
+      parts = nullptr;
+    }
 
-      // This will set the parent's LCO as well as delete cdone
-      hpx_call_when(cdone, cdone, hpx_lco_delete_action,
-                    done, nullptr, 0);
+    // The DAG is not used after this, and its edges may be released
+    std::vector<DAGEdge> out_edges{};
+    if (parts) {
+      out_edges = dag->out_edges(parts);
+    }
+    hpx_lco_and_set(copied, HPX_NULL);
+
+    if (parts) {
+      instigate_dag_eval_edges(tree, rwtree, node, out_edges);
     }
-
-    return HPX_SUCCESS;
   }
 
-  /// Action to set the edge lists of the LCOs
+  /// Action starting the DAG evaluation work at a leaf of the source tree
+  /// for an implicit DAG
   ///
-  /// \param snodes - source DAG nodes
-  /// \param n_snodes - the number of source nodes
-  /// \param tnodes - target DAG nodes
-  /// \param n_tnodes - the number of target nodes
+  /// \param tree - the DualTree
+  /// \param rwtree - the global address of the DualTree
+  /// \param node - the leaf
+  /// \param out_edges - the edges leaving the leaf; this action takes
+  ///                    ownership of these
   ///
   /// \returns - HPX_SUCCESS
-  static int edge_lists_handler(DAGNode **snodes, size_t n_snodes,
-                                DAGNode **tnodes, size_t n_tnodes) {
-    int myrank = hpx_get_my_rank();
-    for (size_t i = 0; i < n_snodes; ++i) {
-      if (snodes[i]->locality == myrank) {
-        expansionlco_t expand{snodes[i]->global_addx};
-        expand.set_out_edge_data(snodes[i]->out_edges);
-      }
-    }
-    for (size_t i = 0; i < n_tnodes; ++i) {
-      if (tnodes[i]->locality == myrank) {
-        expansionlco_t expand{tnodes[i]->global_addx};
-        expand.set_out_edge_data(tnodes[i]->out_edges);
-      }
-    }
+  static int instigate_implicit_handler(dualtree_t *tree, hpx_addr_t rwtree,
+                                        sourcenode_t *node,
+                                        std::vector<DAGEdge> *out_edges) {
+    instigate_dag_eval_edges(tree, rwtree, node, *out_edges);
+    delete out_edges;
     return HPX_SUCCESS;
   }
 
-  /// Action to start DAG evaluation work
+  /// Action starting the DAG evaluation work along one edge leaving a leaf
+  /// of the source tree for an implicit DAG
   ///
-  /// This is a recursove spawn through the source tree to begin the work of
-  /// the DAG evaluation. This will cause the source DAG nodes to begin their
-  /// out edges.
+  /// The target of the edge must be on this rank.
   ///
-  /// \param rwtree - the global address of the DualTree
-  /// \param node - the node being worked on for this action
+  /// \param tree - the DualTree
+  /// \param node - the leaf
+  /// \param target - the DAG node at the target of the edge
+  /// \param op - the Operation of the edge
   ///
   /// \returns - HPX_SUCCESS
-  static int instigate_dag_eval_handler(hpx_addr_t rwtree, sourcenode_t *node) {
-    RankWise<dualtree_t> global_tree{rwtree};
-    auto tree = global_tree.here();
+  static int instigate_edge_handler(dualtree_t *tree, sourcenode_t *node,
+                                    DAGNode *target, int op) {
+    DAGInstigationRecord edge{static_cast<Operation>(op), target->global_addx,
+                              target->n_parts, target->idx};
+    instigate_dag_eval_work(node->parts.n(), node->parts.data(), tree->domain_,
+                            1, &edge);
+    return HPX_SUCCESS;
+  }
 
-    DAGNode *parts{nullptr};
+  /// Send the sources of a leaf of the source tree along its out edges
+  ///
+  /// \param tree - the DualTree
+  /// \param rwtree - the global address of the DualTree
+  /// \param node - the leaf
+  /// \param out_edges - the edges leaving the leaf
+  static void instigate_dag_eval_edges(dualtree_t *tree, hpx_addr_t rwtree,
+                                       sourcenode_t *node,
+                                       std::vector<DAGEdge> &out_edges) {
+    sourceref_t sources = node->parts;
+
+    // We first sort the out edges by locality
+    std::sort(out_edges.begin(), out_edges.end(),
+              DAG::compare_edge_locality);
+
+    // Make scratch space for the sends
+    size_t source_size = sizeof(Source) * sources.n();
+    size_t header_size = source_size + sizeof(size_t)
+        + sizeof(hpx_addr_t);
+    size_t total_size = header_size + sizeof(size_t)
+        + out_edges.size() * sizeof(DAGInstigationRecord);
+    char *scratch = new char [total_size];
+    assert(scratch != nullptr);
+
+    // Copy source data
+    auto sref = sources.data();
+    {
+      WriteBuffer headdata(scratch, header_size);
+      assert(headdata.write(sources.n()));
 
-    int n_children{node->n_children()};
-    if (n_children > 0) {
-      for (int i = 0; i < 8; ++i) {
-        if (node->child[i] != nullptr) {
-          hpx_call(HPX_HERE, instigate_dag_eval_, HPX_NULL,
-                  &rwtree, &node->child[i]);
-        }
-      }
-    } else {
-      // At a leaf, we do actual work
-      parts = node->dag.parts();
-      if (parts != nullptr && parts->locality != hpx_get_my_rank()) {
-        parts = nullptr;
-      }
-    }
+      ReadBuffer sourcedata((char *)sref, source_size);
+      assert(headdata.write(sourcedata));
 
-    if (parts) {
-      sourceref_t sources = node->parts;
-
-      // We first sort the out edges by locality
-      std::sort(parts->out_edges.begin(), parts->out_edges.end(),
-                DAG::compare_edge_locality);
-
-      // Make scratch space for the sends
-      size_t source_size = sizeof(Source) * sources.n();
-      size_t header_size = source_size + sizeof(size_t)
-          + sizeof(hpx_addr_t);
-      size_t total_size = header_size + sizeof(size_t)
-          + parts->out_edges.size() * sizeof(DAGInstigationRecord);
-      char *scratch = new char [total_size];
-      assert(scratch != nullptr);
-
-      // Copy source data
-      auto sref = sources.data();
-      {
-        WriteBuffer headdata(scratch, header_size);
-        assert(headdata.write(sources.n()));
-
-        ReadBuffer sourcedata((char *)sref, source_size);
-        assert(headdata.write(sourcedata));
-
-        assert(headdata.write(rwtree));
-      }
-
-      int my_rank = hpx_get_my_rank();
-      auto begin = parts->out_edges.begin();
-      auto end = parts->out_edges.end();
-      while (begin != end) {
-        int curr_rank = begin->target->locality;
-        auto curr = begin;
-        while (curr != end && curr->target->locality == curr_rank) {
-          ++curr;
-        }
+      assert(headdata.write(rwtree));
+    }
 
-        //copy in edge data
-        char *edgedata = scratch + header_size;
-        size_t *edgecount = reinterpret_cast<size_t *>(edgedata);
-        *edgecount = curr - begin;
-
-        DAGInstigationRecord *edgerecords
-            = reinterpret_cast<DAGInstigationRecord *>(edgedata
-                                                        + sizeof(size_t));
-        int i = 0;
-        for (auto loop = begin; loop != curr; ++loop) {
-          edgerecords[i].op = loop->op;
-          edgerecords[i].target = loop->target->global_addx;
-          edgerecords[i].n_parts = loop->target->n_parts;
-          edgerecords[i].idx = loop->target->idx;
-          ++i;
-        }
+    int my_rank = hpx_get_my_rank();
+    auto begin = out_edges.begin();
+    auto end = out_edges.end();
+    while (begin != end) {
+      int curr_rank = begin->target->locality;
+      auto curr = begin;
+      while (curr != end && curr->target->locality == curr_rank) {
+        ++curr;
+      }
 
-        // Send parcel or do the work
-        if (curr_rank == my_rank) {
-          instigate_dag_eval_work(sources.n(), sref, tree->domain_,
-                                  *edgecount, edgerecords);
-        } else {
-          size_t parcel_size = header_size + sizeof(size_t)
-                               + sizeof(DAGInstigationRecord) * (*edgecount);
-          hpx_parcel_t *parc = hpx_parcel_acquire(scratch, parcel_size);
-          hpx_parcel_set_action(parc, instigate_dag_eval_remote_);
-          hpx_parcel_set_target(parc, HPX_THERE(curr_rank));
+      //copy in edge data
+      char *edgedata = scratch + header_size;
+      size_t *edgecount = reinterpret_cast<size_t *>(edgedata);
+      *edgecount = curr - begin;
+
+      DAGInstigationRecord *edgerecords
+          = reinterpret_cast<DAGInstigationRecord *>(edgedata
+                                                      + sizeof(size_t));
+      int i = 0;
+      for (auto loop = begin; loop != curr; ++loop) {
+        edgerecords[i].op = loop->op;
+        edgerecords[i].target = loop->target->global_addx;
+        edgerecords[i].n_parts = loop->target->n_parts;
+        edgerecords[i].idx = loop->target->idx;
+        ++i;
+      }
 
-          hpx_parcel_send_sync(parc);
-        }
+      // Send parcel or do the work
+      if (curr_rank == my_rank) {
+        instigate_dag_eval_work(sources.n(), sref, tree->domain_,
+                                *edgecount, edgerecords);
+      } else {
+        size_t parcel_size = header_size + sizeof(size_t)
+                             + sizeof(DAGInstigationRecord) * (*edgecount);
+        hpx_parcel_t *parc = hpx_parcel_acquire(scratch, parcel_size);
+        hpx_parcel_set_action(parc, instigate_dag_eval_remote_);
+        hpx_parcel_set_target(parc, HPX_THERE(curr_rank));
 
-        begin = curr;
+        hpx_parcel_send_sync(parc);
       }
 
-      delete [] scratch;
+      begin = curr;
     }
 
-    return HPX_SUCCESS;
+    delete [] scratch;
   }
 
   /// Action on remote side for DAG instigation
@@ -2799,8 +6173,8 @@ class DualTree {
     // correct address
     for (size_t i = 0; i < n_edges; ++i) {
       if (edges[i].target == HPX_NULL) {
-        edges[i].target = local_tree->target_tree_->lookup_lco_addx(
-                                edges[i].idx, edges[i].op);
+        edges[i].target = local_tree->lookup_lco_addx(edges[i].idx,
+                                                      edges[i].op);
       }
     }
 
@@ -2864,135 +6238,97 @@ class DualTree {
     }
   }
 
-  /// Action to apply Method::aggregate
-  ///
-  /// This is an action that is called dependent on the children of this
-  /// node all completing their Method application work.
-  ///
-  /// \param tree - the DualTree
-  /// \param node - the node of the source tree
-  /// \param cdone - the completion detection LCO that is deleted by this action
-  /// \param done - the completion LCO that is set by this action
-  ///
-  /// \returns - HPX_SUCCESS
-  static int source_apply_method_child_done_handler(dualtree_t *tree,
-                                                    sourcenode_t *node,
-                                                    hpx_addr_t cdone,
-                                                    hpx_addr_t done) {
-    tree->method_.aggregate(node, &tree->domain_);
-    int loc{0};
-    if (node->idx.level() >= tree->unif_level_) {
-      int dag_idx = sourcetree_t::get_unif_grid_index(node->idx,
-                                                      tree->unif_level_);
-      loc = tree->rank_of_unif_grid(dag_idx);
-    }
-
-    int height;
-    hpx_lco_get(cdone, sizeof(int), &height);
-    hpx_lco_set(done, sizeof(int), &height, HPX_NULL, HPX_NULL);
-    hpx_lco_delete_sync(cdone);
-
-    method_t::distropolicy_t::assign_for_source(node->dag, loc, height);
-    return HPX_SUCCESS;
-  }
-
-  /// Action to apply Method::generate
+  /// Action applying Method::generate and Method::aggregate
   ///
-  /// This is a recursive spawn through the source tree.
+  /// This handles a chunk of one level of the frozen source tree, generating
+  /// the DAG at the leaves, and aggregating it at the internal nodes. The
+  /// levels below must already be done. The height passed to the distribution
+  /// policy is the largest height of the children of a node.
   ///
   /// \param tree - the DualTree
-  /// \param node - the node of the source tree
-  /// \param done - LCO to signal when application of the method is complete
+  /// \param first - the first offset in the frozen source tree
+  /// \param last - one past the last offset in the frozen source tree
+  /// \param heights - the height for each node of the frozen source tree
   ///
   /// \returns - HPX_SUCCESS
-  static int source_apply_method_handler(dualtree_t *tree, sourcenode_t *node,
-                                         hpx_addr_t done) {
-    int n_children = node->n_children();
-    if (n_children == 0) {
-      tree->method_.generate(node, &tree->domain_);
-
-      int dag_idx = sourcetree_t::get_unif_grid_index(node->idx,
-                                                      tree->unif_level_);
-      assert(dag_idx >= 0);
-      int dag_rank = tree->rank_of_unif_grid(dag_idx);
-      node->dag.set_parts_locality(dag_rank);
-      node->dag.set_normal_locality(dag_rank);
+  static int source_method_nodes_handler(dualtree_t *tree, int first,
+                                         int last, int *heights) {
+    sourcetree_t *stree = tree->source_tree_;
+    for (int i = first; i < last; ++i) {
+      const FlatNode &flat = stree->flat(i);
+      sourcenode_t *node = stree->flat_node(i);
 
-      method_t::distropolicy_t::assign_for_source(node->dag, dag_rank, 0);
+      if (flat.mask == 0) {
+        tree->method_.generate(node, &tree->domain_);
 
-      int height = 0;
-      hpx_lco_set(done, sizeof(int), &height, HPX_NULL, HPX_NULL);
+        int dag_idx = sourcetree_t::get_unif_grid_index(node->idx,
+                                                        tree->unif_level_);
+        assert(dag_idx >= 0);
+        int dag_rank = tree->rank_of_unif_grid(dag_idx);
+        node->dag.set_parts_locality(dag_rank);
+        node->dag.set_normal_locality(dag_rank);
+
+        method_t::distropolicy_t::assign_for_source(node->dag, dag_rank, 0);
+        heights[i] = 0;
+        continue;
+      }
 
-      return HPX_SUCCESS;
-    }
+      int height{0};
+      for (int which = 0; which < 8; ++which) {
+        if (flat.mask & (1 << which)) {
+          height = std::max(height, heights[flat.child_offset(which)]);
+        }
+      }
 
-    hpx_addr_t cdone = hpx_lco_reduce_new(n_children, sizeof(int),
-                                          int_max_ident_op, int_max_op);
-    assert(cdone != HPX_NULL);
+      tree->method_.aggregate(node, &tree->domain_);
+      int loc{0};
+      if (node->idx.level() >= tree->unif_level_) {
+        int dag_idx = sourcetree_t::get_unif_grid_index(node->idx,
+                                                        tree->unif_level_);
+        loc = tree->rank_of_unif_grid(dag_idx);
+      }
 
-    for (int i = 0; i < 8; ++i) {
-      if (node->child[i] == nullptr) continue;
-      hpx_call(HPX_HERE, source_apply_method_, HPX_NULL,
-               &tree, &node->child[i], &cdone);
+      method_t::distropolicy_t::assign_for_source(node->dag, loc, height);
+      if (node->dag.implicit()) {
+        node->dag.set_default_locality(loc);
+      }
+      heights[i] = height;
     }
-
-    // Once the children are done, call aggregate here, continuing a set to
-    // done once that has happened.
-    assert(cdone != HPX_NULL);
-    hpx_call_when(cdone, HPX_HERE, source_apply_method_child_done_, HPX_NULL,
-                  &tree, &node, &cdone, &done);
-
     return HPX_SUCCESS;
   }
 
-  /// Action to apply Method::inherit and Method::process
-  ///
-  /// This is a parallel spawn through the tree to apply the method to the
-  /// given tree. This will generate the DAG.
+  /// Walker applying Method::inherit and Method::process
   ///
-  /// \param tree - the DualTree
-  /// \param node - the target node in question
-  /// \param consider - the list of source nodes to consider in process
-  /// \param same_sandt - is S == T for this evaluation
-  /// \param done - LCO to signal with completion
-  ///
-  /// \returns - HPX_SUCCESS
-  static int target_apply_method_handler(dualtree_t *tree, targetnode_t *node,
-                                         std::vector<sourcenode_t *> *consider,
-                                         int same_sandt, hpx_addr_t done) {
-    bool refine = false;
-    if (node->idx.level() < tree->unif_level_) {
-      refine = true;
-    } else if (node->n_children()) {
-      refine = tree->method_.refine_test((bool)same_sandt, node, *consider);
-    }
-
-    tree->method_.inherit(node, &tree->domain_, !refine);
-    tree->method_.process(node, *consider, !refine, &tree->domain_);
-
-    if (!refine) {
-      // If we are not refining, then we are at a target leaf. This means
-      // we should set the particle and normal DAG nodes to have this locality.
-
-      int dag_idx = targettree_t::get_unif_grid_index(node->idx,
-                                                      tree->unif_level_);
-      int dag_rank = tree->rank_of_unif_grid(dag_idx);
-      node->dag.set_parts_locality(dag_rank);
-      node->dag.set_normal_locality(dag_rank);
-
-      hpx_lco_set_lsync(done, 0, nullptr, HPX_NULL);
-    } else {
-      int n_children = node->n_children();
-      hpx_addr_t cdone = hpx_lco_and_new(n_children);
-      assert(cdone);
+  /// This walks the target tree, generating the DAG. Each node receives a
+  /// copy of the list of source nodes to consider left by its parent.
+  struct TargetMethodWalk {
+    using node_t = targetnode_t;
 
-      for (int i = 0; i < 8; ++i) {
-        if (node->child[i] == nullptr) continue;
-        std::vector<sourcenode_t *> *ccons =
-            new std::vector<sourcenode_t *>{};
-        *ccons = *consider;
-        hpx_call(HPX_HERE, target_apply_method_, HPX_NULL,
-                 &tree, &node->child[i], &ccons, &same_sandt, &cdone);
+    dualtree_t *tree;
+    int same_sandt;
+    std::vector<sourcenode_t *> consider;
+
+    bool enter(targetnode_t *node) {
+      bool refine = false;
+      if (node->idx.level() < tree->unif_level_) {
+        refine = true;
+      } else if (node->n_children()) {
+        refine = tree->method_.refine_test((bool)same_sandt, node, consider);
+      }
+
+      tree->method_.inherit(node, &tree->domain_, !refine);
+      tree->method_.process(node, consider, !refine, &tree->domain_);
+
+      if (!refine) {
+        // If we are not refining, then we are at a target leaf. This means
+        // we should set the particle and normal DAG nodes to have this
+        // locality.
+        int dag_idx = targettree_t::get_unif_grid_index(node->idx,
+                                                        tree->unif_level_);
+        int dag_rank = tree->rank_of_unif_grid(dag_idx);
+        node->dag.set_parts_locality(dag_rank);
+        node->dag.set_normal_locality(dag_rank);
+        return false;
       }
 
       int loc{0};
@@ -3002,15 +6338,129 @@ class DualTree {
         loc = tree->rank_of_unif_grid(dag_idx);
       }
       method_t::distropolicy_t::assign_for_target(node->dag, loc);
+      if (node->dag.implicit()) {
+        node->dag.set_default_locality(loc);
+      }
+      return true;
+    }
+
+    int leave(targetnode_t *node, int value) {return 0;}
+  };
+
+  /// An edge from a source leaf to a node on another rank, held until the
+  /// last edge leaving the leaf is found
+  struct RemoteEdge {
+    DAGEdge edge;
+    RemoteEdge *next;
+  };
 
-      assert(cdone != HPX_NULL);
-      hpx_call_when(cdone, cdone, hpx_lco_delete_action,
-                    done, nullptr, 0);
+  /// The state of the hand-off of the edges of an implicit DAG
+  struct ImplicitEmit {
+    ImplicitEmit(dualtree_t *t, hpx_addr_t rw, DAG *d, size_t n_leaves)
+        : tree{t}, rwtree{rw}, dag{d}, leaves(n_leaves, nullptr),
+          remote(n_leaves), held{0}, peak{0} {
+      for (size_t i = 0; i < n_leaves; ++i) {
+        remote[i].store(nullptr);
+      }
     }
 
-    delete consider;
+    dualtree_t *tree;
+    hpx_addr_t rwtree;
+    DAG *dag;
+    std::vector<sourcenode_t *> leaves;   /// the source leaves, by the id of
+                                          /// their DAG node
+    std::vector<std::atomic<RemoteEdge *>> remote;  /// the held edges of
+                                                     /// each source leaf
+    std::atomic<size_t> held;   /// bytes of edges held
+    std::atomic<size_t> peak;   /// the most bytes of edges held at once
+  };
 
-    return HPX_SUCCESS;
+  /// Hand an edge leaving a node of an implicit DAG to the LCO serving it
+  ///
+  /// This is the DAGImplicit::put used by emit_DAG(). An edge leaving a
+  /// source leaf is stored in the DAG if it keeps them, and otherwise starts
+  /// the evaluation along that edge, or is held if its target is on another
+  /// rank. Only nodes whose work is done on this rank are handed off; see
+  /// DAG::add_edge().
+  ///
+  /// \param context - the ImplicitEmit
+  /// \param node - the DAG node
+  /// \param slot - the slot of the edge among those leaving @p node
+  /// \param edge - the edge
+  static void put_implicit_edge(void *context, DAGNode *node, uint32_t slot,
+                                const DAGEdge &edge) {
+    assert(node->locality == hpx_get_my_rank());
+
+    ImplicitEmit *emit = static_cast<ImplicitEmit *>(context);
+    if (node->id >= emit->leaves.size()) {
+      expansionlco_t expand{node->global_addx};
+      expand.set_out_edge(slot, edge);
+      return;
+    }
+
+    if (emit->dag->keeps_leaf_edges()) {
+      emit->dag->store_out_edge(node, slot, edge);
+    }
+
+    if (edge.target->locality == hpx_get_my_rank()) {
+      // NOTE: the work at the leaves dominates, so each edge is given its
+      // own action.
+      sourcenode_t *leaf = emit->leaves[node->id];
+      DAGNode *target = edge.target;
+      int op = static_cast<int>(edge.op);
+      hpx_call(HPX_HERE, instigate_edge_, HPX_NULL,
+               &emit->tree, &leaf, &target, &op);
+      return;
+    }
+
+    RemoteEdge *rec = new RemoteEdge{edge, nullptr};
+    std::atomic<RemoteEdge *> &head = emit->remote[node->id];
+    RemoteEdge *next = head.load();
+    do {
+      rec->next = next;
+    } while (!head.compare_exchange_weak(next, rec));
+
+    size_t held = emit->held.fetch_add(sizeof(RemoteEdge))
+                  + sizeof(RemoteEdge);
+    size_t peak = emit->peak.load();
+    while (held > peak && !emit->peak.compare_exchange_weak(peak, held)) { }
+  }
+
+  /// Finish the hand-off of the edges leaving a node of an implicit DAG
+  ///
+  /// This is the DAGImplicit::close used by emit_DAG(). The LCO serving the
+  /// node is set with the edges put to it, or, for a source leaf, the held
+  /// edges are sent along with the sources of the leaf.
+  ///
+  /// \param context - the ImplicitEmit
+  /// \param node - the DAG node
+  static void close_implicit_node(void *context, DAGNode *node) {
+    ImplicitEmit *emit = static_cast<ImplicitEmit *>(context);
+    if (node->id >= emit->leaves.size()) {
+      expansionlco_t expand{node->global_addx};
+      expand.finish_out_edge_data();
+      return;
+    }
+
+    RemoteEdge *rec = emit->remote[node->id].exchange(nullptr);
+    if (rec == nullptr) {
+      return;
+    }
+
+    std::vector<DAGEdge> *out_edges = new std::vector<DAGEdge>{};
+    size_t bytes = 0;
+    while (rec != nullptr) {
+      RemoteEdge *next = rec->next;
+      out_edges->push_back(rec->edge);
+      delete rec;
+      bytes += sizeof(RemoteEdge);
+      rec = next;
+    }
+    emit->held.fetch_sub(bytes);
+
+    sourcenode_t *leaf = emit->leaves[node->id];
+    hpx_call(HPX_HERE, instigate_implicit_, HPX_NULL,
+             &emit->tree, &emit->rwtree, &leaf, &out_edges);
   }
 
   /// Action to set up termination detection for the DAG evaluation
@@ -3101,12 +6551,242 @@ class DualTree {
     return HPX_SUCCESS;
   }
 
+  /// Action to reset the DAG LCOs
+  ///
+  /// \param nodes - the DAG nodes
+  /// \param n_nodes - the number of nodes
+  /// \param type - 0 for expansion LCOs, 1 for target LCOs
+  ///
+  /// \returns - HPX_SUCCESS
+  static int reset_DAG_LCOs_handler(DAGNode **nodes, size_t n_nodes,
+                                    int type) {
+    int myrank = hpx_get_my_rank();
+    for (size_t i = 0; i < n_nodes; ++i) {
+      if (nodes[i]->locality == myrank) {
+        assert(nodes[i]->global_addx != HPX_NULL);
+        if (type) {
+          auto temp = targetlco_t{nodes[i]->global_addx, 0};
+          temp.reset();
+        } else {
+          auto temp = expansionlco_t{nodes[i]->global_addx};
+          temp.reset();
+        }
+      }
+    }
+
+    return HPX_SUCCESS;
+  }
+
+  /// Action to mark the edge lists of reset expansion LCOs as set
+  ///
+  /// \param snodes - source DAG nodes
+  /// \param n_snodes - the number of source nodes
+  /// \param tnodes - target DAG nodes
+  /// \param n_tnodes - the number of target nodes
+  ///
+  /// \returns - HPX_SUCCESS
+  static int reuse_edge_lists_handler(DAGNode **snodes, size_t n_snodes,
+                                      DAGNode **tnodes, size_t n_tnodes) {
+    int myrank = hpx_get_my_rank();
+    for (size_t i = 0; i < n_snodes; ++i) {
+      if (snodes[i]->locality == myrank) {
+        expansionlco_t expand{snodes[i]->global_addx};
+        expand.reuse_out_edge_data();
+      }
+    }
+    for (size_t i = 0; i < n_tnodes; ++i) {
+      if (tnodes[i]->locality == myrank) {
+        expansionlco_t expand{tnodes[i]->global_addx};
+        expand.reuse_out_edge_data();
+      }
+    }
+    return HPX_SUCCESS;
+  }
+
+  /// Is a node below a uniform grid node owned by the given rank
+  ///
+  /// The nodes above the uniform level are taken to be owned by rank 0.
+  bool owns(Index idx, int rank) const {
+    int level = idx.level();
+    if (level < unif_level_) {
+      return rank == 0;
+    }
+    Index cell = idx.parent(level - unif_level_);
+    return rank_map_[morton_key(cell.x(), cell.y(), cell.z())] == rank;
+  }
+
+  /// Time the operation of an edge between expansions
+  ///
+  /// The operation is applied to an expansion of the right kind at the
+  /// source of the edge. The expansion is empty, which does not change the
+  /// amount of work.
+  ///
+  /// \param edge - the edge
+  ///
+  /// \returns - the time of the operation in microseconds
+  double time_edge(const DAGEdge &edge) const {
+    Index sidx = edge.source->idx;
+    Index tidx = edge.target->idx;
+    Point center = domain_.center_from_index(sidx);
+    double scale = expansion_t::compute_scale(sidx);
+    double s_size = domain_.size_from_level(sidx.level());
+    double t_size = domain_.size_from_level(tidx.level());
+
+    ExpansionRole role{kSourcePrimary};
+    if (edge.op == Operation::ItoI) {
+      role = kSourceIntermediate;
+    } else if (edge.op == Operation::ItoL) {
+      role = kTargetIntermediate;
+    } else if (edge.op == Operation::LtoL) {
+      role = kTargetPrimary;
+    }
+    expansion_t expand{center, scale, role};
+
+    std::unique_ptr<expansion_t> result{};
+    hpx_time_t begin = hpx_time_now();
+    switch (edge.op) {
+      case Operation::MtoM:
+        result = expand.M_to_M(sidx.which_child(), s_size);
+        break;
+      case Operation::MtoL:
+        result = expand.M_to_L(sidx, s_size, tidx);
+        break;
+      case Operation::LtoL:
+        result = expand.L_to_L(tidx.which_child(), t_size);
+        break;
+      case Operation::MtoI:
+        result = expand.M_to_I(sidx);
+        break;
+      case Operation::ItoI:
+        result = expand.I_to_I(sidx, s_size, tidx);
+        break;
+      case Operation::ItoL:
+        result = expand.I_to_L(tidx, t_size);
+        break;
+      default:
+        break;
+    }
+    hpx_time_t end = hpx_time_now();
+
+    return hpx_time_diff_us(begin, end);
+  }
+
+  /// Time the operations involving records on a few leaves of this rank
+  ///
+  /// The leaves are spread over the leaves of this rank. The targets are
+  /// copied, so that the results of the evaluation are not disturbed. Only
+  /// the operations that appear in the DAG are timed, as an Expansion need
+  /// not implement the others.
+  ///
+  /// \param count - the number of each operation in the DAG, indexed by
+  ///                 Operation
+  /// \param unit [out] - the time, in microseconds, of S->T per pair of
+  ///                     records, and of the other operations involving
+  ///                     records per record, indexed by Operation
+  void time_leaves(const size_t *count, double *unit) const {
+    int rank = hpx_get_my_rank();
+    std::vector<sourcenode_t *> sleaves{};
+    for (int i = 0; i < source_tree_->flat_size(); ++i) {
+      sourcenode_t *curr = source_tree_->flat_node(i);
+      if (curr->is_leaf() && curr->parts.n() && owns(curr->idx, rank)) {
+        sleaves.push_back(curr);
+      }
+    }
+    std::vector<targetnode_t *> tleaves{};
+    for (int i = 0; i < target_tree_->flat_size(); ++i) {
+      targetnode_t *curr = target_tree_->flat_node(i);
+      if (curr->is_leaf() && curr->parts.n() && owns(curr->idx, rank)) {
+        tleaves.push_back(curr);
+      }
+    }
+
+    const int kStoT = static_cast<int>(Operation::StoT);
+    const int kStoM = static_cast<int>(Operation::StoM);
+    const int kStoL = static_cast<int>(Operation::StoL);
+    const int kMtoT = static_cast<int>(Operation::MtoT);
+    const int kLtoT = static_cast<int>(Operation::LtoT);
+
+    size_t n_samples = std::min(sleaves.size(), tleaves.size());
+    n_samples = std::min(n_samples, size_t{kCostSamples});
+    std::vector<double> elapsed(static_cast<int>(Operation::ItoL) + 1, 0.0);
+    size_t n_pairs{0};
+    size_t n_src{0};
+    size_t n_tar{0};
+    for (size_t i = 0; i < n_samples; ++i) {
+      sourcenode_t *snode = sleaves[i * sleaves.size() / n_samples];
+      targetnode_t *tnode = tleaves[i * tleaves.size() / n_samples];
+      source_t *sources = snode->parts.data();
+      size_t ns = snode->parts.n();
+      std::vector<target_t> targets(tnode->parts.data(),
+                                    tnode->parts.data() + tnode->parts.n());
+      target_t *first = targets.data();
+      size_t nt = targets.size();
+      Point scenter = domain_.center_from_index(snode->idx);
+      double sscale = expansion_t::compute_scale(snode->idx);
+      Point tcenter = domain_.center_from_index(tnode->idx);
+      double tscale = expansion_t::compute_scale(tnode->idx);
+
+      hpx_time_t begin = hpx_time_now();
+      if (count[kStoT]) {
+        targetlco_t::direct(sources, ns, first, nt);
+      }
+      hpx_time_t end = hpx_time_now();
+      elapsed[kStoT] += hpx_time_diff_us(begin, end);
+
+      expansion_t local{ViewSet{kNoRoleNeeded, Point{0.0, 0.0, 0.0}, sscale}};
+      std::unique_ptr<expansion_t> result{};
+      begin = hpx_time_now();
+      if (count[kStoM]) {
+        result = local.S_to_M(scenter, sources, &sources[ns]);
+      }
+      end = hpx_time_now();
+      elapsed[kStoM] += hpx_time_diff_us(begin, end);
+
+      begin = hpx_time_now();
+      if (count[kStoL]) {
+        result = local.S_to_L(scenter, sources, &sources[ns]);
+      }
+      end = hpx_time_now();
+      elapsed[kStoL] += hpx_time_diff_us(begin, end);
+
+      expansion_t multi{tcenter, tscale, kSourcePrimary};
+      begin = hpx_time_now();
+      if (count[kMtoT]) {
+        multi.M_to_T(first, &first[nt]);
+      }
+      end = hpx_time_now();
+      elapsed[kMtoT] += hpx_time_diff_us(begin, end);
+
+      expansion_t lexp{tcenter, tscale, kTargetPrimary};
+      begin = hpx_time_now();
+      if (count[kLtoT]) {
+        lexp.L_to_T(first, &first[nt]);
+      }
+      end = hpx_time_now();
+      elapsed[kLtoT] += hpx_time_diff_us(begin, end);
+
+      n_pairs += ns * nt;
+      n_src += ns;
+      n_tar += nt;
+    }
+
+    if (n_samples) {
+      unit[kStoT] = elapsed[kStoT] / n_pairs;
+      unit[kStoM] = elapsed[kStoM] / n_src;
+      unit[kStoL] = elapsed[kStoL] / n_src;
+      unit[kMtoT] = elapsed[kMtoT] / n_tar;
+      unit[kLtoT] = elapsed[kLtoT] / n_tar;
+    }
+  }
+
   //
   // Now for the data members
   //
 
   DomainGeometry domain_;     /// domain size
   int refinement_limit_;      /// refinement threshold
+  int target_limit_;          /// refinement threshold of the target tree
+  int adaptive_;              /// adapt the thresholds to the density
   int unif_level_;            /// level of uniform partition
   int dim3_;                  /// number of uniform nodes
   hpx_addr_t unif_count_;     /// LCO reducing the uniform counts
@@ -3120,25 +6800,52 @@ class DualTree {
 
   int same_sandt_;            /// Made from the same sources and targets
 
+  hpx_addr_t grouped_src_;    /// grouped sources for zero-copy exchange
+  hpx_addr_t grouped_tar_;    /// grouped targets for zero-copy exchange
+  bool grouped_in_gas_;       /// the grouped points are offered from the
+                              /// global address space
+  hpx_addr_t movers_arrived_; /// records arrived from other ranks in update
+  DAG *kept_dag_;             /// the DAG kept for another evaluation; see
+                              /// keep_DAG()
+
+  /// The number of parcels in flight from a rank when streaming points
+  static constexpr int kExchangeSlots = 4;
+
+  /// The most by which set_leaf_limits() scales a threshold
+  static constexpr int kMaxLimitScale = 64;
+
+  /// The number of leaves or edges on which each operation is timed by
+  /// estimate_cost()
+  static constexpr size_t kCostSamples = 8;
 
   static hpx_action_t domain_geometry_init_;
   static hpx_action_t domain_geometry_op_;
   static hpx_action_t set_domain_geometry_;
+  static hpx_action_t sample_unif_grid_;
   static hpx_action_t init_partition_;
   static hpx_action_t recv_points_;
   static hpx_action_t send_points_;
+  static hpx_action_t offer_points_;
+  static hpx_action_t recv_offer_;
   static hpx_action_t create_dual_tree_;
+  static hpx_action_t update_dual_tree_;
+  static hpx_action_t recv_movers_;
   static hpx_action_t finalize_partition_;
-  static hpx_action_t source_apply_method_;
-  static hpx_action_t source_apply_method_child_done_;
-  static hpx_action_t target_apply_method_;
+  static hpx_action_t delete_unif_cost_;
+  static hpx_action_t export_tree_;
+  static hpx_action_t import_tree_;
+  static hpx_action_t collect_statistics_;
   static hpx_action_t destroy_DAG_LCOs_;
+  static hpx_action_t reset_DAG_LCOs_;
   static hpx_action_t termination_detection_;
-  static hpx_action_t create_S_expansions_from_DAG_;
-  static hpx_action_t create_T_expansions_from_DAG_;
   static hpx_action_t edge_lists_;
-  static hpx_action_t instigate_dag_eval_;
+  static hpx_action_t reuse_edge_lists_;
   static hpx_action_t instigate_dag_eval_remote_;
+  static hpx_action_t source_method_nodes_;
+  static hpx_action_t create_expansions_nodes_;
+  static hpx_action_t instigate_dag_eval_;
+  static hpx_action_t instigate_implicit_;
+  static hpx_action_t instigate_edge_;
 };
 
 template <typename S, typename T,
@@ -3159,6 +6866,12 @@ template <typename S, typename T,
                     template <typename, typename> class> class M>
 hpx_action_t DualTree<S, T, E, M>::set_domain_geometry_ = HPX_ACTION_NULL;
 
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::sample_unif_grid_ = HPX_ACTION_NULL;
+
 template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
@@ -3177,12 +6890,36 @@ template <typename S, typename T,
                     template <typename, typename> class> class M>
 hpx_action_t DualTree<S, T, E, M>::send_points_ = HPX_ACTION_NULL;
 
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::offer_points_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::recv_offer_ = HPX_ACTION_NULL;
+
 template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
 hpx_action_t DualTree<S, T, E, M>::create_dual_tree_ = HPX_ACTION_NULL;
 
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::update_dual_tree_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::recv_movers_ = HPX_ACTION_NULL;
+
 template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
@@ -3193,20 +6930,25 @@ template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
-hpx_action_t DualTree<S, T, E, M>::source_apply_method_ = HPX_ACTION_NULL;
+hpx_action_t DualTree<S, T, E, M>::delete_unif_cost_ = HPX_ACTION_NULL;
 
 template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
-hpx_action_t DualTree<S, T, E, M>::source_apply_method_child_done_ =
-    HPX_ACTION_NULL;
+hpx_action_t DualTree<S, T, E, M>::export_tree_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::import_tree_ = HPX_ACTION_NULL;
 
 template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
-hpx_action_t DualTree<S, T, E, M>::target_apply_method_ = HPX_ACTION_NULL;
+hpx_action_t DualTree<S, T, E, M>::collect_statistics_ = HPX_ACTION_NULL;
 
 template <typename S, typename T,
           template <typename, typename> class E,
@@ -3214,6 +6956,12 @@ template <typename S, typename T,
                     template <typename, typename> class> class M>
 hpx_action_t DualTree<S, T, E, M>::destroy_DAG_LCOs_ = HPX_ACTION_NULL;
 
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::reset_DAG_LCOs_ = HPX_ACTION_NULL;
+
 template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
@@ -3224,21 +6972,32 @@ template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
-hpx_action_t DualTree<S, T, E, M>::create_S_expansions_from_DAG_ =
-    HPX_ACTION_NULL;
+hpx_action_t DualTree<S, T, E, M>::edge_lists_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::reuse_edge_lists_ = HPX_ACTION_NULL;
 
 template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
-hpx_action_t DualTree<S, T, E, M>::create_T_expansions_from_DAG_ =
+hpx_action_t DualTree<S, T, E, M>::instigate_dag_eval_remote_ =
     HPX_ACTION_NULL;
 
 template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
-hpx_action_t DualTree<S, T, E, M>::edge_lists_ = HPX_ACTION_NULL;
+hpx_action_t DualTree<S, T, E, M>::source_method_nodes_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::create_expansions_nodes_ = HPX_ACTION_NULL;
 
 template <typename S, typename T,
           template <typename, typename> class E,
@@ -3250,8 +7009,13 @@ template <typename S, typename T,
           template <typename, typename> class E,
           template <typename, typename,
                     template <typename, typename> class> class M>
-hpx_action_t DualTree<S, T, E, M>::instigate_dag_eval_remote_ =
-    HPX_ACTION_NULL;
+hpx_action_t DualTree<S, T, E, M>::instigate_implicit_ = HPX_ACTION_NULL;
+
+template <typename S, typename T,
+          template <typename, typename> class E,
+          template <typename, typename,
+                    template <typename, typename> class> class M>
+hpx_action_t DualTree<S, T, E, M>::instigate_edge_ = HPX_ACTION_NULL;
 
 
 } // namespace dashmm
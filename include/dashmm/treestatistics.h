@@ -0,0 +1,172 @@
+// =============================================================================
+//  Dynamic Adaptive System for Hierarchical Multipole Methods (DASHMM)
+//
+//  Copyright (c) 2015-2017, Trustees of Indiana University,
+//  All rights reserved.
+//
+//  This software may be modified and distributed under the terms of the BSD
+//  license. See the LICENSE file for details.
+//
+//  This software was created at the Indiana University Center for Research in
+//  Extreme Scale Technologies (CREST).
+// =============================================================================
+
+
+#ifndef __DASHMM_TREE_STATISTICS_H__
+#define __DASHMM_TREE_STATISTICS_H__
+
+
+/// \file
+/// \brief Statistics describing the shape of a partitioned tree
+
+
+#include <cstddef>
+#include <cstdio>
+
+#include <vector>
+
+
+namespace dashmm {
+
+
+/// The shape of one of the trees of a partitioned DualTree
+///
+/// The statistics are gathered on each rank, and reduced by summation into a
+/// single buffer of values. The layout of that buffer is given by this
+/// object; see count_node() and set_rank().
+class TreeShape {
+ public:
+  /// The number of levels for which statistics are kept
+  ///
+  /// Only the trees partitioned by Morton keys have a depth limit, so the
+  /// last level also counts the nodes of any deeper level; see deeper().
+  static constexpr int kLevels = 32;
+
+  /// The number of bins in the histogram of leaf occupancy
+  static constexpr int kOccupancyBins = 32;
+
+  TreeShape() : nodes(kLevels, 0), leaves(kLevels, 0),
+                occupancy(kOccupancyBins, 0), rank_points{}, rank_nodes{} { }
+
+  /// The number of values in the buffer for one tree
+  ///
+  /// \param num_ranks - the number of ranks
+  static size_t packed_size(int num_ranks) {
+    return 2 * kLevels + kOccupancyBins + 2 * num_ranks;
+  }
+
+  /// The bin of the occupancy histogram for a leaf
+  ///
+  /// \param n - the number of records in the leaf
+  ///
+  /// \returns - zero if @p n is zero; otherwise b such that @p n is at least
+  ///            2^(b - 1) and less than 2^b, up to the last bin
+  static int occupancy_bin(size_t n);
+
+  /// Add a node to a buffer of statistics
+  ///
+  /// A node deeper than the last level is counted with the last level. A
+  /// negative level is an error, which stops the program.
+  ///
+  /// \param data - the buffer
+  /// \param level - the level of the node
+  /// \param leaf - is the node a leaf
+  /// \param n - the number of records in the node; only used for leaves
+  static void count_node(size_t *data, int level, bool leaf, size_t n);
+
+  /// Set the counts of one rank in a buffer of statistics
+  ///
+  /// \param data - the buffer
+  /// \param num_ranks - the number of ranks
+  /// \param rank - the rank
+  /// \param points - the number of records on @p rank
+  /// \param n_nodes - the number of nodes on @p rank
+  static void set_rank(size_t *data, int num_ranks, int rank, size_t points,
+                       size_t n_nodes);
+
+  /// Set this object from a buffer of statistics
+  ///
+  /// \param data - the buffer
+  /// \param num_ranks - the number of ranks
+  void unpack(const size_t *data, int num_ranks);
+
+  /// The deepest level with any nodes
+  ///
+  /// If deeper() is true, the tree may be deeper still.
+  int depth() const;
+
+  /// Are there nodes at the last level, which also counts deeper nodes
+  bool deeper() const {return nodes[kLevels - 1] != 0;}
+
+  /// The total number of nodes
+  size_t total_nodes() const;
+
+  /// The total number of leaves
+  size_t total_leaves() const;
+
+  /// The total number of records
+  size_t total_points() const;
+
+  /// The largest number of records on a rank divided by the average
+  double point_imbalance() const;
+
+  /// The largest number of nodes on a rank divided by the average
+  double node_imbalance() const;
+
+  /// Print a summary
+  ///
+  /// \param out - the stream to which to print
+  /// \param name - the name of the tree
+  void print(FILE *out, const char *name) const;
+
+  std::vector<size_t> nodes;        /// the number of nodes at each level
+  std::vector<size_t> leaves;       /// the number of leaves at each level
+  std::vector<size_t> occupancy;    /// leaves by number of records; see
+                                    /// occupancy_bin()
+  std::vector<size_t> rank_points;  /// the number of records on each rank
+  std::vector<size_t> rank_nodes;   /// the number of nodes below the uniform
+                                    /// level owned by each rank
+};
+
+
+/// The shape of a partitioned DualTree
+///
+/// See Evaluator::tree_statistics().
+struct TreeStatistics {
+  /// The number of values in the buffer for both trees
+  ///
+  /// \param num_ranks - the number of ranks
+  static size_t packed_size(int num_ranks) {
+    return 2 * TreeShape::packed_size(num_ranks);
+  }
+
+  /// Set this object from a buffer of statistics
+  ///
+  /// The source tree comes first in the buffer, followed by the target tree.
+  ///
+  /// \param data - the buffer
+  /// \param num_ranks - the number of ranks
+  void unpack(const size_t *data, int num_ranks) {
+    source.unpack(data, num_ranks);
+    target.unpack(data + TreeShape::packed_size(num_ranks), num_ranks);
+  }
+
+  /// Print a summary of both trees
+  ///
+  /// \param out - the stream to which to print
+  void print(FILE *out) const {
+    fprintf(out, "Tree: uniform level %d\n", unif_level);
+    source.print(out, "Source tree");
+    target.print(out, "Target tree");
+  }
+
+  int unif_level;       /// the level of the uniform partition
+  TreeShape source;     /// the source tree
+  TreeShape target;     /// the target tree
+};
+
+
+} // namespace dashmm
+
+
+#endif // __DASHMM_TREE_STATISTICS_H__
@@ -0,0 +1,301 @@
+// =============================================================================
+//  Dynamic Adaptive System for Hierarchical Multipole Methods (DASHMM)
+//
+//  Copyright (c) 2015-2017, Trustees of Indiana University,
+//  All rights reserved.
+//
+//  This software may be modified and distributed under the terms of the BSD
+//  license. See the LICENSE file for details.
+//
+//  This software was created at the Indiana University Center for Research in
+//  Extreme Scale Technologies (CREST).
+// =============================================================================
+
+
+#ifndef __DASHMM_TREE_WALK_H__
+#define __DASHMM_TREE_WALK_H__
+
+
+/// \file
+/// \brief Chunked parallel traversal of the branches of a tree
+
+
+#include <cassert>
+
+#include <algorithm>
+#include <vector>
+
+#include <hpx/hpx.h>
+
+#include "dashmm/reductionops.h"
+
+
+namespace dashmm {
+
+
+template <typename Walker>
+class TreeWalkRegistrar;
+
+
+/// The largest branch that a tree walk will process without spawning actions
+///
+/// This can be set at compile time with DASHMM_WALK_GRAIN. A grain of zero
+/// gives every node of the tree its own action.
+#ifdef DASHMM_WALK_GRAIN
+constexpr int kWalkGrain = DASHMM_WALK_GRAIN;
+#else
+constexpr int kWalkGrain = 64;
+#endif
+
+
+/// Parallel walk through the branch below a tree node
+///
+/// The walk visits each node twice: once on the way down, before any of its
+/// children, and once on the way up, after all of its children. Branches with
+/// more than a grain size of nodes are walked by separate HPX-5 actions, while
+/// those below the grain size are walked inline by the thread that reached
+/// them, without recursion, and without any LCOs.
+///
+/// The work of the walk is provided by the Walker type, which must be
+/// copyable, and which must provide the following:
+///
+///   using node_t = ...;
+///   bool enter(node_t *node);
+///   int leave(node_t *node, int value);
+///
+/// enter() is called on the way down. If it returns true, the children of
+/// the node are walked, each with a copy of the Walker made after enter()
+/// returns; this is how a Walker hands state down the tree. leave() is called
+/// on the way up, with the largest value returned by leave() at the children
+/// of the node, or zero if none were walked. The value returned from leave()
+/// at the starting node is the result of the walk.
+///
+/// The Walker objects at different nodes are used concurrently, so any state
+/// they share must be safe to use from several threads.
+template <typename Walker>
+class TreeWalk {
+ public:
+  using walker_t = Walker;
+  using node_t = typename Walker::node_t;
+
+  /// Walk the branch below a node and wait for the result
+  ///
+  /// \param walker - the Walker for the starting node
+  /// \param node - the starting node
+  /// \param grain - the largest branch to walk without spawning actions
+  ///
+  /// \returns - the value returned by leave() at @p node
+  static int run(const walker_t &walker, node_t *node,
+                 int grain = kWalkGrain) {
+    hpx_addr_t done = hpx_lco_future_new(sizeof(int));
+    assert(done != HPX_NULL);
+    start(walker, node, grain, done);
+    int retval{0};
+    hpx_lco_get(done, sizeof(int), &retval);
+    hpx_lco_delete_sync(done);
+    return retval;
+  }
+
+  /// Start a walk of the branch below a node
+  ///
+  /// This is an asynchronous operation. If @p done is HPX_NULL, the walk is
+  /// not tracked, and Walker::leave() is never called.
+  ///
+  /// \param walker - the Walker for the starting node
+  /// \param node - the starting node
+  /// \param grain - the largest branch to walk without spawning actions
+  /// \param done - LCO set with the int result of the walk; may be HPX_NULL
+  static void start(const walker_t &walker, node_t *node, int grain,
+                    hpx_addr_t done) {
+    walker_t *copy = new walker_t{walker};
+    hpx_call(HPX_HERE, visit_, HPX_NULL, &copy, &node, &grain, &done);
+  }
+
+  /// Walk the branch below a node in the calling thread
+  ///
+  /// \param walker - the Walker for the starting node
+  /// \param node - the starting node
+  /// \param tracked - should Walker::leave() be called
+  ///
+  /// \returns - the value returned by leave() at @p node, or zero if the walk
+  ///            is not tracked
+  static int walk(const walker_t &walker, node_t *node, bool tracked = true) {
+    // NOTE: the implementation is not recursive because HPX-5 can work with
+    // small stack sizes. The children of a node are pushed in reverse order
+    // so that they are walked in order.
+    std::vector<Frame> stack{};
+    stack.push_back(Frame{walker, node, -1});
+
+    int retval{0};
+    while (!stack.empty()) {
+      int top = (int)stack.size() - 1;
+      if (!stack[top].entered) {
+        stack[top].entered = true;
+        if (stack[top].walker.enter(stack[top].node)) {
+          node_t *curr = stack[top].node;
+          for (int i = 7; i >= 0; --i) {
+            if (curr->child[i] != nullptr) {
+              stack.push_back(Frame{stack[top].walker, curr->child[i], top});
+            }
+          }
+        }
+      } else {
+        Frame &curr = stack[top];
+        int value{0};
+        if (tracked) {
+          value = curr.walker.leave(curr.node, curr.value);
+        }
+        int parent = curr.parent;
+        stack.pop_back();
+        if (parent >= 0) {
+          stack[parent].value = std::max(stack[parent].value, value);
+        } else {
+          retval = value;
+        }
+      }
+    }
+
+    return retval;
+  }
+
+ private:
+  friend class TreeWalkRegistrar<Walker>;
+
+  /// A node awaiting its visits during an inline walk
+  struct Frame {
+    walker_t walker;      /// the Walker for this node
+    node_t *node;         /// the node
+    int parent;           /// index of the frame of the parent
+    int value;            /// largest value from the children
+    bool entered;         /// has enter() been called
+
+    Frame(const walker_t &w, node_t *n, int p)
+        : walker{w}, node{n}, parent{p}, value{0}, entered{false} { }
+  };
+
+  /// Decide if the branch below a node is small enough to walk inline
+  ///
+  /// This counts the nodes of the branch, but gives up once the count
+  /// exceeds @p grain, so the cost is bounded by the grain size.
+  ///
+  /// \param node - the node
+  /// \param grain - the largest branch to walk inline
+  ///
+  /// \returns - true if the branch has at most @p grain nodes
+  static bool small_branch(const node_t *node, int grain) {
+    if (grain <= 0) return false;
+    std::vector<const node_t *> V{node};
+    int count{0};
+    while (!V.empty()) {
+      const node_t *curr = V.back();
+      V.pop_back();
+      if (++count > grain) return false;
+      for (int i = 0; i < 8; ++i) {
+        if (curr->child[i] != nullptr) {
+          V.push_back(curr->child[i]);
+        }
+      }
+    }
+    return true;
+  }
+
+  /// Action visiting a node with a branch larger than the grain size
+  ///
+  /// The large branches below the children of @p node are spawned as
+  /// separate actions, and the small branches are walked inline. If any
+  /// actions were spawned, leaving @p node is continued once they are done.
+  ///
+  /// \param walker - the Walker for this node; this is deleted by the walk
+  /// \param node - the node
+  /// \param grain - the largest branch to walk without spawning actions
+  /// \param done - LCO to set with the result; may be HPX_NULL
+  ///
+  /// \returns - HPX_SUCCESS
+  static int visit_handler(walker_t *walker, node_t *node, int grain,
+                           hpx_addr_t done) {
+    bool tracked = (done != HPX_NULL);
+    int value{0};
+    hpx_addr_t cdone{HPX_NULL};
+
+    if (walker->enter(node)) {
+      node_t *large[8];
+      node_t *small[8];
+      int n_large{0};
+      int n_small{0};
+      for (int i = 0; i < 8; ++i) {
+        if (node->child[i] == nullptr) continue;
+        if (small_branch(node->child[i], grain)) {
+          small[n_small++] = node->child[i];
+        } else {
+          large[n_large++] = node->child[i];
+        }
+      }
+
+      // The inline work of this action is one more input to the reduction
+      if (n_large && tracked) {
+        cdone = hpx_lco_reduce_new(n_large + 1, sizeof(int),
+                                   int_max_ident_op, int_max_op);
+        assert(cdone != HPX_NULL);
+      }
+      for (int i = 0; i < n_large; ++i) {
+        walker_t *copy = new walker_t{*walker};
+        hpx_call(HPX_HERE, visit_, HPX_NULL, &copy, &large[i], &grain, &cdone);
+      }
+
+      for (int i = 0; i < n_small; ++i) {
+        value = std::max(value, walk(*walker, small[i], tracked));
+      }
+    }
+
+    if (cdone != HPX_NULL) {
+      hpx_lco_set(cdone, sizeof(int), &value, HPX_NULL, HPX_NULL);
+      hpx_call_when(cdone, HPX_HERE, leave_, HPX_NULL,
+                    &walker, &node, &cdone, &done);
+      return HPX_SUCCESS;
+    }
+
+    if (tracked) {
+      value = walker->leave(node, value);
+      hpx_lco_set(done, sizeof(int), &value, HPX_NULL, HPX_NULL);
+    }
+    delete walker;
+
+    return HPX_SUCCESS;
+  }
+
+  /// Action leaving a node once its spawned children are done
+  ///
+  /// \param walker - the Walker for this node; this is deleted here
+  /// \param node - the node
+  /// \param cdone - the reduction over the children; this is deleted here
+  /// \param done - LCO to set with the result
+  ///
+  /// \returns - HPX_SUCCESS
+  static int leave_handler(walker_t *walker, node_t *node, hpx_addr_t cdone,
+                           hpx_addr_t done) {
+    int value{0};
+    hpx_lco_get(cdone, sizeof(int), &value);
+    hpx_lco_delete_sync(cdone);
+
+    value = walker->leave(node, value);
+    hpx_lco_set(done, sizeof(int), &value, HPX_NULL, HPX_NULL);
+    delete walker;
+
+    return HPX_SUCCESS;
+  }
+
+  static hpx_action_t visit_;
+  static hpx_action_t leave_;
+};
+
+template <typename W>
+hpx_action_t TreeWalk<W>::visit_ = HPX_ACTION_NULL;
+
+template <typename W>
+hpx_action_t TreeWalk<W>::leave_ = HPX_ACTION_NULL;
+
+
+} // namespace dashmm
+
+
+#endif // __DASHMM_TREE_WALK_H__
@@ -25,12 +25,15 @@ namespace dashmm {
 
 
 void BHDistro::compute_distribution(DAG &dag) {
+  // The nodes of an implicit DAG are placed as it is created
+  if (distribution_complete(dag)) return;
+
   std::queue<DAGNode *> nodes = collect_readies(dag);
 
   while (!nodes.empty()) {
     DAGNode *curr = nodes.front();
-    compute_locality(curr);
-    mark_upstream_nodes(curr, nodes);
+    compute_locality(dag, curr);
+    mark_upstream_nodes(dag, curr, nodes);
     nodes.pop();
   }
 }
@@ -43,19 +46,19 @@ std::queue<DAGNode *> BHDistro::collect_readies(DAG &dag) {
   std::queue<DAGNode *> retval{};
 
   for (size_t i = 0; i < dag.source_nodes.size(); ++i) {
-    if (dag.source_nodes[i]->out_edges.size() == 0) {
+    if (dag.out_degree(dag.source_nodes[i]) == 0) {
       retval.push(dag.source_nodes[i]);
     }
   }
 
   for (size_t i = 0; i < dag.target_nodes.size(); ++i) {
-    if (dag.target_nodes[i]->out_edges.size() == 0) {
+    if (dag.out_degree(dag.target_nodes[i]) == 0) {
       retval.push(dag.target_nodes[i]);
     }
   }
 
   for (size_t i = 0; i < dag.target_leaves.size(); ++i) {
-    assert(dag.target_leaves[i]->out_edges.size() == 0);
+    assert(dag.out_degree(dag.target_leaves[i]) == 0);
     retval.push(dag.target_leaves[i]);
   }
 
@@ -63,7 +66,7 @@ std::queue<DAGNode *> BHDistro::collect_readies(DAG &dag) {
 }
 
 
-void BHDistro::compute_locality(DAGNode *node) {
+void BHDistro::compute_locality(DAG &dag, DAGNode *node) {
   // It already has a locality
   if (node->locality >= 0) return;
 
@@ -71,17 +74,18 @@ void BHDistro::compute_locality(DAGNode *node) {
   // at random. A better idea might be to wait until all others are placed
   // ignorning this node, and then pick the best given the localities of the
   // upstream nodes, but for now, we do something simple.
-  if (node->out_edges.size() == 0) {
+  std::vector<DAGEdge> out_edges = dag.out_edges(node);
+  if (out_edges.size() == 0) {
     node->locality = 0;
   }
 
   // The typical case; count up weights to each locality
   int n_ranks = hpx_get_num_ranks();
   std::vector<int> bins(n_ranks, 0);
-  for (size_t i = 0; i < node->out_edges.size(); ++i) {
-    int loc = node->out_edges[i].target->locality;
+  for (size_t i = 0; i < out_edges.size(); ++i) {
+    int loc = out_edges[i].target->locality;
     assert(loc >= 0 && loc < n_ranks);
-    bins[loc] += node->out_edges[i].weight;
+    bins[loc] += out_edges[i].weight;
   }
 
   // Find max - currently, the lowest locality in a tie will win.
@@ -99,15 +103,16 @@ void BHDistro::compute_locality(DAGNode *node) {
 }
 
 
-void BHDistro::mark_upstream_nodes(DAGNode *node,
+void BHDistro::mark_upstream_nodes(DAG &dag, DAGNode *node,
                                    std::queue<DAGNode *> &master) {
   assert(node->locality >= 0);  // Need to be sure that the locality is set.
 
-  for (size_t i = 0; i < node->in_edges.size(); ++i) {
-    node->in_edges[i].source->color += 1;
-    if ((size_t)node->in_edges[i].source->color
-            == node->in_edges[i].source->out_edges.size()) {
-      master.push(node->in_edges[i].source);
+  std::vector<DAGEdge> in_edges = dag.in_edges(node);
+  for (size_t i = 0; i < in_edges.size(); ++i) {
+    in_edges[i].source->color += 1;
+    if ((size_t)in_edges[i].source->color
+            == dag.out_degree(in_edges[i].source)) {
+      master.push(in_edges[i].source);
     }
   }
 }
@@ -13,7 +13,7 @@
 
 
 /// \file
-/// \brief Implementation of JSON format DAG output
+/// \brief Implementation of the DAG, and of JSON format DAG output
 ///
 /// The intent of this file it to make an easily digestible form of the
 /// DAG information for use in visualization tools. This implements JSON
@@ -29,7 +29,9 @@
 
 #include "dashmm/dag.h"
 
+#include <cassert>
 #include <cstdio>
+#include <cstdlib>
 
 #include <algorithm>
 #include <limits>
@@ -179,13 +181,13 @@ bool skip_SandT_operations(Operation op) {
 }
 
 
-void append_out_edges(std::map<const DAGNode *, int> &dtoi,
+void append_out_edges(std::map<const DAGNode *, int> &dtoi, const DAG &dag,
                       const std::vector<DAGNode *> &nodes,
                       std::vector<Edge> &edges) {
   // loop over the nodes
   for (size_t i = 0; i < nodes.size(); ++i) {
     // loop over the out edges
-    std::vector<DAGEdge> &out = nodes[i]->out_edges;
+    std::vector<DAGEdge> out = dag.out_edges(nodes[i]);
     for (size_t j = 0; j < out.size(); ++j) {
       if (skip_SandT_operations(out[j].op)) continue;
       edges.emplace_back(
@@ -200,9 +202,9 @@ std::vector<Edge> create_edges(std::map<const DAGNode *, int> &dtoi,
                                DAG &dag) {
   std::vector<Edge> retval{};
 
-  append_out_edges(dtoi, dag.source_leaves, retval);
-  append_out_edges(dtoi, dag.source_nodes, retval);
-  append_out_edges(dtoi, dag.target_nodes, retval);
+  append_out_edges(dtoi, dag, dag.source_leaves, retval);
+  append_out_edges(dtoi, dag, dag.source_nodes, retval);
+  append_out_edges(dtoi, dag, dag.target_nodes, retval);
   // No target_leaves, as they have no out edges
 
   return retval;
@@ -219,9 +221,10 @@ std::vector<Node> create_nodes(std::map<const DAGNode *, int> &dtoi,
         = dag.source_leaves[i]->locality;
   }
   for (size_t i = 0; i < dag.source_nodes.size(); ++i) {
-    if (dag.source_nodes[i]->out_edges.size() == 0) {
+    std::vector<DAGEdge> out = dag.out_edges(dag.source_nodes[i]);
+    if (out.size() == 0) {
       retval[dtoi[dag.source_nodes[i]]].type = NodeType::Multipole;
-    } else if (is_edge_from_intermediate(dag.source_nodes[i]->out_edges[0].op)) {
+    } else if (is_edge_from_intermediate(out[0].op)) {
       retval[dtoi[dag.source_nodes[i]]].type = NodeType::Intermediate;
     } else {
       retval[dtoi[dag.source_nodes[i]]].type = NodeType::Multipole;
@@ -229,7 +232,8 @@ std::vector<Node> create_nodes(std::map<const DAGNode *, int> &dtoi,
     retval[dtoi[dag.source_nodes[i]]].locality = dag.source_nodes[i]->locality;
   }
   for (size_t i = 0; i < dag.target_nodes.size(); ++i) {
-    if (is_edge_from_intermediate(dag.target_nodes[i]->out_edges[0].op)) {
+    std::vector<DAGEdge> out = dag.out_edges(dag.target_nodes[i]);
+    if (is_edge_from_intermediate(out[0].op)) {
       retval[dtoi[dag.target_nodes[i]]].type = NodeType::Intermediate;
     } else {
       retval[dtoi[dag.target_nodes[i]]].type = NodeType::Local;
@@ -357,13 +361,15 @@ struct CSVEdge {
 };
 
 
-void add_out_edges_from_node(DAGNode *node, std::vector<CSVEdge> &edges) {
-  for (size_t i = 0; i < node->out_edges.size(); ++i) {
+void add_out_edges_from_node(const DAG &dag, DAGNode *node,
+                             std::vector<CSVEdge> &edges) {
+  std::vector<DAGEdge> out = dag.out_edges(node);
+  for (size_t i = 0; i < out.size(); ++i) {
     edges.emplace_back(CSVEdge{node->idx, node->locality,
-                               node->out_edges[i].op,
-                               node->out_edges[i].target->idx,
-                               node->out_edges[i].target->locality,
-                               node, node->out_edges[i].target});
+                               out[i].op,
+                               out[i].target->idx,
+                               out[i].target->locality,
+                               node, out[i].target});
   }
 }
 
@@ -372,15 +378,15 @@ std::vector<CSVEdge> create_csv_edges(DAG &dag) {
   std::vector<CSVEdge> retval{};
 
   for (size_t i = 0; i < dag.source_leaves.size(); ++i) {
-    add_out_edges_from_node(dag.source_leaves[i], retval);
+    add_out_edges_from_node(dag, dag.source_leaves[i], retval);
   }
 
   for (size_t i = 0; i < dag.source_nodes.size(); ++i) {
-    add_out_edges_from_node(dag.source_nodes[i], retval);
+    add_out_edges_from_node(dag, dag.source_nodes[i], retval);
   }
 
   for (size_t i = 0; i < dag.target_nodes.size(); ++i) {
-    add_out_edges_from_node(dag.target_nodes[i], retval);
+    add_out_edges_from_node(dag, dag.target_nodes[i], retval);
   }
 
   // No need for targets, as they have no out edges
@@ -427,6 +433,228 @@ bool csvedge_comp(CSVEdge a, CSVEdge b) {
 } // unnamed namespace
 
 
+void DAG::add_edge(DAGNode *source, DAGNode *target, Operation op,
+                   int weight) {
+  if (!implicit_) {
+    // NOTE: This does not suspend, so the thread cannot change.
+    int tid = hpx_get_my_thread_id();
+    assert(tid >= 0 && tid < (int)found_.size());
+    found_[tid].emplace_back(source, target, op, weight);
+    return;
+  }
+
+  if (handoff_ == nullptr) {
+    target->n_in.fetch_add(1, std::memory_order_relaxed);
+    source->n_out.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // Only the nodes whose work is done on this rank are handed their edges,
+  // so the edges leaving the other nodes are not kept at all.
+  if (source->locality != hpx_get_my_rank()) {
+    return;
+  }
+
+  // Each edge takes its own slot, so that the edges can be put
+  // concurrently, and the last edge to be put closes the node.
+  uint32_t n_out = source->n_out.load(std::memory_order_relaxed);
+  uint32_t slot = source->n_claimed.fetch_add(1);
+  assert(slot < n_out);
+  handoff_->put(handoff_->context, source, slot,
+                DAGEdge{source, target, op, weight});
+  if (source->n_stored.fetch_add(1) + 1 == n_out) {
+    handoff_->close(handoff_->context, source);
+  }
+}
+
+
+void DAG::finalize() {
+  static_assert(static_cast<int>(Operation::ItoL) < 256,
+                "Operation codes must fit in eight bits");
+
+  std::vector<DAGNode *> *groups[4] = {&source_leaves, &source_nodes,
+                                       &target_nodes, &target_leaves};
+
+  // Number the nodes
+  size_t n_nodes{0};
+  for (auto group : groups) {
+    for (auto node : *group) {
+      node->id = n_nodes++;
+    }
+  }
+  if (n_nodes >= std::numeric_limits<uint32_t>::max()) {
+    fprintf(stderr, "DAG: %zu nodes do not fit in 32 bit node ids\n",
+            n_nodes);
+    exit(-1);
+  }
+
+  in_offsets_.clear();
+  in_index_.clear();
+
+  // Count the edges leaving and entering each node
+  offsets_.assign(n_nodes + 1, 0);
+  in_degree_.assign(n_nodes, 0);
+  if (implicit_) {
+    // The edges were only counted
+    for (auto group : groups) {
+      for (auto node : *group) {
+        in_degree_[node->id] = node->n_in;
+        offsets_[node->id + 1] = node->n_out;
+      }
+    }
+  } else {
+    for (auto found = found_.begin(); found != found_.end(); ++found) {
+      for (auto edge = found->begin(); edge != found->end(); ++edge) {
+        offsets_[edge->source->id + 1] += 1;
+        uint32_t &degree = in_degree_[edge->target->id];
+        if (degree == std::numeric_limits<uint32_t>::max()) {
+          fprintf(stderr, "DAG: a node has more than %u in edges\n",
+                  degree);
+          exit(-1);
+        }
+        degree += 1;
+      }
+    }
+  }
+  for (size_t i = 0; i < n_nodes; ++i) {
+    offsets_[i + 1] += offsets_[i];
+  }
+
+  // Move the edges into place; the edges found by each thread are released
+  // as they are moved so that both forms are not held in full at once. An
+  // implicit DAG only has space for the edges of the source leaves, if they
+  // are kept, which are stored as they are emitted.
+  size_t n_edges = offsets_[n_nodes];
+  if (implicit_) {
+    n_edges = keep_leaves_ ? offsets_[source_leaves.size()] : 0;
+  }
+  targets_.resize(n_edges);
+  ops_.resize(n_edges);
+  weights_.resize(n_edges);
+  std::vector<size_t> next(offsets_.begin(), offsets_.end() - 1);
+  for (auto found = found_.begin(); found != found_.end(); ++found) {
+    for (auto edge = found->begin(); edge != found->end(); ++edge) {
+      size_t slot = next[edge->source->id]++;
+      targets_[slot] = edge->target->id;
+      ops_[slot] = static_cast<uint8_t>(edge->op);
+      weights_[slot] = edge->weight;
+    }
+    std::vector<DAGEdge>{}.swap(*found);
+  }
+  std::vector<std::vector<DAGEdge>>{}.swap(found_);
+}
+
+
+void DAG::store_out_edge(const DAGNode *node, uint32_t slot,
+                         const DAGEdge &edge) {
+  assert(implicit_ && keep_leaves_);
+  assert(node->id < source_leaves.size());
+  assert(slot < out_degree(node));
+  size_t place = offsets_[node->id] + slot;
+  targets_[place] = edge.target->id;
+  ops_[place] = static_cast<uint8_t>(edge.op);
+  weights_[place] = edge.weight;
+}
+
+
+void DAG::release_edges() {
+  if (keep_leaves_ && !offsets_.empty()) {
+    // The source leaves come first, so their edges are a prefix of the rest
+    size_t n_leaves = source_leaves.size();
+    size_t n_kept = offsets_[n_leaves];
+    offsets_.resize(n_leaves + 1);
+    offsets_.shrink_to_fit();
+    targets_.resize(n_kept);
+    targets_.shrink_to_fit();
+    ops_.resize(n_kept);
+    ops_.shrink_to_fit();
+    weights_.resize(n_kept);
+    weights_.shrink_to_fit();
+  } else {
+    std::vector<size_t>{}.swap(offsets_);
+    std::vector<uint32_t>{}.swap(targets_);
+    std::vector<uint8_t>{}.swap(ops_);
+    std::vector<int>{}.swap(weights_);
+  }
+  std::vector<uint32_t>{}.swap(in_degree_);
+  std::vector<size_t>{}.swap(in_offsets_);
+  std::vector<size_t>{}.swap(in_index_);
+}
+
+
+std::vector<DAGEdge> DAG::out_edges(const DAGNode *node) const {
+  // An implicit DAG, or one with released edges, holds at most the edges of
+  // the source leaves
+  assert(node->id + 1 < offsets_.size());
+  assert(offsets_[node->id + 1] <= targets_.size());
+  std::vector<DAGEdge> retval{};
+  size_t first = offsets_[node->id];
+  size_t last = offsets_[node->id + 1];
+  retval.reserve(last - first);
+  DAGNode *source = node_from_id(node->id);
+  for (size_t i = first; i < last; ++i) {
+    retval.emplace_back(source, node_from_id(targets_[i]),
+                        static_cast<Operation>(ops_[i]), weights_[i]);
+  }
+  return retval;
+}
+
+
+std::vector<DAGEdge> DAG::in_edges(const DAGNode *node) {
+  assert(!implicit_);
+  if (in_offsets_.empty()) {
+    index_in_edges();
+  }
+
+  std::vector<DAGEdge> retval{};
+  size_t first = in_offsets_[node->id];
+  size_t last = in_offsets_[node->id + 1];
+  retval.reserve(last - first);
+  DAGNode *target = node_from_id(node->id);
+  for (size_t i = first; i < last; ++i) {
+    size_t edge = in_index_[i];
+    retval.emplace_back(node_from_id(edge_source(edge)), target,
+                        static_cast<Operation>(ops_[edge]), weights_[edge]);
+  }
+  return retval;
+}
+
+
+DAGNode *DAG::node_from_id(uint32_t id) const {
+  const std::vector<DAGNode *> *groups[4] = {&source_leaves, &source_nodes,
+                                             &target_nodes, &target_leaves};
+  for (auto group : groups) {
+    if (id < group->size()) {
+      return (*group)[id];
+    }
+    id -= group->size();
+  }
+  assert(0 && "Node id out of range");
+  return nullptr;
+}
+
+
+uint32_t DAG::edge_source(size_t edge) const {
+  auto after = std::upper_bound(offsets_.begin(), offsets_.end(), edge);
+  return (after - offsets_.begin()) - 1;
+}
+
+
+void DAG::index_in_edges() {
+  size_t n_nodes = in_degree_.size();
+  in_offsets_.assign(n_nodes + 1, 0);
+  for (size_t i = 0; i < n_nodes; ++i) {
+    in_offsets_[i + 1] = in_offsets_[i] + in_degree_[i];
+  }
+
+  std::vector<size_t> next(in_offsets_.begin(), in_offsets_.end() - 1);
+  in_index_.resize(targets_.size());
+  for (size_t edge = 0; edge < targets_.size(); ++edge) {
+    in_index_[next[targets_[edge]]++] = edge;
+  }
+}
+
+
 void DAG::toJSON(std::string fname) {
   // Create a mapping from DAGNode * to index
   auto dagnode_to_index = create_dagnode_to_index(*this);
@@ -454,8 +682,20 @@ void DAG::toEdgeCSV(std::string fname) {
 
 
 size_t DAG::node_count() const {
-  return (source_leaves.capacity() + source_nodes.capacity()
-          + target_nodes.capacity() + target_leaves.capacity());
+  return (source_leaves.size() + source_nodes.size()
+          + target_nodes.size() + target_leaves.size());
+}
+
+
+size_t DAG::node_bytes() const {
+  size_t retval = (source_leaves.capacity() + source_nodes.capacity()
+                   + target_nodes.capacity() + target_leaves.capacity())
+                  * sizeof(DAGNode *);
+  retval += node_count() * sizeof(DAGNode);
+  retval += offsets_.capacity() * sizeof(size_t);
+  retval += in_degree_.capacity() * sizeof(uint32_t);
+  retval += in_offsets_.capacity() * sizeof(size_t);
+  return retval;
 }
 
 
@@ -497,19 +737,26 @@ std::vector<double> DAG::average_out_degree() const {
 
 
 size_t DAG::edge_count() const {
-  size_t retval{0};
+  // NOTE: Once finalized, the offsets count the edges even when the DAG is
+  // implicit, and no edges are left with the threads.
+  size_t retval = offsets_.empty() ? 0 : offsets_.back();
 
-  for (auto i = source_leaves.begin(), e = source_leaves.end(); i != e; ++i) {
-    retval += (*i)->out_edges.capacity() + (*i)->in_edges.capacity();
-  }
-  for (auto i = source_nodes.begin(), e = source_nodes.end(); i != e; ++i) {
-    retval += (*i)->out_edges.capacity() + (*i)->in_edges.capacity();
+  for (auto i = found_.begin(), e = found_.end(); i != e; ++i) {
+    retval += i->size();
   }
-  for (auto i = target_nodes.begin(), e = target_nodes.end(); i != e; ++i) {
-    retval += (*i)->out_edges.capacity() + (*i)->in_edges.capacity();
-  }
-  for (auto i = target_leaves.begin(), e = target_leaves.end(); i != e; ++i) {
-    retval += (*i)->out_edges.capacity() + (*i)->in_edges.capacity();
+
+  return retval;
+}
+
+
+size_t DAG::edge_bytes() const {
+  size_t retval = targets_.capacity() * sizeof(uint32_t)
+                  + ops_.capacity() * sizeof(uint8_t)
+                  + weights_.capacity() * sizeof(int)
+                  + in_index_.capacity() * sizeof(size_t);
+
+  for (auto i = found_.begin(), e = found_.end(); i != e; ++i) {
+    retval += i->capacity() * sizeof(DAGEdge);
   }
 
   return retval;
@@ -520,7 +767,7 @@ std::pair<int, int> DAG::min_max_out_degree_S() const {
   int min{std::numeric_limits<int>::max()};
   int max{std::numeric_limits<int>::min()};
   for (size_t i = 0; i < source_leaves.size(); ++i) {
-    int val = source_leaves[i]->out_edges.size();
+    int val = out_degree(source_leaves[i]);
     if (val < min) min = val;
     if (val > max) max = val;
   }
@@ -532,7 +779,7 @@ std::pair<int, int> DAG::min_max_in_degree_T() const {
   int min{std::numeric_limits<int>::max()};
   int max{std::numeric_limits<int>::min()};
   for (size_t i = 0; i < target_leaves.size(); ++i) {
-    int val = target_leaves[i]->in_edges.size();
+    int val = in_degree(target_leaves[i]);
     if (val < min) min = val;
     if (val > max) max = val;
   }
@@ -543,15 +790,17 @@ std::pair<int, int> DAG::min_max_in_degree_T() const {
 std::pair<int, int> DAG::min_max_out_degree_SI() const {
   int min{std::numeric_limits<int>::max()};
   int max{std::numeric_limits<int>::min()};
+  // The intermediate nodes are those entered by an M->I edge
+  std::vector<bool> interm(offsets_.size(), false);
+  for (size_t edge = 0; edge < targets_.size(); ++edge) {
+    if (static_cast<Operation>(ops_[edge]) == Operation::MtoI) {
+      interm[targets_[edge]] = true;
+    }
+  }
   for (size_t i = 0; i < source_nodes.size(); ++i) {
     // determine if we are M, and skip
-    auto item = std::find_if(source_nodes[i]->in_edges.begin(),
-                            source_nodes[i]->in_edges.end(),
-                            [](const DAGEdge &a)->bool {
-                              return a.op == Operation::MtoI;
-                            });
-    if (item != source_nodes[i]->in_edges.end()) {
-      int val = source_nodes[i]->out_edges.size();
+    if (interm[source_nodes[i]->id]) {
+      int val = out_degree(source_nodes[i]);
       if (val < min) min = val;
       if (val > max) max = val;
     }
@@ -564,13 +813,13 @@ std::pair<int, int> DAG::min_max_in_degree_TI() const {
   int min{std::numeric_limits<int>::max()};
   int max{std::numeric_limits<int>::min()};
   for (size_t i = 0; i < target_nodes.size(); ++i) {
-    auto item = std::find_if(target_nodes[i]->out_edges.begin(),
-                            target_nodes[i]->out_edges.end(),
+    std::vector<DAGEdge> out = out_edges(target_nodes[i]);
+    auto item = std::find_if(out.begin(), out.end(),
                             [](const DAGEdge &a)->bool {
                               return a.op == Operation::ItoL;
                             });
-    if (item != target_nodes[i]->out_edges.end()) {
-      int val = target_nodes[i]->in_edges.size();
+    if (item != out.end()) {
+      int val = in_degree(target_nodes[i]);
       if (val < min) min = val;
       if (val > max) max = val;
     }
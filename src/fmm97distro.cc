@@ -16,6 +16,8 @@
 #include <algorithm>
 #include <map>
 #include <limits>
+#include <utility>
+#include <vector>
 
 
 namespace dashmm {
@@ -43,30 +45,57 @@ void FMM97Distro::assign_for_target(DAGInfo &dag, int locality) {
     normal->locality = locality;
   }
 
+  // NOTE: The edges of the DAG are not yet all known, so the intermediate
+  // node is placed with the normal node. Unless the DAG is implicit, it is
+  // placed by its in edges in compute_distribution().
   if (interm != nullptr) {
-    // Categorize incoming edges
-    std::map<int, int> color;
-    std::map<int, int> weight;
-    int in_weight = 0;
-
-    for (size_t i = 0; i < interm->in_edges.size(); ++i) {
-      int w = interm->in_edges[i].weight;
-      int c = interm->in_edges[i].source->color;
-      int source_locality = interm->in_edges[i].source->locality;
-
-      color[source_locality] = std::max(color[source_locality], c);
-      weight[source_locality] += w;
-      in_weight += w;
+    interm->locality = locality;
+  }
+}
+
+
+void FMM97Distro::compute_distribution(DAG &dag) {
+  if (dag.implicit()) return;
+
+  // The intermediate nodes of the target tree are entered by I->I edges,
+  // which leave the intermediate nodes of the source tree. Their weights and
+  // colors are categorized by target node and source locality from the out
+  // edges, so that the in edges of the DAG need not be indexed.
+  std::map<std::pair<uint32_t, int>, std::pair<int, int>> incoming;
+  std::vector<int> in_weight(dag.target_nodes.size(), 0);
+  uint32_t first_target = dag.source_leaves.size() + dag.source_nodes.size();
+
+  for (size_t n = 0; n < dag.source_nodes.size(); ++n) {
+    std::vector<DAGEdge> out_edges = dag.out_edges(dag.source_nodes[n]);
+    for (size_t i = 0; i < out_edges.size(); ++i) {
+      if (out_edges[i].op != Operation::ItoI) continue;
+
+      uint32_t target = out_edges[i].target->id - first_target;
+      int w = out_edges[i].weight;
+      int c = out_edges[i].source->color;
+      int source_locality = out_edges[i].source->locality;
+
+      std::pair<int, int> &entry =
+          incoming[std::make_pair(target, source_locality)];
+      entry.first = std::max(entry.first, c);
+      entry.second += w;
+      in_weight[target] += w;
     }
+  }
 
+  // Place each intermediate node on the source locality that leaves the
+  // least weight to be communicated, preferring the highest color.
+  auto i = incoming.begin();
+  while (i != incoming.end()) {
+    uint32_t target = i->first.first;
     int min_weight = std::numeric_limits<int>::max();
     int max_color = std::numeric_limits<int>::min();
     int interm_locality = -1;
 
-    for (auto i = weight.begin(); i != weight.end(); ++i) {
-      int source_locality = i->first;
-      int w = in_weight - i->second;
-      int c = color[source_locality];
+    for (; i != incoming.end() && i->first.first == target; ++i) {
+      int source_locality = i->first.second;
+      int w = in_weight[target] - i->second.second;
+      int c = i->second.first;
 
       if (w < min_weight) {
         min_weight = w;
@@ -78,18 +107,10 @@ void FMM97Distro::assign_for_target(DAGInfo &dag, int locality) {
       }
     }
 
-    interm->locality = interm_locality;
+    dag.target_nodes[target]->locality = interm_locality;
     assert(interm_locality != -1);
   }
 }
 
 
-void FMM97Distro::compute_distribution(DAG &dag) {
-  // TODO:
-  // There may exist some nodes in the source_nodes container that do not have
-  // outgoing edges. In the future, these nodes can be eliminated (no allocation
-  // or work scheduled).
-}
-
-
 } // dashmm
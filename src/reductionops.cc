@@ -63,6 +63,24 @@ void size_sum_op_handler(size_t *lhs, const size_t *rhs, size_t bytes) {
 HPX_ACTION(HPX_FUNCTION, HPX_ATTR_NONE, size_sum_op, size_sum_op_handler,
            HPX_POINTER, HPX_POINTER, HPX_SIZE_T);
 
+void double_sum_ident_handler(double *input, const size_t bytes) {
+  size_t count = bytes / sizeof(double);
+  for (size_t i = 0; i < count; ++i) {
+    input[i] = 0.0;
+  }
+}
+HPX_ACTION(HPX_FUNCTION, HPX_ATTR_NONE, double_sum_ident_op,
+           double_sum_ident_handler, HPX_POINTER, HPX_SIZE_T);
+
+void double_sum_op_handler(double *lhs, const double *rhs, size_t bytes) {
+  size_t count = bytes / sizeof(double);
+  for (size_t i = 0; i < count; ++i) {
+    lhs[i] += rhs[i];
+  }
+}
+HPX_ACTION(HPX_FUNCTION, HPX_ATTR_NONE, double_sum_op, double_sum_op_handler,
+           HPX_POINTER, HPX_POINTER, HPX_SIZE_T);
+
 void int_max_ident_handler(int *input, const size_t bytes) {
   size_t count = bytes / sizeof(int);
   for (size_t i = 0; i < count; ++i) {
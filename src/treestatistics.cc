@@ -0,0 +1,164 @@
+// =============================================================================
+//  Dynamic Adaptive System for Hierarchical Multipole Methods (DASHMM)
+//
+//  Copyright (c) 2015-2017, Trustees of Indiana University,
+//  All rights reserved.
+//
+//  This software may be modified and distributed under the terms of the BSD
+//  license. See the LICENSE file for details.
+//
+//  This software was created at the Indiana University Center for Research in
+//  Extreme Scale Technologies (CREST).
+// =============================================================================
+
+
+/// \file src/treestatistics.cc
+/// \brief Implementation of TreeShape
+
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "dashmm/treestatistics.h"
+
+
+namespace dashmm {
+
+
+constexpr int TreeShape::kLevels;
+constexpr int TreeShape::kOccupancyBins;
+
+
+int TreeShape::occupancy_bin(size_t n) {
+  int retval{0};
+  while (n > 0 && retval < kOccupancyBins - 1) {
+    n >>= 1;
+    ++retval;
+  }
+  return retval;
+}
+
+
+void TreeShape::count_node(size_t *data, int level, bool leaf, size_t n) {
+  if (level < 0) {
+    fprintf(stderr, "Tree statistics: node at negative level %d\n", level);
+    exit(-1);
+  }
+  level = std::min(level, kLevels - 1);
+
+  data[level] += 1;
+  if (leaf) {
+    data[kLevels + level] += 1;
+    data[2 * kLevels + occupancy_bin(n)] += 1;
+  }
+}
+
+
+void TreeShape::set_rank(size_t *data, int num_ranks, int rank,
+                         size_t points, size_t n_nodes) {
+  size_t *ranks = &data[2 * kLevels + kOccupancyBins];
+  ranks[rank] = points;
+  ranks[num_ranks + rank] = n_nodes;
+}
+
+
+void TreeShape::unpack(const size_t *data, int num_ranks) {
+  const size_t *ranks = &data[2 * kLevels + kOccupancyBins];
+  nodes.assign(data, data + kLevels);
+  leaves.assign(data + kLevels, data + 2 * kLevels);
+  occupancy.assign(data + 2 * kLevels, ranks);
+  rank_points.assign(ranks, ranks + num_ranks);
+  rank_nodes.assign(ranks + num_ranks, ranks + 2 * num_ranks);
+}
+
+
+int TreeShape::depth() const {
+  int retval{0};
+  for (int level = 0; level < kLevels; ++level) {
+    if (nodes[level]) {
+      retval = level;
+    }
+  }
+  return retval;
+}
+
+
+size_t TreeShape::total_nodes() const {
+  size_t retval{0};
+  for (size_t n : nodes) {
+    retval += n;
+  }
+  return retval;
+}
+
+
+size_t TreeShape::total_leaves() const {
+  size_t retval{0};
+  for (size_t n : leaves) {
+    retval += n;
+  }
+  return retval;
+}
+
+
+size_t TreeShape::total_points() const {
+  size_t retval{0};
+  for (size_t n : rank_points) {
+    retval += n;
+  }
+  return retval;
+}
+
+
+// The largest value divided by the average, or one if all are zero
+static double imbalance(const std::vector<size_t> &counts) {
+  size_t total{0};
+  size_t largest{0};
+  for (size_t n : counts) {
+    total += n;
+    largest = std::max(largest, n);
+  }
+  if (total == 0) {
+    return 1.0;
+  }
+  return (double)largest * counts.size() / total;
+}
+
+
+double TreeShape::point_imbalance() const {
+  return imbalance(rank_points);
+}
+
+
+double TreeShape::node_imbalance() const {
+  return imbalance(rank_nodes);
+}
+
+
+void TreeShape::print(FILE *out, const char *name) const {
+  const char *more = deeper() ? "+" : "";
+  fprintf(out, "%s: %zu points - %zu nodes - %zu leaves - depth %d%s\n",
+          name, total_points(), total_nodes(), total_leaves(), depth(), more);
+  for (int level = 0; level <= depth(); ++level) {
+    fprintf(out, "  level %d%s: %zu nodes - %zu leaves\n", level,
+            level == kLevels - 1 ? more : "", nodes[level], leaves[level]);
+  }
+  fprintf(out, "  leaves by records:");
+  for (int bin = 0; bin < kOccupancyBins; ++bin) {
+    if (occupancy[bin] == 0) continue;
+    if (bin == 0) {
+      fprintf(out, " 0: %zu", occupancy[bin]);
+    } else if (bin == kOccupancyBins - 1) {
+      fprintf(out, " %zu+: %zu", size_t{1} << (bin - 1), occupancy[bin]);
+    } else {
+      fprintf(out, " %zu-%zu: %zu", size_t{1} << (bin - 1),
+              (size_t{1} << bin) - 1, occupancy[bin]);
+    }
+  }
+  fprintf(out, "\n");
+  fprintf(out, "  imbalance: points %lg - nodes %lg\n",
+          point_imbalance(), node_imbalance());
+}
+
+
+} // namespace dashmm
@@ -83,6 +83,7 @@ struct InputArguments {
   std::string kernel;
   bool verify;
   int accuracy;
+  std::string dag;
 };
 
 // Print usage information.
@@ -92,11 +93,11 @@ void print_usage(char *progname) {
           "--method=[fmm/fmm97/bh]     method to use (fmm)\n"
           "--nsources=num              "
           "number of source points to generate (10000)\n"
-          "--sourcedata=[cube/sphere/plummer]\n"
+          "--sourcedata=[cube/sphere/plummer/cluster]\n"
           "                            source distribution type (cube)\n"
           "--ntargets=num              "
           "number of target points to generate (10000)\n"
-          "--targetdata=[cube/sphere/plummer]\n"
+          "--targetdata=[cube/sphere/plummer/cluster]\n"
           "                            target distribution type (cube)\n"
           "--threshold=num             "
           "source and target tree partition refinement limit (40)\n"
@@ -106,6 +107,9 @@ void print_usage(char *progname) {
           "perform an accuracy test comparing to direct summation (yes)\n"
           "--kernel=[laplace/yukawa]   "
           "particle interaction type (laplace)\n"
+          "--dag=[explicit/implicit/retained]\n"
+          "                            DAG mode, compared to a fresh explicit"
+          " DAG (explicit)\n"
           , progname);
 }
 
@@ -122,6 +126,7 @@ int read_arguments(int argc, char **argv, InputArguments &retval) {
   retval.kernel = std::string{"laplace"};
   retval.verify = true;
   retval.accuracy = 3;
+  retval.dag = std::string{"explicit"};
 
   int opt = 0;
   static struct option long_options[] = {
@@ -134,12 +139,13 @@ int read_arguments(int argc, char **argv, InputArguments &retval) {
     {"verify", required_argument, 0, 'v'},
     {"accuracy", required_argument, 0, 'a'},
     {"kernel", required_argument, 0, 'k'},
+    {"dag", required_argument, 0, 'd'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
 
   int long_index = 0;
-  while ((opt = getopt_long(argc, argv, "m:s:w:t:g:l:v:a:k:h",
+  while ((opt = getopt_long(argc, argv, "m:s:w:t:g:l:v:a:k:d:h",
                             long_options, &long_index)) != -1) {
     std::string verifyarg{};
     switch (opt) {
@@ -171,6 +177,9 @@ int read_arguments(int argc, char **argv, InputArguments &retval) {
     case 'k':
       retval.kernel = optarg;
       break;
+    case 'd':
+      retval.dag = optarg;
+      break;
     case 'h':
       print_usage(argv[0]);
       return -1;
@@ -198,19 +207,28 @@ int read_arguments(int argc, char **argv, InputArguments &retval) {
   }
 
   if (retval.source_type != "cube" && retval.source_type != "sphere"
-        && retval.source_type != "plummer") {
+        && retval.source_type != "plummer"
+        && retval.source_type != "cluster") {
     fprintf(stderr, "Usage ERROR: unknown source type '%s'\n",
             retval.source_type.c_str());
     return -1;
   }
 
   if (retval.target_type != "cube" && retval.target_type != "sphere"
-        && retval.target_type != "plummer") {
+        && retval.target_type != "plummer"
+        && retval.target_type != "cluster") {
     fprintf(stderr, "Usage ERROR: unknown target type '%s'\n",
             retval.target_type.c_str());
     return -1;
   }
 
+  if (retval.dag != "explicit" && retval.dag != "implicit"
+      && retval.dag != "retained") {
+    fprintf(stderr, "Usage ERROR: unknown DAG mode '%s'\n",
+            retval.dag.c_str());
+    return -1;
+  }
+
   if (retval.kernel == "laplace" && retval.method == "fmm97") {
     if (retval.accuracy != 3 && retval.accuracy != 6) {
       fprintf(stderr, "Usage ERROR: only 3-/6-digit accuracy supported"
@@ -237,9 +255,9 @@ int read_arguments(int argc, char **argv, InputArguments &retval) {
             retval.source_count, retval.source_type.c_str());
     fprintf(stdout, "%d targets in a %s distribution\n",
             retval.target_count, retval.target_type.c_str());
-    fprintf(stdout, "method: %s \nthreshold: %d\nkernel: %s\n\n",
+    fprintf(stdout, "method: %s \nthreshold: %d\nkernel: %s\ndag: %s\n\n",
             retval.method.c_str(), retval.refinement_limit,
-            retval.kernel.c_str());
+            retval.kernel.c_str(), retval.dag.c_str());
   } else {
     // Only have rank 0 create data
     retval.source_count = 0;
@@ -306,6 +324,21 @@ dashmm::Point pick_plummer_position() {
   return dashmm::Point{pos[0], pos[1], pos[2]};
 }
 
+// Pick a position in one of four tight clusters, with a few points spread
+// over the domain. The clusters are so small that the tree is refined far
+// below level 21 around them.
+dashmm::Point pick_cluster_position() {
+  if (rand() % 10 == 0) {
+    return pick_cube_position();
+  }
+  double center = 0.25 * (rand() % 4) - 0.375;
+  double pos[3];
+  pos[0] = center + 1.0e-7 * ((double)rand() / RAND_MAX - 0.5);
+  pos[1] = center + 1.0e-7 * ((double)rand() / RAND_MAX - 0.5);
+  pos[2] = center + 1.0e-7 * ((double)rand() / RAND_MAX - 0.5);
+  return dashmm::Point{pos[0], pos[1], pos[2]};
+}
+
 // Set the charges in the plummer case to be constant, and consistent with the
 // distribution.
 double pick_plummer_charge(int count) {
@@ -328,6 +361,13 @@ void set_sources(SourceData *sources, int source_count,
       sources[i].position = pick_sphere_position();
       sources[i].charge = pick_charge(use_negative);
     }
+  } else if (source_type == std::string{"cluster"}) {
+    //Cluster, where each pair of points is at the same position
+    for (int i = 0; i < source_count; ++i) {
+      sources[i].position = (i % 2) ? sources[i - 1].position
+                                    : pick_cluster_position();
+      sources[i].charge = pick_charge(use_negative);
+    }
   } else {
     //Plummer
     for (int i = 0; i < source_count; ++i) {
@@ -371,6 +411,14 @@ void set_targets(TargetData *targets, int target_count,
       targets[i].phi = 0.0;
       targets[i].index = i;
     }
+  } else if (target_type == std::string{"cluster"}) {
+    //Cluster, where each pair of points is at the same position
+    for (int i = 0; i < target_count; ++i) {
+      targets[i].position = (i % 2) ? targets[i - 1].position
+                                    : pick_cluster_position();
+      targets[i].phi = 0.0;
+      targets[i].index = i;
+    }
   } else {
     //Plummer
     for (int i = 0; i < target_count; ++i) {
@@ -401,7 +449,7 @@ dashmm::Array<TargetData> prepare_targets(InputArguments &args) {
 // Compute an error characteristic for the values computed with a multipole
 // method, and the values computed with direct summation.
 void compare_results(TargetData *targets, int target_count,
-                     TargetData *exacts, int exact_count) {
+                     TargetData *exacts, int exact_count, const char *what) {
   if (dashmm::get_my_rank()) return;
 
   //create a map from index into offset for targets
@@ -425,67 +473,178 @@ void compare_results(TargetData *targets, int target_count,
       maxrel = relerr / exacts[i].phi.real();
     }
   }
-  fprintf(stdout, "Error for %d test points: %4.3e (max %4.3e)\n",
-                  exact_count, sqrt(numerator / denominator), maxrel);
+  fprintf(stdout, "%s for %d test points: %4.3e (max %4.3e)\n",
+                  what, exact_count, sqrt(numerator / denominator), maxrel);
 }
 
-// The main driver routine that performes the test of evaluate()
-void perform_evaluation_test(InputArguments args) {
-  srand(123456);
+// Select the DAG mode of an evaluator. The tree and the DAG are only kept
+// while they are retained.
+template <typename E>
+void set_dag_mode(E &evaluator, const std::string &mode) {
+  bool retained = (mode == std::string{"retained"});
+  evaluator.implicit_dag(mode == std::string{"implicit"});
+  evaluator.retain_tree(retained);
+  evaluator.retain_dag(retained);
+  if (!retained) {
+    int err = evaluator.release_tree();
+    assert(err == dashmm::kSuccess);
+  }
+}
 
-  dashmm::Array<SourceData> source_handle = prepare_sources(args);
-  dashmm::Array<TargetData> target_handle = prepare_targets(args);
+// Select the DAG mode of the evaluators that build a DAG from a tree
+void set_dag_mode(const std::string &mode) {
+  set_dag_mode(laplace_bh, mode);
+  set_dag_mode(laplace_fmm, mode);
+  set_dag_mode(laplace_fmm97, mode);
+  set_dag_mode(yukawa_fmm97, mode);
+}
 
-  //Perform the evaluation
-  double t0{};
-  double tf{};
+// Evaluate the potential at the targets using the method and kernel requested
+void evaluate_test(const InputArguments &args,
+                   dashmm::Array<SourceData> &source_handle,
+                   dashmm::Array<TargetData> &target_handle) {
   int err{0};
 
   if (args.kernel == std::string{"laplace"}) {
     if (args.method == std::string{"bh"}) {
       dashmm::BH<SourceData, TargetData, dashmm::LaplaceCOM> method{0.6};
-
-      t0 = getticks();
       err = laplace_bh.evaluate(source_handle, target_handle,
                                 args.refinement_limit, method,
                                 args.accuracy, std::vector<double>{});
       assert(err == dashmm::kSuccess);
-      tf = getticks();
     } else if (args.method == std::string{"fmm"}) {
       dashmm::FMM<SourceData, TargetData, dashmm::Laplace> method{};
-
-      t0 = getticks();
       err = laplace_fmm.evaluate(source_handle, target_handle,
                                  args.refinement_limit, method,
                                  args.accuracy, std::vector<double>{});
       assert(err == dashmm::kSuccess);
-      tf = getticks();
     } else if (args.method == std::string{"fmm97"}) {
       dashmm::FMM97<SourceData, TargetData, dashmm::Laplace> method{};
-
-      t0 = getticks();
       err = laplace_fmm97.evaluate(source_handle, target_handle,
                                    args.refinement_limit, method,
                                    args.accuracy, std::vector<double>{});
       assert(err == dashmm::kSuccess);
-      tf = getticks();
     }
   } else if (args.kernel == std::string{"yukawa"}) {
     if (args.method == std::string{"fmm97"}) {
       dashmm::FMM97<SourceData, TargetData, dashmm::Yukawa> method{};
       std::vector<double> kernelparms(1, 0.1);
-
-      t0 = getticks();
       err = yukawa_fmm97.evaluate(source_handle, target_handle,
                                   args.refinement_limit, method,
                                   args.accuracy, kernelparms);
       assert(err == dashmm::kSuccess);
-      tf = getticks();
     }
   }
+}
+
+// The bytes of edges of the last evaluation with the method and kernel
+// requested
+size_t dag_edge_bytes(const InputArguments &args) {
+  if (args.kernel == std::string{"laplace"}) {
+    if (args.method == std::string{"bh"}) {
+      return laplace_bh.dag_edge_bytes();
+    } else if (args.method == std::string{"fmm"}) {
+      return laplace_fmm.dag_edge_bytes();
+    } else if (args.method == std::string{"fmm97"}) {
+      return laplace_fmm97.dag_edge_bytes();
+    }
+  } else if (args.kernel == std::string{"yukawa"}) {
+    if (args.method == std::string{"fmm97"}) {
+      return yukawa_fmm97.dag_edge_bytes();
+    }
+  }
+  return 0;
+}
+
+// Compare the potentials found with the DAG mode requested against those
+// found with an explicit DAG for the same points. An implicit DAG must also
+// hold far fewer bytes of edges than the explicit DAG stores.
+void check_dag_mode(const InputArguments &args,
+                    dashmm::Array<SourceData> &source_handle,
+                    dashmm::Array<TargetData> &target_handle) {
+  // A retained DAG is evaluated again, for new charges
+  if (args.dag == std::string{"retained"}) {
+    bool use_negative = (args.method != std::string{"bh"});
+    size_t count{0};
+    SourceData *sources = source_handle.segment(count);
+    for (size_t i = 0; i < count; ++i) {
+      sources[i].charge = pick_charge(use_negative);
+    }
+    TargetData *targets = target_handle.segment(count);
+    for (size_t i = 0; i < count; ++i) {
+      targets[i].phi = std::complex<double>{0.0, 0.0};
+    }
+    evaluate_test(args, source_handle, target_handle);
+  }
+
+  // Get the results from the global address space
+  int target_count = target_handle.length();
+  TargetData *targets = target_handle.collect();
+
+  // Copy the targets into a new array, without their potentials
+  TargetData *ref_targets{nullptr};
+  if (targets) {
+    ref_targets = new TargetData[target_count];
+    for (int i = 0; i < target_count; ++i) {
+      ref_targets[i] = targets[i];
+      ref_targets[i].phi = std::complex<double>{0.0, 0.0};
+    }
+  } else {
+    target_count = 0;
+  }
+
+  dashmm::Array<TargetData> ref_handle{};
+  int err = ref_handle.allocate(target_count);
+  assert(err == dashmm::kSuccess);
+  err = ref_handle.put(0, target_count, ref_targets);
+  assert(err == dashmm::kSuccess);
+  delete [] ref_targets;
+
+  size_t held_bytes = dag_edge_bytes(args);
+
+  // Evaluate again with an explicit DAG, building everything
+  set_dag_mode(std::string{"explicit"});
+  evaluate_test(args, source_handle, ref_handle);
+
+  if (args.dag == std::string{"implicit"}) {
+    size_t edge_bytes = dag_edge_bytes(args);
+    if (!dashmm::get_my_rank()) {
+      fprintf(stdout, "Edges held by implicit DAG: %zu [B] of %zu [B]\n",
+              held_bytes, edge_bytes);
+    }
+    assert(held_bytes * 4 <= edge_bytes);
+  }
+
+  ref_targets = ref_handle.collect();
+  compare_results(targets, target_count, ref_targets, target_count,
+                  "Difference from explicit DAG");
+
+  err = ref_handle.destroy();
+  assert(err == dashmm::kSuccess);
+  delete [] ref_targets;
+  delete [] targets;
+}
+
+// The main driver routine that performes the test of evaluate()
+void perform_evaluation_test(InputArguments args) {
+  srand(123456);
+
+  dashmm::Array<SourceData> source_handle = prepare_sources(args);
+  dashmm::Array<TargetData> target_handle = prepare_targets(args);
+
+  //Perform the evaluation
+  set_dag_mode(args.dag);
+  double t0 = getticks();
+  evaluate_test(args, source_handle, target_handle);
+  double tf = getticks();
+  int err{0};
 
   fprintf(stdout, "Evaluation took %lg [us]\n", elapsed(tf, t0));
 
+  if (args.dag != std::string{"explicit"}) {
+    check_dag_mode(args, source_handle, target_handle);
+  }
+
   if (args.verify) {
     // Save a few targets for the direct comparison
     int test_count{0};
@@ -547,7 +706,8 @@ void perform_evaluation_test(InputArguments args) {
     test_targets = test_handle.collect();
 
     //Test error
-    compare_results(targets, args.target_count, test_targets, test_count);
+    compare_results(targets, args.target_count, test_targets, test_count,
+                    "Error");
 
     err = test_handle.destroy();
     assert(err == dashmm::kSuccess);